@@ -8,6 +8,7 @@ namespace BamstatsAlive {
 	template<class T>
 	class AbstractChangeMonitor {
 		public:
+			virtual ~AbstractChangeMonitor() {}
 			virtual void addValue(T value) = 0;
 			virtual bool isSatisfied() = 0;
 	};
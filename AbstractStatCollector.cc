@@ -1,11 +1,42 @@
 #include "AbstractStatCollector.h"
+#include "PerfCounters.h"
 
 using namespace BamstatsAlive;
 
-AbstractStatCollector::AbstractStatCollector() {
+static const size_t kPerfStageUnregistered = static_cast<size_t>(-1);
+
+std::vector<size_t> BamstatsAlive::mergeReferenceNames(std::vector<std::string>& names, const std::vector<std::string>& otherNames) {
+	std::vector<size_t> indices(otherNames.size());
+
+	// inputs of the same reference mostly list it in the same order
+	size_t same = 0;
+	for(; same < otherNames.size() && same < names.size() && names[same] == otherNames[same]; same++) indices[same] = same;
+	if(same == otherNames.size()) return indices;
+
+	std::map<std::string, size_t> nameIndices;
+	for(size_t i=0; i<names.size(); i++) nameIndices.insert(std::make_pair(names[i], i));
+
+	for(size_t i=same; i<otherNames.size(); i++) {
+		auto loc = nameIndices.find(otherNames[i]);
+		if(loc == nameIndices.end()) {
+			loc = nameIndices.insert(std::make_pair(otherNames[i], names.size())).first;
+			names.push_back(otherNames[i]);
+		}
+		indices[i] = loc->second;
+	}
+	return indices;
+}
+
+AbstractStatCollector::AbstractStatCollector() : _perfStage(kPerfStageUnregistered) {
 	_children.clear();
 }
 
+size_t AbstractStatCollector::perfStage() {
+	if(_perfStage == kPerfStageUnregistered)
+		_perfStage = PerfCounters::registerStage(collectorName());
+	return _perfStage;
+}
+
 AbstractStatCollector::~AbstractStatCollector() {
 
 }
@@ -36,7 +67,10 @@ void AbstractStatCollector::removeChild(AbstractStatCollector * child) {
 }
 
 void AbstractStatCollector::processAlignment(const BamTools::BamAlignment& al, const BamTools::RefVector& refVector) {
-	this->processAlignmentImpl(al, refVector);
+	{
+		BSA_PERF_SCOPE(perfStage());
+		this->processAlignmentImpl(al, refVector);
+	}
 
 	StatCollectorPtrVec::iterator iter;
 	for(iter = _children.begin(); iter != _children.end(); iter++) {
@@ -58,6 +92,64 @@ json_t * AbstractStatCollector::appendJson(json_t * jsonRootObj) {
 	return jsonRootObj;
 }
 
+unsigned int AbstractStatCollector::requiredFieldsImpl() const {
+	return 0;
+}
+
+unsigned int AbstractStatCollector::requiredFields() const {
+	unsigned int fields = this->requiredFieldsImpl();
+
+	StatCollectorPtrVec::const_iterator iter;
+	for(iter = _children.begin(); iter != _children.end(); iter++) {
+		fields |= (*iter)->requiredFields();
+	}
+
+	return fields;
+}
+
+size_t AbstractStatCollector::memoryUsageImpl() const {
+	return 0;
+}
+
+size_t AbstractStatCollector::memoryUsage() const {
+	size_t bytes = this->memoryUsageImpl();
+
+	StatCollectorPtrVec::const_iterator iter;
+	for(iter = _children.begin(); iter != _children.end(); iter++) {
+		bytes += (*iter)->memoryUsage();
+	}
+
+	return bytes;
+}
+
+void AbstractStatCollector::appendMemoryJson(json_t * memoryObj) const {
+	// collectors of the same kind, e.g. in several partitions, add up
+	json_int_t bytes = this->memoryUsageImpl();
+	json_t * j_bytes = json_object_get(memoryObj, collectorName());
+	if(j_bytes) bytes += json_integer_value(j_bytes);
+	json_object_set_new(memoryObj, collectorName(), json_integer(bytes));
+
+	StatCollectorPtrVec::const_iterator iter;
+	for(iter = _children.begin(); iter != _children.end(); iter++) {
+		(*iter)->appendMemoryJson(memoryObj);
+	}
+}
+
+bool AbstractStatCollector::shedMemoryImpl() {
+	return false;
+}
+
+bool AbstractStatCollector::shedMemory() {
+	bool shed = this->shedMemoryImpl();
+
+	StatCollectorPtrVec::iterator iter;
+	for(iter = _children.begin(); iter != _children.end(); iter++) {
+		shed = (*iter)->shedMemory() || shed;
+	}
+
+	return shed;
+}
+
 bool AbstractStatCollector::isSatisfiedImpl() {
 	return false;
 }
@@ -74,3 +166,62 @@ bool AbstractStatCollector::isSatisfied() {
 
 	return isChildrenSatisfied;
 }
+
+void AbstractStatCollector::merge(const AbstractStatCollector& other) {
+	this->mergeImpl(other);
+
+	assert(_children.size() == other._children.size());
+
+	for(size_t i=0; i<_children.size(); i++) {
+		_children[i]->merge(*other._children[i]);
+	}
+}
+
+size_t AbstractStatCollector::treeSize() const {
+	size_t size = 1;
+
+	StatCollectorPtrVec::const_iterator iter;
+	for(iter = _children.begin(); iter != _children.end(); iter++) {
+		size += (*iter)->treeSize();
+	}
+
+	return size;
+}
+
+void AbstractStatCollector::saveStateTo(json_t * stateArray) {
+	json_t * stateObj = json_object();
+	this->saveStateImpl(stateObj);
+	json_array_append_new(stateArray, stateObj);
+
+	StatCollectorPtrVec::iterator iter;
+	for(iter = _children.begin(); iter != _children.end(); iter++) {
+		(*iter)->saveStateTo(stateArray);
+	}
+}
+
+void AbstractStatCollector::loadStateFrom(const json_t * stateArray, size_t& index) {
+	this->loadStateImpl(json_array_get(stateArray, index++));
+
+	StatCollectorPtrVec::iterator iter;
+	for(iter = _children.begin(); iter != _children.end(); iter++) {
+		(*iter)->loadStateFrom(stateArray, index);
+	}
+}
+
+json_t * AbstractStatCollector::saveState() {
+	json_t * stateArray = json_array();
+	saveStateTo(stateArray);
+	return stateArray;
+}
+
+bool AbstractStatCollector::loadState(const json_t * state) {
+	if(!json_is_array(state) || json_array_size(state) != treeSize()) return false;
+
+	for(size_t i=0; i<json_array_size(state); i++) {
+		if(!json_is_object(json_array_get(state, i))) return false;
+	}
+
+	size_t index = 0;
+	loadStateFrom(state, index);
+	return true;
+}
@@ -9,6 +9,46 @@ namespace BamstatsAlive {
 
 	typedef std::vector<AbstractStatCollector *> StatCollectorPtrVec;
 
+	/**
+	 * The variable length alignment fields a collector may need decoded.
+	 * Core fields (positions, flags, mapping quality, cigar, mate
+	 * information and read length) are always available.
+	 */
+	enum AlignmentFieldT {
+		kFieldName = 1,
+		kFieldBases = 2,
+		kFieldQualities = 4,
+		kFieldTags = 8
+	};
+
+	/**
+	 * The heap memory held by a map, counting the node overhead of the
+	 * usual red-black tree implementations
+	 */
+	template<class K, class V>
+	inline size_t mapMemoryUsage(const std::map<K, V>& m) {
+		return m.size() * (sizeof(typename std::map<K, V>::value_type) + 4 * sizeof(void *));
+	}
+
+	/**
+	 * The heap memory held by a vector
+	 */
+	template<class T>
+	inline size_t vectorMemoryUsage(const std::vector<T>& v) {
+		return v.capacity() * sizeof(T);
+	}
+
+	/**
+	 * Pair up the references of two inputs by name, for merging what is
+	 * kept by reference ID, as headers may order the references differently
+	 *
+	 * @param names The reference names merged into, to which the names only
+	 *        the other input has are appended
+	 * @param otherNames The reference names of the other input
+	 * @return The index in names of each of the other's references
+	 */
+	std::vector<size_t> mergeReferenceNames(std::vector<std::string>& names, const std::vector<std::string>& otherNames);
+
 	/**
 	 * The base class for all statistics collectors
 	 *
@@ -27,6 +67,11 @@ namespace BamstatsAlive {
 		protected:
 			StatCollectorPtrVec _children;
 
+			/**
+			 * The name of the collector, used when reporting on it
+			 */
+			virtual const char * collectorName() const = 0;
+
 			/**
 			 * Process the alignment and update statistics
 			 *
@@ -52,6 +97,62 @@ namespace BamstatsAlive {
 			 */
 			virtual bool isSatisfiedImpl();
 
+			/**
+			 * The alignment fields the collector reads. The default
+			 * implementation requires none of the variable length fields.
+			 *
+			 * @return A combination of AlignmentFieldT bits
+			 */
+			virtual unsigned int requiredFieldsImpl() const;
+
+			/**
+			 * Merge the statistics held by another collector of the same type
+			 * into this collector
+			 *
+			 * @param other The collector whose statistics are added to this one
+			 */
+			virtual void mergeImpl(const AbstractStatCollector& other) = 0;
+
+			/**
+			 * Save the state needed to continue collecting later
+			 *
+			 * @param stateObj The json object the state is written into
+			 */
+			virtual void saveStateImpl(json_t * stateObj) = 0;
+
+			/**
+			 * Restore the state written by saveStateImpl()
+			 *
+			 * @param stateObj The json object the state is read from
+			 */
+			virtual void loadStateImpl(const json_t * stateObj) = 0;
+
+			/**
+			 * The memory held by the collector, besides its children. The
+			 * default implementation holds nothing worth counting.
+			 *
+			 * @return An estimate in bytes
+			 */
+			virtual size_t memoryUsageImpl() const;
+
+			/**
+			 * Give up some precision to hold less memory, e.g. by keeping
+			 * coarser statistics from now on. The default implementation
+			 * has nothing to give up.
+			 *
+			 * @return true if anything was given up, false if the collector
+			 *         cannot hold less
+			 */
+			virtual bool shedMemoryImpl();
+
+		private:
+			size_t _perfStage;
+			size_t perfStage();
+
+			size_t treeSize() const;
+			void saveStateTo(json_t * stateArray);
+			void loadStateFrom(const json_t * stateArray, size_t& index);
+
 		public:
 			AbstractStatCollector();
 			virtual ~AbstractStatCollector();
@@ -102,6 +203,64 @@ namespace BamstatsAlive {
 			 * @return true if all collectors in the tree are satisfied, false otherwise
 			 */
 			bool isSatisfied();
+
+			/**
+			 * Merge another collector tree into this one
+			 *
+			 * Both trees must have been assembled the same way, as children
+			 * are paired up by their position in the children list. This is
+			 * how statistics collected over separate inputs or shards are
+			 * combined.
+			 *
+			 * @param other The root of the collector tree to merge from
+			 */
+			void merge(const AbstractStatCollector& other);
+
+			/**
+			 * The alignment fields needed by the collector tree, so that
+			 * readers can skip decoding the others
+			 *
+			 * @return A combination of AlignmentFieldT bits
+			 */
+			unsigned int requiredFields() const;
+
+			/**
+			 * The memory held by the collector tree
+			 *
+			 * @return An estimate in bytes
+			 */
+			size_t memoryUsage() const;
+
+			/**
+			 * Add the memory held by every collector of the tree to a json
+			 * object, by collector name
+			 *
+			 * @param memoryObj The json object the byte counts are added to
+			 */
+			void appendMemoryJson(json_t * memoryObj) const;
+
+			/**
+			 * Have every collector of the tree give up some precision to
+			 * hold less memory
+			 *
+			 * @return false if no collector of the tree can hold less
+			 */
+			bool shedMemory();
+
+			/**
+			 * Save the state of the collector tree
+			 *
+			 * @return A json array holding the state of every collector, in tree order
+			 */
+			json_t * saveState();
+
+			/**
+			 * Restore the state of the collector tree
+			 *
+			 * @param state A json array created by saveState() on a tree of the same shape
+			 * @return false if the state does not match the tree, in which case nothing is changed
+			 */
+			bool loadState(const json_t * state);
 	};
 
 }
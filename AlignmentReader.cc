@@ -0,0 +1,56 @@
+#include "AlignmentReader.h"
+#include "BamToolsAlignmentReader.h"
+#include "HtsAlignmentReader.h"
+
+#include <fstream>
+#include <cstring>
+
+using namespace BamstatsAlive;
+
+static bool isCram(const std::string& filename) {
+	if(filename == "-") return false;
+
+	std::ifstream fs(filename.c_str(), std::ios::in | std::ios::binary);
+	char magic[4];
+	if(fs.read(magic, 4)) return memcmp(magic, "CRAM", 4) == 0;
+
+	// not a local file, go by the extension
+	return filename.length() > 5 && filename.compare(filename.length() - 5, 5, ".cram") == 0;
+}
+
+AlignmentReader * AlignmentReader::open(const std::string& filename, const AlignmentReaderOptionsT& options) {
+	AlignmentReader * reader = NULL;
+
+	if(isCram(filename)) {
+#ifdef HAVE_HTSLIB
+		reader = new HtsAlignmentReader();
+		if(!static_cast<HtsAlignmentReader *>(reader)->open(filename, options)) {
+			delete reader;
+			reader = NULL;
+		}
+#else
+		LOGS<<"CRAM input requires building with HTSLIB"<<std::endl;
+#endif
+		return reader;
+	}
+
+	reader = new BamToolsAlignmentReader();
+	if(!static_cast<BamToolsAlignmentReader *>(reader)->open(filename, options)) {
+		delete reader;
+		reader = NULL;
+	}
+	return reader;
+}
+
+void AlignmentReader::startDecodeThreads(unsigned int threads) {
+#ifdef HAVE_HTSLIB
+	if(threads > 0 && !HtsAlignmentReader::createThreadPool(threads))
+		LOGS<<"Cannot start "<<threads<<" decoding threads, decoding without them"<<std::endl;
+#endif
+}
+
+void AlignmentReader::stopDecodeThreads() {
+#ifdef HAVE_HTSLIB
+	HtsAlignmentReader::destroyThreadPool();
+#endif
+}
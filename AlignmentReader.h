@@ -0,0 +1,111 @@
+#ifndef ALIGNMENTREADER_H
+#define ALIGNMENTREADER_H
+
+#pragma once
+
+#include "AbstractStatCollector.h"
+
+namespace BamstatsAlive {
+
+	typedef struct _alignmentReaderOptionsT {
+		/** The AlignmentFieldT bits that must be decoded */
+		unsigned int fields;
+		/** Reference fasta for CRAM input, empty to use REF_PATH/REF_CACHE */
+		std::string reference;
+		/** Threads decoding CRAM slices, shared by all readers; 0 for none */
+		unsigned int decodeThreads;
+
+		_alignmentReaderOptionsT() : fields(kFieldName | kFieldBases | kFieldQualities | kFieldTags), decodeThreads(0) {}
+	} AlignmentReaderOptionsT;
+
+	/**
+	 * The source of alignments for a job
+	 *
+	 * Alignments are always handed out as BamTools::BamAlignment, whatever
+	 * the underlying library, so collectors do not depend on the input
+	 * format. Only the variable length fields listed in the options are
+	 * guaranteed to be decoded, which lets readers skip the work for
+	 * fields no collector looks at.
+	 */
+	class AlignmentReader {
+		public:
+			/**
+			 * Open an alignment file
+			 *
+			 * BAM files and stdin are read with BamTools. CRAM files are read
+			 * with htslib, which requires building with HTSLIB defined.
+			 *
+			 * @param filename The input path, "-" for stdin
+			 * @param options The fields to decode and CRAM settings
+			 * @return The reader, or NULL if the input cannot be opened
+			 */
+			static AlignmentReader * open(const std::string& filename, const AlignmentReaderOptionsT& options);
+
+			/**
+			 * Start the threads decoding CRAM slices for every reader of the
+			 * process, before any reader is opened
+			 *
+			 * @param threads The size of the pool, 0 for none
+			 */
+			static void startDecodeThreads(unsigned int threads);
+
+			/**
+			 * Stop the decoding threads, once every reader has been closed
+			 */
+			static void stopDecodeThreads();
+
+			virtual ~AlignmentReader() {}
+
+			/**
+			 * Read the next alignment with the requested fields decoded
+			 */
+			virtual bool getNextAlignment(BamTools::BamAlignment& al) = 0;
+
+			/**
+			 * Read the next alignment without any variable length field
+			 */
+			virtual bool getNextAlignmentCore(BamTools::BamAlignment& al) = 0;
+
+			/**
+			 * Decode the requested fields of the alignment last read by
+			 * getNextAlignmentCore()
+			 */
+			virtual void buildCharData(BamTools::BamAlignment& al) = 0;
+
+			/**
+			 * Change the fields decoded, for when the header decides what
+			 * the collectors need; only before the first alignment is read
+			 *
+			 * @param fields The AlignmentFieldT bits that must be decoded
+			 */
+			virtual void setFields(unsigned int fields) = 0;
+
+			virtual const BamTools::RefVector& referenceData() const = 0;
+			virtual std::string headerText() const = 0;
+			virtual BamTools::SamHeader header() const { return BamTools::SamHeader(headerText()); }
+
+			/**
+			 * Position the reader through the index
+			 *
+			 * After a successful jump, the reader returns every record from
+			 * the first one overlapping refID:position to the end of the
+			 * file, including reads without coordinates.
+			 *
+			 * @return false if there is no index or the jump cannot be exact
+			 */
+			virtual bool jump(int32_t refID, int32_t position) = 0;
+
+			/**
+			 * Position the reader through the index, for reading the
+			 * coordinate sorted reads from refID:position onwards
+			 *
+			 * Unlike jump(), reads without coordinates may be left out, so
+			 * the index is always usable for seeking to reads in regions.
+			 *
+			 * @return false if there is no index
+			 */
+			virtual bool seek(int32_t refID, int32_t position) = 0;
+	};
+}
+
+#endif
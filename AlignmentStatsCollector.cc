@@ -0,0 +1,295 @@
+#include "AlignmentStatsCollector.h"
+
+using namespace BamstatsAlive;
+using namespace std;
+
+static const uint32_t kFlagSupplementary = 0x800;
+
+static inline void countLength(vector<uint64_t>& hist, uint32_t length) {
+	if(length >= hist.size()) hist.resize(length + 1, 0);
+	hist[length]++;
+}
+
+static json_t * lengthsToJson(const vector<uint64_t>& hist) {
+	json_t * j_hist = json_object();
+	for(size_t i=0; i<hist.size(); i++) {
+		if(hist[i] == 0) continue;
+		stringstream labelSS; labelSS << i;
+		json_object_set_new(j_hist, labelSS.str().c_str(), json_integer(hist[i]));
+	}
+	return j_hist;
+}
+
+template<typename T>
+static void mergeCounts(vector<T>& counts, const vector<T>& other) {
+	if(other.size() > counts.size()) counts.resize(other.size(), 0);
+	for(size_t i=0; i<other.size(); i++) counts[i] += other[i];
+}
+
+template<typename T>
+static json_t * countsToJson(const vector<T>& counts) {
+	json_t * j_counts = json_array();
+	for(size_t i=0; i<counts.size(); i++) json_array_append_new(j_counts, json_integer(counts[i]));
+	return j_counts;
+}
+
+template<typename T>
+static void countsFromJson(vector<T>& counts, const json_t * j_counts) {
+	counts.assign(json_array_size(j_counts), 0);
+	for(size_t i=0; i<counts.size(); i++) counts[i] = json_integer_value(json_array_get(j_counts, i));
+}
+
+AlignmentStatsCollector::AlignmentStatsCollector(bool useTags) :
+	AbstractStatCollector(),
+	_useTags(useTags),
+	_reads(0),
+	_readBases(0),
+	_alignedBases(0),
+	_softClippedBases(0),
+	_softClippedReads(0),
+	_splicedReads(0),
+	_mismatches(0),
+	_mismatchAlignedBases(0)
+{
+}
+
+unsigned int AlignmentStatsCollector::requiredFieldsImpl() const {
+	return _useTags ? kFieldTags : 0;
+}
+
+bool AlignmentStatsCollector::parseMismatches(const std::string& md, std::vector<int32_t>& offsets) {
+	offsets.clear();
+
+	int32_t offset = 0;
+	for(size_t i=0; i<md.size(); ) {
+		char c = md[i];
+
+		if(c >= '0' && c <= '9') {
+			int32_t matches = 0;
+			for(; i<md.size() && md[i] >= '0' && md[i] <= '9'; i++) {
+				if(matches > (INT32_MAX - (md[i] - '0')) / 10) return false;
+				matches = matches * 10 + (md[i] - '0');
+			}
+			if(matches > INT32_MAX - offset) return false;
+			offset += matches;
+		}
+		else if(c == '^') {
+			// deleted reference bases
+			for(i++; i<md.size() && isalpha(md[i]); i++) offset++;
+		}
+		else if(isalpha(c)) {
+			offsets.push_back(offset++);
+			i++;
+		}
+		else return false;
+	}
+
+	return true;
+}
+
+void AlignmentStatsCollector::processAlignmentImpl(const BamTools::BamAlignment& al, const BamTools::RefVector& refVector) {
+	if(!al.IsMapped() || !al.IsPrimaryAlignment() || (al.AlignmentFlag & kFlagSupplementary)) return;
+
+	uint32_t readBases = 0, alignedBases = 0, softClipped = 0, hardClipped = 0;
+	uint32_t insertedBases = 0, deletedBases = 0;
+	bool hasMatchOps = false, spliced = false;
+
+	for(auto op = al.CigarData.begin(); op != al.CigarData.end(); op++) {
+		uint32_t length = op->Length;
+
+		switch(op->Type) {
+			case 'M':
+				hasMatchOps = true;
+				alignedBases += length; readBases += length;
+				break;
+			case '=': case 'X':
+				alignedBases += length; readBases += length;
+				break;
+			case 'I':
+				insertedBases += length; readBases += length;
+				countLength(_insertionHist, length);
+				break;
+			case 'D':
+				deletedBases += length;
+				countLength(_deletionHist, length);
+				break;
+			case 'N':
+				spliced = true;
+				break;
+			case 'S':
+				softClipped += length; readBases += length;
+				break;
+			case 'H':
+				hardClipped += length;
+				break;
+		}
+	}
+
+	_reads++;
+	_readBases += readBases;
+	_alignedBases += alignedBases;
+	_softClippedBases += softClipped;
+	if(softClipped > 0) _softClippedReads++;
+	if(spliced) _splicedReads++;
+
+	/* mismatches, from the cigar, the MD tag or the NM tag */
+
+	bool knowsPositions = false;
+
+	if(!hasMatchOps) {
+		// =/X cigars spell the mismatches out
+		_mismatchOffsets.clear();
+		int32_t offset = 0;
+		for(auto op = al.CigarData.begin(); op != al.CigarData.end(); op++) {
+			if(op->Type == 'X')
+				for(uint32_t i=0; i<op->Length; i++) _mismatchOffsets.push_back(offset + i);
+			if(op->Type == '=' || op->Type == 'X' || op->Type == 'D') offset += op->Length;
+		}
+		knowsPositions = true;
+	}
+	else if(_useTags) {
+		int32_t editDistance;
+
+		if(al.GetTag("MD", _mdTag) && parseMismatches(_mdTag, _mismatchOffsets))
+			knowsPositions = true;
+		else if(al.GetTag("NM", editDistance) && editDistance >= static_cast<int32_t>(insertedBases + deletedBases)) {
+			_mismatches += editDistance - insertedBases - deletedBases;
+			_mismatchAlignedBases += alignedBases;
+		}
+	}
+
+	if(knowsPositions) {
+		_mismatches += _mismatchOffsets.size();
+		_mismatchAlignedBases += alignedBases;
+		countCycles(al, readBases + hardClipped);
+	}
+}
+
+void AlignmentStatsCollector::countCycles(const BamTools::BamAlignment& al, uint32_t cycles) {
+	if(cycles + 1 > _cycleBaseChanges.size()) {
+		_cycleBaseChanges.resize(cycles + 1, 0);
+		_cycleMismatches.resize(cycles, 0);
+	}
+
+	bool reverse = al.IsReverseStrand();
+	uint32_t cycle = 0;
+	int32_t offset = 0;
+	size_t next = 0;
+
+	for(auto op = al.CigarData.begin(); op != al.CigarData.end(); op++) {
+		uint32_t length = op->Length;
+
+		switch(op->Type) {
+			case 'M': case '=': case 'X': {
+				uint32_t first = reverse ? cycles - cycle - length : cycle;
+				_cycleBaseChanges[first]++;
+				_cycleBaseChanges[first + length]--;
+
+				for(; next < _mismatchOffsets.size() && _mismatchOffsets[next] < offset + static_cast<int32_t>(length); next++) {
+					if(_mismatchOffsets[next] < offset) continue;
+					uint32_t mismatchCycle = cycle + (_mismatchOffsets[next] - offset);
+					_cycleMismatches[reverse ? cycles - 1 - mismatchCycle : mismatchCycle]++;
+				}
+
+				cycle += length;
+				offset += length;
+				break;
+			}
+			case 'I': case 'S': case 'H':
+				cycle += length;
+				break;
+			case 'D':
+				// MD offsets count deleted bases, not skipped ones
+				offset += length;
+				break;
+		}
+	}
+}
+
+void AlignmentStatsCollector::appendJsonImpl(json_t * jsonRootObj) {
+	uint64_t insertions = 0, deletions = 0;
+	for(size_t i=0; i<_insertionHist.size(); i++) insertions += _insertionHist[i];
+	for(size_t i=0; i<_deletionHist.size(); i++) deletions += _deletionHist[i];
+
+	double reads = _reads > 0 ? _reads : 1;
+
+	json_t * j_alignment = json_object();
+	json_object_set_new(j_alignment, "reads", json_integer(_reads));
+	json_object_set_new(j_alignment, "soft_clipped_reads", json_real(_softClippedReads / reads));
+	json_object_set_new(j_alignment, "soft_clip_rate", json_real(_readBases > 0 ? _softClippedBases / static_cast<double>(_readBases) : 0));
+	json_object_set_new(j_alignment, "spliced_reads", json_real(_splicedReads / reads));
+	json_object_set_new(j_alignment, "indel_rate", json_real(_alignedBases > 0 ? (insertions + deletions) / static_cast<double>(_alignedBases) : 0));
+	json_object_set_new(j_alignment, "insertion_hist", lengthsToJson(_insertionHist));
+	json_object_set_new(j_alignment, "deletion_hist", lengthsToJson(_deletionHist));
+
+	// unknown rather than 0 when no read told its mismatches
+	json_object_set_new(j_alignment, "mismatch_rate",
+			_mismatchAlignedBases > 0 ? json_real(_mismatches / static_cast<double>(_mismatchAlignedBases)) : json_null());
+
+	json_t * j_cycles = json_array();
+	int64_t bases = 0;
+	for(size_t i=0; i<_cycleMismatches.size(); i++) {
+		bases += _cycleBaseChanges[i];
+		json_array_append_new(j_cycles, json_real(bases > 0 ? _cycleMismatches[i] / static_cast<double>(bases) : 0));
+	}
+	json_object_set_new(j_alignment, "mismatch_by_cycle", j_cycles);
+
+	json_object_set_new(jsonRootObj, "alignment", j_alignment);
+}
+
+void AlignmentStatsCollector::mergeImpl(const AbstractStatCollector& other) {
+	const AlignmentStatsCollector& otherAlignment = dynamic_cast<const AlignmentStatsCollector&>(other);
+
+	_reads += otherAlignment._reads;
+	_readBases += otherAlignment._readBases;
+	_alignedBases += otherAlignment._alignedBases;
+	_softClippedBases += otherAlignment._softClippedBases;
+	_softClippedReads += otherAlignment._softClippedReads;
+	_splicedReads += otherAlignment._splicedReads;
+	mergeCounts(_insertionHist, otherAlignment._insertionHist);
+	mergeCounts(_deletionHist, otherAlignment._deletionHist);
+
+	_mismatches += otherAlignment._mismatches;
+	_mismatchAlignedBases += otherAlignment._mismatchAlignedBases;
+	mergeCounts(_cycleMismatches, otherAlignment._cycleMismatches);
+	mergeCounts(_cycleBaseChanges, otherAlignment._cycleBaseChanges);
+}
+
+size_t AlignmentStatsCollector::memoryUsageImpl() const {
+	return vectorMemoryUsage(_insertionHist) + vectorMemoryUsage(_deletionHist)
+		+ vectorMemoryUsage(_cycleMismatches) + vectorMemoryUsage(_cycleBaseChanges)
+		+ vectorMemoryUsage(_mismatchOffsets) + _mdTag.capacity();
+}
+
+void AlignmentStatsCollector::saveStateImpl(json_t * stateObj) {
+	json_object_set_new(stateObj, "reads", json_integer(_reads));
+	json_object_set_new(stateObj, "read_bases", json_integer(_readBases));
+	json_object_set_new(stateObj, "aligned_bases", json_integer(_alignedBases));
+	json_object_set_new(stateObj, "soft_clipped_bases", json_integer(_softClippedBases));
+	json_object_set_new(stateObj, "soft_clipped_reads", json_integer(_softClippedReads));
+	json_object_set_new(stateObj, "spliced_reads", json_integer(_splicedReads));
+	json_object_set_new(stateObj, "insertions", countsToJson(_insertionHist));
+	json_object_set_new(stateObj, "deletions", countsToJson(_deletionHist));
+	json_object_set_new(stateObj, "mismatches", json_integer(_mismatches));
+	json_object_set_new(stateObj, "mismatch_aligned_bases", json_integer(_mismatchAlignedBases));
+	json_object_set_new(stateObj, "cycle_mismatches", countsToJson(_cycleMismatches));
+	json_object_set_new(stateObj, "cycle_base_changes", countsToJson(_cycleBaseChanges));
+}
+
+void AlignmentStatsCollector::loadStateImpl(const json_t * stateObj) {
+	_reads = json_integer_value(json_object_get(stateObj, "reads"));
+	_readBases = json_integer_value(json_object_get(stateObj, "read_bases"));
+	_alignedBases = json_integer_value(json_object_get(stateObj, "aligned_bases"));
+	_softClippedBases = json_integer_value(json_object_get(stateObj, "soft_clipped_bases"));
+	_softClippedReads = json_integer_value(json_object_get(stateObj, "soft_clipped_reads"));
+	_splicedReads = json_integer_value(json_object_get(stateObj, "spliced_reads"));
+	countsFromJson(_insertionHist, json_object_get(stateObj, "insertions"));
+	countsFromJson(_deletionHist, json_object_get(stateObj, "deletions"));
+	_mismatches = json_integer_value(json_object_get(stateObj, "mismatches"));
+	_mismatchAlignedBases = json_integer_value(json_object_get(stateObj, "mismatch_aligned_bases"));
+	countsFromJson(_cycleMismatches, json_object_get(stateObj, "cycle_mismatches"));
+	countsFromJson(_cycleBaseChanges, json_object_get(stateObj, "cycle_base_changes"));
+
+	// the changes always reach one past the last cycle
+	if(_cycleBaseChanges.size() < _cycleMismatches.size() + 1) _cycleBaseChanges.resize(_cycleMismatches.size() + 1, 0);
+}
@@ -0,0 +1,88 @@
+#ifndef ALIGNMENTSTATSCOLLECTOR_H
+#define ALIGNMENTSTATSCOLLECTOR_H
+
+#pragma once
+
+#include "AbstractStatCollector.h"
+
+#include <stdint.h>
+
+namespace BamstatsAlive {
+
+	/**
+	 * Alignment quality beyond the mapping quality: clipping, indels,
+	 * splicing and mismatches
+	 *
+	 * Everything but the mismatches comes from the cigar alone, which is
+	 * part of the core record, so the collector walks every read's cigar
+	 * once without decoding any of its variable length fields. Mismatches
+	 * are known from the cigar too when it uses =/X instead of M; otherwise
+	 * they are taken from the MD tag, falling back to the NM tag, which
+	 * only happens when tags are enabled since decoding them costs.
+	 *
+	 * Per cycle counts are kept as the changes a read makes to them at the
+	 * ends of its cigar operations, so that a read costs per operation, not
+	 * per base. Cycles count hard clipped bases, in the direction the read
+	 * was sequenced.
+	 */
+	class AlignmentStatsCollector : public AbstractStatCollector {
+		protected:
+			virtual const char * collectorName() const { return "alignment"; }
+			virtual void processAlignmentImpl(const BamTools::BamAlignment& al, const BamTools::RefVector& refVector);
+			virtual void appendJsonImpl(json_t * jsonRootObj);
+			virtual void mergeImpl(const AbstractStatCollector& other);
+			virtual void saveStateImpl(json_t * stateObj);
+			virtual void loadStateImpl(const json_t * stateObj);
+			virtual size_t memoryUsageImpl() const;
+			virtual unsigned int requiredFieldsImpl() const;
+
+		private:
+			bool _useTags;
+
+			uint64_t _reads;
+			uint64_t _readBases;
+			uint64_t _alignedBases;
+			uint64_t _softClippedBases;
+			uint64_t _softClippedReads;
+			uint64_t _splicedReads;
+			std::vector<uint64_t> _insertionHist;
+			std::vector<uint64_t> _deletionHist;
+
+			// over the reads whose mismatches are known
+			uint64_t _mismatches;
+			uint64_t _mismatchAlignedBases;
+			std::vector<uint64_t> _cycleMismatches;
+			std::vector<int64_t> _cycleBaseChanges;
+
+			// reused from read to read, so that reads do not allocate
+			std::vector<int32_t> _mismatchOffsets;
+			std::string _mdTag;
+
+			/**
+			 * Count the aligned bases and mismatches of a read per cycle
+			 *
+			 * @param cycles The length of the read, hard clipped bases included
+			 */
+			void countCycles(const BamTools::BamAlignment& al, uint32_t cycles);
+
+		public:
+			/**
+			 * @param useTags Whether to read the MD and NM tags for the
+			 *        mismatches of reads whose cigar does not tell them
+			 */
+			AlignmentStatsCollector(bool useTags = false);
+
+			/**
+			 * Find the mismatches an MD tag lists
+			 *
+			 * @param md The value of the MD tag
+			 * @param offsets Receives the offsets of the mismatches from the
+			 *        alignment start, counting the aligned and deleted
+			 *        reference bases but not the skipped ones
+			 * @return false if the tag cannot be parsed
+			 */
+			static bool parseMismatches(const std::string& md, std::vector<int32_t>& offsets);
+	};
+}
+
+#endif
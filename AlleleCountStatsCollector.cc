@@ -0,0 +1,236 @@
+#include "AlleleCountStatsCollector.h"
+#include "TargetCoverageStatsCollector.h"
+
+#include <cstring>
+#include <cctype>
+
+using namespace BamstatsAlive;
+using namespace std;
+
+static const uint32_t kFlagSupplementary = 0x800;
+static const char kAlleleNames[] = "ACGT";
+
+// share of the depth the second allele needs for a heterozygous call
+static const double kHetFraction = 0.2;
+
+// the IUPAC code of two alleles
+static const char kIupacCodes[4][4] = {
+	{ 'A', 'M', 'R', 'W' },
+	{ 'M', 'C', 'S', 'Y' },
+	{ 'R', 'S', 'G', 'K' },
+	{ 'W', 'Y', 'K', 'T' }
+};
+
+namespace {
+	// base letter to its allele, or kAlleles for anything else
+	typedef struct _alleleTableT {
+		uint8_t allele[256];
+
+		_alleleTableT() {
+			memset(allele, AlleleCountStatsCollector::kAlleles, sizeof(allele));
+			for(uint8_t i=0; i<AlleleCountStatsCollector::kAlleles; i++) {
+				allele[static_cast<uint8_t>(kAlleleNames[i])] = i;
+				allele[static_cast<uint8_t>(tolower(kAlleleNames[i]))] = i;
+			}
+		}
+	} AlleleTableT;
+
+	const AlleleTableT kAlleleTable;
+}
+
+AlleleCountStatsCollector::AlleleCountStatsCollector(const VariantSiteList& sites) :
+	AbstractStatCollector(),
+	_sites(sites),
+	_resolved(false),
+	_cursor(0),
+	_lastRefID(-1),
+	_lastPosition(-1),
+	_counts(sites.size() * kAlleles, 0),
+	_basesCounted(0),
+	_basesFiltered(0)
+{
+}
+
+unsigned int AlleleCountStatsCollector::requiredFieldsImpl() const {
+	return kFieldBases | kFieldQualities;
+}
+
+void AlleleCountStatsCollector::resolveSites(const BamTools::RefVector& refVector) {
+	map<string, int32_t> refIDs;
+	for(size_t i=0; i<refVector.size(); i++) refIDs[refVector[i].RefName] = i;
+
+	_cursorSites.clear();
+	for(size_t i=0; i<_sites.size(); i++) {
+		auto refID = refIDs.find(_sites[i].chrom);
+		if(refID == refIDs.end()) continue;
+
+		CursorSiteT cursorSite;
+		cursorSite.refID = refID->second;
+		cursorSite.position = _sites[i].position;
+		cursorSite.site = i;
+		_cursorSites.push_back(cursorSite);
+	}
+
+	sort(_cursorSites.begin(), _cursorSites.end(), [](const CursorSiteT& a, const CursorSiteT& b) {
+		if(a.refID != b.refID) return a.refID < b.refID;
+		return a.position < b.position;
+	});
+
+	_resolved = true;
+}
+
+void AlleleCountStatsCollector::processAlignmentImpl(const BamTools::BamAlignment& al, const BamTools::RefVector& refVector) {
+	if(!al.IsMapped() || !al.IsPrimaryAlignment() || (al.AlignmentFlag & kFlagSupplementary)) return;
+	if(al.IsDuplicate() || al.IsFailedQC() || al.MapQuality < kMinMappingQuality) return;
+
+	if(!_resolved) resolveSites(refVector);
+
+	auto isBefore = [](const CursorSiteT& site, int32_t refID, int32_t position) {
+		return site.refID < refID || (site.refID == refID && site.position < position);
+	};
+
+	// sorted reads only move the cursor forward
+	if(al.RefID < _lastRefID || (al.RefID == _lastRefID && al.Position < _lastPosition)) {
+		_cursor = lower_bound(_cursorSites.begin(), _cursorSites.end(), al, [&isBefore](const CursorSiteT& site, const BamTools::BamAlignment& read) {
+			return isBefore(site, read.RefID, read.Position);
+		}) - _cursorSites.begin();
+	}
+	else {
+		while(_cursor < _cursorSites.size() && isBefore(_cursorSites[_cursor], al.RefID, al.Position)) _cursor++;
+	}
+	_lastRefID = al.RefID;
+	_lastPosition = al.Position;
+
+	// most reads overlap no site
+	if(_cursor == _cursorSites.size() || _cursorSites[_cursor].refID != al.RefID) return;
+	if(_cursorSites[_cursor].position > TargetCoverageStatsCollector::referenceEnd(al)) return;
+
+	const std::string& bases = al.QueryBases;
+	if(bases.empty() || bases == "*") return;
+
+	size_t next = _cursor;
+	int32_t refPos = al.Position;
+	size_t queryPos = 0;
+
+	for(auto op = al.CigarData.begin(); op != al.CigarData.end() && next < _cursorSites.size(); op++) {
+		if(_cursorSites[next].refID != al.RefID) break;
+
+		int32_t opEnd = refPos + static_cast<int32_t>(op->Length);
+
+		switch(op->Type) {
+			case 'M': case '=': case 'X':
+				for(; next < _cursorSites.size() && _cursorSites[next].refID == al.RefID && _cursorSites[next].position < opEnd; next++)
+					countBase(al, queryPos + (_cursorSites[next].position - refPos), _cursorSites[next].site);
+				refPos = opEnd;
+				queryPos += op->Length;
+				break;
+			case 'D': case 'N':
+				// no base of the read is over these sites
+				while(next < _cursorSites.size() && _cursorSites[next].refID == al.RefID && _cursorSites[next].position < opEnd) next++;
+				refPos = opEnd;
+				break;
+			case 'I': case 'S':
+				queryPos += op->Length;
+				break;
+		}
+	}
+}
+
+void AlleleCountStatsCollector::countBase(const BamTools::BamAlignment& al, size_t queryPos, uint32_t site) {
+	if(queryPos >= al.QueryBases.length()) return;
+
+	// reads stored without qualities are taken as they are
+	bool hasQualities = al.Qualities.length() == al.QueryBases.length();
+	uint8_t allele = kAlleleTable.allele[static_cast<uint8_t>(al.QueryBases[queryPos])];
+
+	if(allele == kAlleles || (hasQualities && static_cast<uint8_t>(al.Qualities[queryPos]) < kMinBaseQuality + 33)) {
+		_basesFiltered++;
+		return;
+	}
+
+	_counts[site * kAlleles + allele]++;
+	_basesCounted++;
+}
+
+std::string AlleleCountStatsCollector::fingerprint() const {
+	std::string calls(_sites.size(), '.');
+
+	for(size_t i=0; i<_sites.size(); i++) {
+		const uint32_t * counts = &_counts[i * kAlleles];
+
+		size_t first = 0, second = 1;
+		if(counts[second] > counts[first]) swap(first, second);
+		for(size_t allele=2; allele<kAlleles; allele++) {
+			if(counts[allele] > counts[first]) {
+				second = first;
+				first = allele;
+			}
+			else if(counts[allele] > counts[second]) second = allele;
+		}
+
+		uint32_t depth = counts[0] + counts[1] + counts[2] + counts[3];
+		if(depth < kMinCallDepth) continue;
+
+		calls[i] = counts[second] >= kHetFraction * depth ? kIupacCodes[first][second] : kAlleleNames[first];
+	}
+
+	return calls;
+}
+
+void AlleleCountStatsCollector::appendJsonImpl(json_t * jsonRootObj) {
+	json_t * j_counts = json_object();
+	size_t coveredSites = 0;
+
+	for(size_t i=0; i<_sites.size(); i++) {
+		const uint32_t * counts = &_counts[i * kAlleles];
+		if(counts[0] + counts[1] + counts[2] + counts[3] == 0) continue;
+		coveredSites++;
+
+		json_t * j_site = json_array();
+		for(size_t allele=0; allele<kAlleles; allele++) json_array_append_new(j_site, json_integer(counts[allele]));
+
+		stringstream labelSS; labelSS << _sites[i].chrom << ":" << _sites[i].position + 1;
+		json_object_set_new(j_counts, labelSS.str().c_str(), j_site);
+	}
+
+	std::string calls = fingerprint();
+
+	json_t * j_alleles = json_object();
+	json_object_set_new(j_alleles, "sites", json_integer(_sites.size()));
+	json_object_set_new(j_alleles, "covered_sites", json_integer(coveredSites));
+	json_object_set_new(j_alleles, "called_sites", json_integer(_sites.size() - std::count(calls.begin(), calls.end(), '.')));
+	json_object_set_new(j_alleles, "filtered_bases", json_integer(_basesFiltered));
+	json_object_set_new(j_alleles, "fingerprint", json_string(calls.c_str()));
+	json_object_set_new(j_alleles, "counts", j_counts);
+	json_object_set_new(jsonRootObj, "alleles", j_alleles);
+}
+
+void AlleleCountStatsCollector::mergeImpl(const AbstractStatCollector& other) {
+	const AlleleCountStatsCollector& otherAlleles = dynamic_cast<const AlleleCountStatsCollector&>(other);
+
+	// both count at the same list of sites
+	for(size_t i=0; i<_counts.size() && i<otherAlleles._counts.size(); i++) _counts[i] += otherAlleles._counts[i];
+	_basesCounted += otherAlleles._basesCounted;
+	_basesFiltered += otherAlleles._basesFiltered;
+}
+
+size_t AlleleCountStatsCollector::memoryUsageImpl() const {
+	return vectorMemoryUsage(_counts) + vectorMemoryUsage(_cursorSites);
+}
+
+void AlleleCountStatsCollector::saveStateImpl(json_t * stateObj) {
+	json_t * j_counts = json_array();
+	for(size_t i=0; i<_counts.size(); i++) json_array_append_new(j_counts, json_integer(_counts[i]));
+	json_object_set_new(stateObj, "counts", j_counts);
+
+	json_object_set_new(stateObj, "counted", json_integer(_basesCounted));
+	json_object_set_new(stateObj, "filtered", json_integer(_basesFiltered));
+}
+
+void AlleleCountStatsCollector::loadStateImpl(const json_t * stateObj) {
+	const json_t * j_counts = json_object_get(stateObj, "counts");
+	for(size_t i=0; i<_counts.size(); i++) _counts[i] = json_integer_value(json_array_get(j_counts, i));
+
+	_basesCounted = json_integer_value(json_object_get(stateObj, "counted"));
+	_basesFiltered = json_integer_value(json_object_get(stateObj, "filtered"));
+}
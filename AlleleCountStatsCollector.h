@@ -0,0 +1,93 @@
+#ifndef ALLELECOUNTSTATSCOLLECTOR_H
+#define ALLELECOUNTSTATSCOLLECTOR_H
+
+#pragma once
+
+#include "AbstractStatCollector.h"
+#include "VariantSiteList.h"
+
+#include <stdint.h>
+
+namespace BamstatsAlive {
+
+	/**
+	 * Allele counts at known variant sites, and a genotype fingerprint
+	 * telling samples apart
+	 *
+	 * The sites are ordered like the reads of a coordinate sorted input,
+	 * and a cursor follows the reads along them: a read only costs a
+	 * comparison unless it overlaps a site, in which case its cigar is
+	 * walked to the bases over the sites. Reads coming out of order, as
+	 * after a seek, move the cursor by a binary search.
+	 *
+	 * Only primary, non duplicate reads of good mapping quality count, and
+	 * only their bases of good quality. A site covered deeply enough is
+	 * called from its two most frequent alleles, as one base when
+	 * homozygous or as the IUPAC code of both when heterozygous.
+	 */
+	class AlleleCountStatsCollector : public AbstractStatCollector {
+		public:
+			/** Alleles are counted as A, C, G and T; other bases are left out */
+			static const size_t kAlleles = 4;
+			static const uint16_t kMinMappingQuality = 20;
+			static const uint8_t kMinBaseQuality = 20;
+			/** Depth from which a site is called */
+			static const uint32_t kMinCallDepth = 8;
+
+		protected:
+			virtual const char * collectorName() const { return "alleles"; }
+			virtual void processAlignmentImpl(const BamTools::BamAlignment& al, const BamTools::RefVector& refVector);
+			virtual void appendJsonImpl(json_t * jsonRootObj);
+			virtual void mergeImpl(const AbstractStatCollector& other);
+			virtual void saveStateImpl(json_t * stateObj);
+			virtual void loadStateImpl(const json_t * stateObj);
+			virtual size_t memoryUsageImpl() const;
+			virtual unsigned int requiredFieldsImpl() const;
+
+		private:
+			typedef struct _cursorSiteT {
+				int32_t refID;
+				int32_t position;
+				/** Index of the site in the list */
+				uint32_t site;
+			} CursorSiteT;
+
+			const VariantSiteList& _sites;
+
+			// the sites on the references of the input, in the order of its reads
+			std::vector<CursorSiteT> _cursorSites;
+			bool _resolved;
+			size_t _cursor;
+			int32_t _lastRefID;
+			int32_t _lastPosition;
+
+			// kAlleles counts per site, in the order of the list
+			std::vector<uint32_t> _counts;
+			uint64_t _basesCounted;
+			uint64_t _basesFiltered;
+
+			/**
+			 * Locate the sites on the references of the input
+			 */
+			void resolveSites(const BamTools::RefVector& refVector);
+
+			/**
+			 * Count the base of a read over a site
+			 */
+			void countBase(const BamTools::BamAlignment& al, size_t queryPos, uint32_t site);
+
+			/**
+			 * The call of every site, in the order of the list, with '.'
+			 * for sites not covered deeply enough
+			 */
+			std::string fingerprint() const;
+
+		public:
+			/**
+			 * @param sites The sites counted at, which have to outlive the collector
+			 */
+			AlleleCountStatsCollector(const VariantSiteList& sites);
+	};
+}
+
+#endif
@@ -0,0 +1,76 @@
+#include "BamIndexStats.h"
+
+#include <fstream>
+#include <cstring>
+
+using namespace BamstatsAlive;
+
+static const uint32_t kPseudoBin = 37450;
+
+BamIndexStats::BamIndexStats(const std::string& bamPath) :
+	_loaded(false), _hasUnplacedReads(false), _unplacedReads(0)
+{
+	if(bamPath.empty() || bamPath == "-") return;
+
+	if(parse(bamPath + ".bai")) return;
+
+	size_t ext = bamPath.rfind(".bam");
+	if(ext != std::string::npos && ext == bamPath.length() - 4)
+		parse(bamPath.substr(0, ext) + ".bai");
+}
+
+bool BamIndexStats::parse(const std::string& indexPath) {
+	std::ifstream fs(indexPath.c_str(), std::ios::in | std::ios::binary);
+	if(!fs.good()) return false;
+
+	char magic[4];
+	int32_t refCount;
+	if(!fs.read(magic, 4) || memcmp(magic, "BAI\1", 4) != 0) return false;
+	if(!fs.read(reinterpret_cast<char *>(&refCount), sizeof(refCount)) || refCount < 0) return false;
+
+	std::vector<RefCountsT> refCounts(refCount);
+
+	for(int32_t r=0; r<refCount; r++) {
+		RefCountsT& counts = refCounts[r];
+		counts.mapped = counts.unmapped = 0;
+		counts.known = false;
+
+		int32_t binCount;
+		if(!fs.read(reinterpret_cast<char *>(&binCount), sizeof(binCount))) return false;
+
+		for(int32_t b=0; b<binCount; b++) {
+			uint32_t bin;
+			int32_t chunkCount;
+			if(!fs.read(reinterpret_cast<char *>(&bin), sizeof(bin))) return false;
+			if(!fs.read(reinterpret_cast<char *>(&chunkCount), sizeof(chunkCount))) return false;
+
+			if(bin == kPseudoBin && chunkCount == 2) {
+				// first chunk spans the reference, second one holds the counts
+				uint64_t pseudoChunks[4];
+				if(!fs.read(reinterpret_cast<char *>(pseudoChunks), sizeof(pseudoChunks))) return false;
+				counts.mapped = pseudoChunks[2];
+				counts.unmapped = pseudoChunks[3];
+				counts.known = true;
+			}
+			else {
+				fs.seekg(static_cast<std::streamoff>(chunkCount) * 16, std::ios::cur);
+			}
+		}
+
+		int32_t intervalCount;
+		if(!fs.read(reinterpret_cast<char *>(&intervalCount), sizeof(intervalCount))) return false;
+		fs.seekg(static_cast<std::streamoff>(intervalCount) * 8, std::ios::cur);
+		if(!fs.good()) return false;
+	}
+
+	// the count of reads without coordinates is optional
+	uint64_t unplaced;
+	if(fs.read(reinterpret_cast<char *>(&unplaced), sizeof(unplaced))) {
+		_hasUnplacedReads = true;
+		_unplacedReads = unplaced;
+	}
+
+	_refCounts.swap(refCounts);
+	_loaded = true;
+	return true;
+}
@@ -0,0 +1,52 @@
+#ifndef BAMINDEXSTATS_H
+#define BAMINDEXSTATS_H
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace BamstatsAlive {
+
+	/**
+	 * Read counts recorded in a standard BAM index (.bai)
+	 *
+	 * Besides the binning index, samtools-style indices carry a pseudo-bin
+	 * per reference with the number of mapped and unmapped reads placed on
+	 * it, and a trailing count of reads without coordinates. BamTools does
+	 * not expose these, so the index file is parsed directly.
+	 */
+	class BamIndexStats {
+		public:
+			typedef struct _refCountsT {
+				uint64_t mapped;
+				uint64_t unmapped;
+				bool known;
+			} RefCountsT;
+
+		private:
+			bool _loaded;
+			std::vector<RefCountsT> _refCounts;
+			bool _hasUnplacedReads;
+			uint64_t _unplacedReads;
+
+			bool parse(const std::string& indexPath);
+
+		public:
+			/**
+			 * @param bamPath Path of the BAM file, the index is looked up as
+			 *        <bamPath>.bai or with the .bam extension replaced by .bai
+			 */
+			BamIndexStats(const std::string& bamPath);
+
+			inline bool isLoaded() const { return _loaded; }
+			inline const std::vector<RefCountsT>& refCounts() const { return _refCounts; }
+
+			/** Whether the index records the number of reads without coordinates */
+			inline bool hasUnplacedReadCount() const { return _hasUnplacedReads; }
+			inline uint64_t unplacedReads() const { return _unplacedReads; }
+	};
+}
+
+#endif
@@ -0,0 +1,72 @@
+#include "BamToolsAlignmentReader.h"
+#include "BamIndexStats.h"
+
+using namespace BamstatsAlive;
+
+BamToolsAlignmentReader::BamToolsAlignmentReader() :
+	_fields(0),
+	_indexState(kIndexUnknown),
+	_exactJumpState(kExactUnknown)
+{
+}
+
+bool BamToolsAlignmentReader::open(const std::string& filename, const AlignmentReaderOptionsT& options) {
+	_filename = filename;
+	_fields = options.fields;
+
+	_reader.Open(filename);
+	return _reader.IsOpen();
+}
+
+bool BamToolsAlignmentReader::getNextAlignment(BamTools::BamAlignment& al) {
+	if(_fields == 0) return _reader.GetNextAlignmentCore(al);
+	return _reader.GetNextAlignment(al);
+}
+
+bool BamToolsAlignmentReader::getNextAlignmentCore(BamTools::BamAlignment& al) {
+	return _reader.GetNextAlignmentCore(al);
+}
+
+void BamToolsAlignmentReader::buildCharData(BamTools::BamAlignment& al) {
+	if(_fields != 0) al.BuildCharData();
+}
+
+void BamToolsAlignmentReader::setFields(unsigned int fields) {
+	_fields = fields;
+}
+
+const BamTools::RefVector& BamToolsAlignmentReader::referenceData() const {
+	return _reader.GetReferenceData();
+}
+
+std::string BamToolsAlignmentReader::headerText() const {
+	return _reader.GetHeaderText();
+}
+
+BamTools::SamHeader BamToolsAlignmentReader::header() const {
+	return _reader.GetHeader();
+}
+
+bool BamToolsAlignmentReader::jump(int32_t refID, int32_t position) {
+
+	// BamTools stops at reads without coordinates after a jump, so the
+	// jump is only exact when the index says there are none
+	if(_exactJumpState == kExactUnknown) {
+		BamIndexStats indexStats(_filename);
+		bool exact = indexStats.isLoaded() && indexStats.hasUnplacedReadCount() && indexStats.unplacedReads() == 0;
+		_exactJumpState = exact ? kExactYes : kExactNo;
+	}
+	if(_exactJumpState == kExactNo) return false;
+
+	return seek(refID, position);
+}
+
+bool BamToolsAlignmentReader::seek(int32_t refID, int32_t position) {
+
+	// locating the index loads it, so do it once for all seeks
+	if(_indexState == kIndexUnknown)
+		_indexState = _reader.LocateIndex() ? kIndexLoaded : kIndexMissing;
+	if(_indexState == kIndexMissing) return false;
+
+	return _reader.Jump(refID, position);
+}
@@ -0,0 +1,45 @@
+#ifndef BAMTOOLSALIGNMENTREADER_H
+#define BAMTOOLSALIGNMENTREADER_H
+
+#pragma once
+
+#include "AlignmentReader.h"
+
+namespace BamstatsAlive {
+
+	/**
+	 * Reads BAM input through BamTools
+	 *
+	 * BamTools decodes either none or all of the variable length fields, so
+	 * the char data is only built when any field is requested.
+	 */
+	class BamToolsAlignmentReader : public AlignmentReader {
+		private:
+			BamTools::BamReader _reader;
+			std::string _filename;
+			unsigned int _fields;
+
+			// whether the index has been looked up, and what was found
+			enum { kIndexUnknown, kIndexMissing, kIndexLoaded } _indexState;
+			enum { kExactUnknown, kExactNo, kExactYes } _exactJumpState;
+
+		public:
+			BamToolsAlignmentReader();
+
+			bool open(const std::string& filename, const AlignmentReaderOptionsT& options);
+
+			virtual bool getNextAlignment(BamTools::BamAlignment& al);
+			virtual bool getNextAlignmentCore(BamTools::BamAlignment& al);
+			virtual void buildCharData(BamTools::BamAlignment& al);
+			virtual void setFields(unsigned int fields);
+
+			virtual const BamTools::RefVector& referenceData() const;
+			virtual std::string headerText() const;
+			virtual BamTools::SamHeader header() const;
+
+			virtual bool jump(int32_t refID, int32_t position);
+			virtual bool seek(int32_t refID, int32_t position);
+	};
+}
+
+#endif
@@ -0,0 +1,147 @@
+#include "BaseCompositionStatsCollector.h"
+
+#include <cstring>
+#include <cctype>
+
+using namespace BamstatsAlive;
+using namespace std;
+
+static const uint32_t kFlagSupplementary = 0x800;
+static const char kBaseNames[] = "ACGTN";
+
+namespace {
+	// base letter to its kind, as read and complemented, so that a base
+	// costs one lookup whichever strand it is on
+	typedef struct _baseTableT {
+		uint8_t forward[256];
+		uint8_t complement[256];
+
+		_baseTableT() {
+			memset(forward, 4, sizeof(forward));
+			memset(complement, 4, sizeof(complement));
+			for(uint8_t kind=0; kind<4; kind++) {
+				forward[static_cast<uint8_t>(kBaseNames[kind])] = kind;
+				forward[static_cast<uint8_t>(tolower(kBaseNames[kind]))] = kind;
+				complement[static_cast<uint8_t>(kBaseNames[kind])] = 3 - kind;
+				complement[static_cast<uint8_t>(tolower(kBaseNames[kind]))] = 3 - kind;
+			}
+		}
+	} BaseTableT;
+
+	const BaseTableT kBaseTable;
+}
+
+BaseCompositionStatsCollector::BaseCompositionStatsCollector() : AbstractStatCollector() {
+	memset(_gcHist, 0, sizeof(_gcHist));
+	memset(_baseCounts, 0, sizeof(_baseCounts));
+}
+
+unsigned int BaseCompositionStatsCollector::requiredFieldsImpl() const {
+	return kFieldBases;
+}
+
+void BaseCompositionStatsCollector::processAlignmentImpl(const BamTools::BamAlignment& al, const BamTools::RefVector& refVector) {
+	if(!al.IsPrimaryAlignment() || (al.AlignmentFlag & kFlagSupplementary)) return;
+
+	const std::string& bases = al.QueryBases;
+	size_t length = bases.length();
+	if(length == 0 || bases == "*") return;
+
+	bool reverse = al.IsReverseStrand();
+
+	// hard clipped bases sequenced before the stored ones
+	uint32_t clipped = 0;
+	if(!al.CigarData.empty()) {
+		const BamTools::CigarOp& first = reverse ? al.CigarData.back() : al.CigarData.front();
+		if(first.Type == 'H') clipped = first.Length;
+	}
+
+	size_t cycles = clipped + length;
+	if(cycles * kBaseKinds > _cycleCounts.size()) _cycleCounts.resize(cycles * kBaseKinds, 0);
+
+	uint64_t counts[kBaseKinds] = { 0 };
+	const uint8_t * table = reverse ? kBaseTable.complement : kBaseTable.forward;
+	uint64_t * cycleCounts = &_cycleCounts[clipped * kBaseKinds];
+
+	for(size_t i=0; i<length; i++) {
+		uint8_t kind = table[static_cast<uint8_t>(bases[i])];
+		size_t cycle = reverse ? length - 1 - i : i;
+
+		counts[kind]++;
+		cycleCounts[cycle * kBaseKinds + kind]++;
+	}
+
+	for(size_t kind=0; kind<kBaseKinds; kind++) _baseCounts[kind] += counts[kind];
+
+	uint64_t called = counts[0] + counts[1] + counts[2] + counts[3];
+	if(called > 0) _gcHist[((counts[1] + counts[2]) * 100 + called / 2) / called]++;
+}
+
+void BaseCompositionStatsCollector::appendJsonImpl(json_t * jsonRootObj) {
+	json_t * j_gc_hist = json_object();
+	for(size_t i=0; i<kGcBins; i++) {
+		if(_gcHist[i] == 0) continue;
+		stringstream labelSS; labelSS << i;
+		json_object_set_new(j_gc_hist, labelSS.str().c_str(), json_integer(_gcHist[i]));
+	}
+	json_object_set_new(jsonRootObj, "gc_hist", j_gc_hist);
+
+	uint64_t called = _baseCounts[0] + _baseCounts[1] + _baseCounts[2] + _baseCounts[3];
+	json_object_set_new(jsonRootObj, "gc_content", json_real(called > 0 ? (_baseCounts[1] + _baseCounts[2]) / static_cast<double>(called) : 0));
+
+	// the fraction of each base per cycle
+	json_t * j_composition = json_object();
+	size_t cycles = _cycleCounts.size() / kBaseKinds;
+	for(size_t kind=0; kind<kBaseKinds; kind++) {
+		json_t * j_cycles = json_array();
+		for(size_t cycle=0; cycle<cycles; cycle++) {
+			const uint64_t * counts = &_cycleCounts[cycle * kBaseKinds];
+			uint64_t total = counts[0] + counts[1] + counts[2] + counts[3] + counts[4];
+			json_array_append_new(j_cycles, json_real(total > 0 ? counts[kind] / static_cast<double>(total) : 0));
+		}
+		char name[2] = { kBaseNames[kind], '\0' };
+		json_object_set_new(j_composition, name, j_cycles);
+	}
+	json_object_set_new(jsonRootObj, "base_composition", j_composition);
+}
+
+void BaseCompositionStatsCollector::mergeImpl(const AbstractStatCollector& other) {
+	const BaseCompositionStatsCollector& otherComposition = dynamic_cast<const BaseCompositionStatsCollector&>(other);
+
+	for(size_t i=0; i<kGcBins; i++) _gcHist[i] += otherComposition._gcHist[i];
+	for(size_t kind=0; kind<kBaseKinds; kind++) _baseCounts[kind] += otherComposition._baseCounts[kind];
+
+	if(otherComposition._cycleCounts.size() > _cycleCounts.size()) _cycleCounts.resize(otherComposition._cycleCounts.size(), 0);
+	for(size_t i=0; i<otherComposition._cycleCounts.size(); i++) _cycleCounts[i] += otherComposition._cycleCounts[i];
+}
+
+size_t BaseCompositionStatsCollector::memoryUsageImpl() const {
+	return sizeof(_gcHist) + sizeof(_baseCounts) + vectorMemoryUsage(_cycleCounts);
+}
+
+void BaseCompositionStatsCollector::saveStateImpl(json_t * stateObj) {
+	json_t * j_gc = json_array();
+	for(size_t i=0; i<kGcBins; i++) json_array_append_new(j_gc, json_integer(_gcHist[i]));
+	json_object_set_new(stateObj, "gc", j_gc);
+
+	json_t * j_bases = json_array();
+	for(size_t kind=0; kind<kBaseKinds; kind++) json_array_append_new(j_bases, json_integer(_baseCounts[kind]));
+	json_object_set_new(stateObj, "bases", j_bases);
+
+	json_t * j_cycles = json_array();
+	for(size_t i=0; i<_cycleCounts.size(); i++) json_array_append_new(j_cycles, json_integer(_cycleCounts[i]));
+	json_object_set_new(stateObj, "cycles", j_cycles);
+}
+
+void BaseCompositionStatsCollector::loadStateImpl(const json_t * stateObj) {
+	const json_t * j_gc = json_object_get(stateObj, "gc");
+	for(size_t i=0; i<kGcBins; i++) _gcHist[i] = json_integer_value(json_array_get(j_gc, i));
+
+	const json_t * j_bases = json_object_get(stateObj, "bases");
+	for(size_t kind=0; kind<kBaseKinds; kind++) _baseCounts[kind] = json_integer_value(json_array_get(j_bases, kind));
+
+	// whole cycles only
+	const json_t * j_cycles = json_object_get(stateObj, "cycles");
+	_cycleCounts.assign(json_array_size(j_cycles) / kBaseKinds * kBaseKinds, 0);
+	for(size_t i=0; i<_cycleCounts.size(); i++) _cycleCounts[i] = json_integer_value(json_array_get(j_cycles, i));
+}
@@ -0,0 +1,51 @@
+#ifndef BASECOMPOSITIONSTATSCOLLECTOR_H
+#define BASECOMPOSITIONSTATSCOLLECTOR_H
+
+#pragma once
+
+#include "AbstractStatCollector.h"
+
+#include <stdint.h>
+
+namespace BamstatsAlive {
+
+	/**
+	 * GC content and base composition of the reads
+	 *
+	 * Every primary read adds its GC fraction, over its A, C, G and T bases,
+	 * to a histogram of 1% bins, and its bases to the A/C/G/T/N counts of
+	 * the cycles they were sequenced in. Reverse strand reads are stored
+	 * reverse complemented, so they are turned back before counting; hard
+	 * clipped bases are not in the sequence but still take up cycles.
+	 *
+	 * This is the only collector looking at the bases, so it is only part
+	 * of a job when asked for, and the reads' bases are only decoded then.
+	 */
+	class BaseCompositionStatsCollector : public AbstractStatCollector {
+		public:
+			/** Bases are counted as A, C, G, T, and N for anything else */
+			static const size_t kBaseKinds = 5;
+			static const size_t kGcBins = 101;
+
+		protected:
+			virtual const char * collectorName() const { return "base_composition"; }
+			virtual void processAlignmentImpl(const BamTools::BamAlignment& al, const BamTools::RefVector& refVector);
+			virtual void appendJsonImpl(json_t * jsonRootObj);
+			virtual void mergeImpl(const AbstractStatCollector& other);
+			virtual void saveStateImpl(json_t * stateObj);
+			virtual void loadStateImpl(const json_t * stateObj);
+			virtual size_t memoryUsageImpl() const;
+			virtual unsigned int requiredFieldsImpl() const;
+
+		private:
+			uint64_t _gcHist[kGcBins];
+			uint64_t _baseCounts[kBaseKinds];
+			// kBaseKinds counts per cycle
+			std::vector<uint64_t> _cycleCounts;
+
+		public:
+			BaseCompositionStatsCollector();
+	};
+}
+
+#endif
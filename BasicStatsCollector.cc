@@ -7,7 +7,7 @@ using namespace BamstatsAlive;
 static const unsigned int kCMTrailLength = 5;
 static const double kCMThreshold = 0.001;
 
-BasicStatsCollector::BasicStatsCollector() {
+BasicStatsCollector::BasicStatsCollector() : _sampler(NULL), _counting(true) {
 
 	_stats.clear();
 
@@ -47,7 +47,13 @@ BasicStatsCollector::BasicStatsCollector() {
 	_monitors[kSingletons] 			= new StandardDeviationChangeMonitor<double>(kCMTrailLength, kCMThreshold);
 }
 
+BasicStatsCollector::~BasicStatsCollector() {
+	for(auto it = _monitors.begin(); it != _monitors.end(); it++) delete it->second;
+}
+
 void BasicStatsCollector::processAlignmentImpl(const BamTools::BamAlignment& al, const BamTools::RefVector& refVector) {
+	if(!_counting) return;
+
 	// increment total alignment counter
 	++_stats[kTotalReads];
 
@@ -92,6 +98,11 @@ void BasicStatsCollector::processAlignmentImpl(const BamTools::BamAlignment& al,
 }
 
 void BasicStatsCollector::appendJsonImpl(json_t * jsonRootObj) {
+	if(!_counting) {
+		if(_sampler != NULL && _sampler->isActive()) json_object_set_new(jsonRootObj, "sampling", _sampler->toJson());
+		return;
+	}
+
 	StatMapT::iterator sIter;
 	for(sIter = _stats.begin(); sIter != _stats.end(); sIter++) {
 		json_object_set_new(jsonRootObj, sIter->first.c_str(), json_integer(sIter->second));
@@ -102,5 +113,49 @@ void BasicStatsCollector::appendJsonImpl(json_t * jsonRootObj) {
 		dynamic_cast<StandardDeviationChangeMonitor<double> *>(cIter->second)->addValue(_stats[cIter->first] / static_cast<double>(_stats[kTotalReads]));
 	}
 
+	// scale the sampled counts to all reads seen
+	if(_sampler != NULL && _sampler->isActive()) {
+		json_object_set_new(jsonRootObj, "sampling", _sampler->toJson());
+
+		json_t * j_estimates = json_object();
+		for(sIter = _stats.begin(); sIter != _stats.end(); sIter++) {
+			if(sIter->first == kTotalReads || sIter->first == kLastReadPos) continue;
+			json_object_set_new(j_estimates, sIter->first.c_str(), _sampler->estimateJson(sIter->second));
+		}
+		json_object_set_new(jsonRootObj, "estimates", j_estimates);
+	}
+
 	bool consensus = true;
 }
+
+void BasicStatsCollector::mergeImpl(const AbstractStatCollector& other) {
+	const BasicStatsCollector& otherBasic = dynamic_cast<const BasicStatsCollector&>(other);
+
+	StatMapT::const_iterator sIter;
+	for(sIter = otherBasic._stats.begin(); sIter != otherBasic._stats.end(); sIter++) {
+		// last read position is not additive, keep the furthest one
+		if(sIter->first == kLastReadPos) {
+			if(sIter->second > _stats[kLastReadPos]) _stats[kLastReadPos] = sIter->second;
+			continue;
+		}
+		_stats[sIter->first] += sIter->second;
+	}
+}
+
+size_t BasicStatsCollector::memoryUsageImpl() const {
+	return mapMemoryUsage(_stats) + mapMemoryUsage(_monitors);
+}
+
+void BasicStatsCollector::saveStateImpl(json_t * stateObj) {
+	StatMapT::iterator sIter;
+	for(sIter = _stats.begin(); sIter != _stats.end(); sIter++) {
+		json_object_set_new(stateObj, sIter->first.c_str(), json_integer(sIter->second));
+	}
+}
+
+void BasicStatsCollector::loadStateImpl(const json_t * stateObj) {
+	StatMapT::iterator sIter;
+	for(sIter = _stats.begin(); sIter != _stats.end(); sIter++) {
+		sIter->second = json_integer_value(json_object_get(stateObj, sIter->first.c_str()));
+	}
+}
@@ -5,6 +5,7 @@
 
 #include "AbstractStatCollector.h"
 #include "AbstractChangeMonitor.h"
+#include "ReadSampler.h"
 
 namespace BamstatsAlive {
 
@@ -30,12 +31,34 @@ namespace BamstatsAlive {
 		protected:
 			StatMapT _stats;
 			ChangeMonitorMapT _monitors;
+			const ReadSampler * _sampler;
+			bool _counting;
 
+			virtual const char * collectorName() const { return "basic"; }
 			virtual void processAlignmentImpl(const BamTools::BamAlignment& al, const BamTools::RefVector& refVector);
 			virtual void appendJsonImpl(json_t * jsonRootObj);
+			virtual void mergeImpl(const AbstractStatCollector& other);
+			virtual void saveStateImpl(json_t * stateObj);
+			virtual void loadStateImpl(const json_t * stateObj);
+			virtual size_t memoryUsageImpl() const;
 
 		public:
 			BasicStatsCollector();
+			virtual ~BasicStatsCollector();
+
+			/**
+			 * Report counts of a sampled stream together with estimates
+			 * scaled to every read the sampler has seen
+			 *
+			 * @param sampler The sampler in front of the collector tree, or NULL
+			 */
+			inline void setSampler(const ReadSampler * sampler) { _sampler = sampler; }
+
+			/**
+			 * Keep and report the read counters, or only pass the reads on to
+			 * the children when the counters are not asked for
+			 */
+			inline void setCounting(bool counting) { _counting = counting; }
 	};
 }
 
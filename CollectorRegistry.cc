@@ -0,0 +1,117 @@
+#include "CollectorRegistry.h"
+
+using namespace BamstatsAlive;
+
+const CollectorRegistry::EntryT CollectorRegistry::kEntries[] = {
+	{ "basic", kCollectBasic, "read counters: total, mapped, paired, strands, duplicates, failed QC" },
+	{ "mapq", kCollectMapq, "mapping quality histogram and quantiles" },
+	{ "baseq", kCollectBaseq, "base quality histogram of the reads in the regions" },
+	{ "length", kCollectLength, "read length histogram and quantiles" },
+	{ "frag", kCollectFrag, "fragment size histogram and quantiles" },
+	{ "refaln", kCollectRefAln, "reads per reference" },
+	{ "coverage", kCollectCoverage, "coverage histogram of the sampled regions" },
+	{ "duplication", kCollectDuplication, "duplicate rate and library complexity" },
+	{ "alignment", kCollectAlignment, "clipping, indels and mismatches from the cigars" },
+	{ "gc", kCollectGc, "GC content and base composition" },
+	{ "pairing", kCollectPairing, "mate pairing of name sorted input" },
+	{ "alleles", kCollectAlleles, "allele counts and a genotype fingerprint at the sites given with -V" },
+	{ "orientation", kCollectOrientation, "pair orientation and strand balance per reference" },
+	{ "ploidy", kCollectPloidy, "read density per reference, sex call and aneuploid autosomes" }
+};
+
+const size_t CollectorRegistry::kEntryCount = sizeof(kEntries) / sizeof(kEntries[0]);
+
+bool CollectorRegistry::parseSelection(const std::string& spec, unsigned int& collectors) {
+	unsigned int selected = 0;
+
+	size_t start = 0;
+	while(start <= spec.length()) {
+		size_t comma = spec.find(',', start);
+		if(comma == std::string::npos) comma = spec.length();
+		std::string name = spec.substr(start, comma - start);
+		start = comma + 1;
+
+		if(name == "all") {
+			selected |= kAllCollectors;
+			continue;
+		}
+		if(name == "default") {
+			selected |= kDefaultCollectors;
+			continue;
+		}
+
+		size_t i = 0;
+		while(i < kEntryCount && name != kEntries[i].name) i++;
+		if(i == kEntryCount) return false;
+		selected |= kEntries[i].collector;
+	}
+
+	collectors = selected;
+	return true;
+}
+
+CollectorSet::CollectorSet(unsigned int collectors,
+		std::map<int32_t, std::string>& chromIDNameMap,
+		const GenomicRegionStore * regionStore,
+		unsigned int coverageSkipFactor,
+		bool mismatchTags,
+		const VariantSiteList * variantSites) :
+	histogram(NULL),
+	duplication(NULL),
+	alignment(NULL),
+	composition(NULL),
+	pairing(NULL),
+	alleles(NULL),
+	orientation(NULL),
+	ploidy(NULL),
+	_collectors(collectors)
+{
+	if(collectors & CollectorRegistry::kHistogramCollectors) {
+		// the regions are only walked for the statistics kept in them
+		bool needsRegions = collectors & (CollectorRegistry::kCollectCoverage | CollectorRegistry::kCollectBaseq);
+		histogram = new HistogramStatsCollector(chromIDNameMap, coverageSkipFactor, needsRegions ? regionStore : NULL);
+		histogram->setSelection(collectors);
+	}
+
+	if(collectors & CollectorRegistry::kCollectDuplication) duplication = new DuplicationStatsCollector();
+	if(collectors & CollectorRegistry::kCollectAlignment) alignment = new AlignmentStatsCollector(mismatchTags);
+	if(collectors & CollectorRegistry::kCollectGc) composition = new BaseCompositionStatsCollector();
+
+	if(collectors & CollectorRegistry::kCollectPairing) {
+		pairing = new MatePairingStatsCollector();
+		pairing->setFragmentSink(histogram);
+	}
+
+	if((collectors & CollectorRegistry::kCollectAlleles) && variantSites) alleles = new AlleleCountStatsCollector(*variantSites);
+	if(collectors & CollectorRegistry::kCollectOrientation) orientation = new OrientationStatsCollector();
+	if(collectors & CollectorRegistry::kCollectPloidy) ploidy = new PloidyStatsCollector();
+}
+
+CollectorSet::~CollectorSet() {
+	if(histogram) delete histogram;
+	if(duplication) delete duplication;
+	if(alignment) delete alignment;
+	if(composition) delete composition;
+	if(pairing) delete pairing;
+	if(alleles) delete alleles;
+	if(orientation) delete orientation;
+	if(ploidy) delete ploidy;
+}
+
+void CollectorSet::attachTo(BasicStatsCollector& root) {
+	root.setCounting(_collectors & CollectorRegistry::kCollectBasic);
+
+	if(histogram) root.addChild(histogram);
+	if(duplication) root.addChild(duplication);
+	if(alignment) root.addChild(alignment);
+	if(composition) root.addChild(composition);
+	if(pairing) root.addChild(pairing);
+	if(alleles) root.addChild(alleles);
+	if(orientation) root.addChild(orientation);
+	if(ploidy) root.addChild(ploidy);
+}
+
+void CollectorSet::setNameSorted(bool nameSorted) {
+	if(histogram) histogram->setNameSorted(nameSorted);
+	if(pairing) pairing->setActive(nameSorted);
+}
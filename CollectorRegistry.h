@@ -0,0 +1,133 @@
+#ifndef COLLECTORREGISTRY_H
+#define COLLECTORREGISTRY_H
+
+#pragma once
+
+#include "BasicStatsCollector.h"
+#include "HistogramStatsCollector.h"
+#include "DuplicationStatsCollector.h"
+#include "AlignmentStatsCollector.h"
+#include "BaseCompositionStatsCollector.h"
+#include "MatePairingStatsCollector.h"
+#include "AlleleCountStatsCollector.h"
+#include "OrientationStatsCollector.h"
+#include "PloidyStatsCollector.h"
+
+namespace BamstatsAlive {
+
+	/**
+	 * The named statistics a job can be asked for
+	 *
+	 * Every statistic has a name used to select it on the command line or
+	 * in a server request. Statistics that are not selected are neither
+	 * computed nor reported, and the fields only they read are not
+	 * decoded, so a job asking for the counters alone reads little more
+	 * than the fixed part of every record.
+	 */
+	class CollectorRegistry {
+		public:
+			enum CollectorT {
+				kCollectBasic = 1,
+				kCollectMapq = 2,
+				kCollectBaseq = 4,
+				kCollectLength = 8,
+				kCollectFrag = 16,
+				kCollectRefAln = 32,
+				kCollectCoverage = 64,
+				kCollectDuplication = 128,
+				kCollectAlignment = 256,
+				kCollectGc = 512,
+				kCollectPairing = 1024,
+				kCollectAlleles = 2048,
+				kCollectOrientation = 4096,
+				kCollectPloidy = 8192
+			};
+
+			/** The statistics kept by HistogramStatsCollector */
+			static const unsigned int kHistogramCollectors =
+				kCollectMapq | kCollectBaseq | kCollectLength | kCollectFrag | kCollectRefAln | kCollectCoverage;
+
+			/**
+			 * Everything but the GC content and the allele counts, which need
+			 * the bases decoded, and the ploidy, which adds a frame ahead of the reads
+			 */
+			static const unsigned int kDefaultCollectors =
+				kCollectBasic | kHistogramCollectors | kCollectDuplication | kCollectAlignment | kCollectPairing | kCollectOrientation;
+
+			static const unsigned int kAllCollectors = kDefaultCollectors | kCollectGc | kCollectAlleles | kCollectPloidy;
+
+			typedef struct _entryT {
+				const char * name;
+				CollectorT collector;
+				const char * description;
+			} EntryT;
+
+			static const EntryT kEntries[];
+			static const size_t kEntryCount;
+
+			/**
+			 * Parse a comma separated list of statistic names, where "all"
+			 * and "default" stand for the respective sets
+			 *
+			 * @param spec e.g. "basic,coverage"
+			 * @param collectors Receives the CollectorT bits
+			 * @return false if a name is not known
+			 */
+			static bool parseSelection(const std::string& spec, unsigned int& collectors);
+	};
+
+	/**
+	 * The per-read collectors of a collector tree, as selected
+	 *
+	 * Job, targeted worker and read group trees all hold one of these, so
+	 * that they are assembled alike and can be merged. Collectors that are
+	 * not selected are NULL.
+	 */
+	class CollectorSet {
+		public:
+			HistogramStatsCollector * histogram;
+			DuplicationStatsCollector * duplication;
+			AlignmentStatsCollector * alignment;
+			BaseCompositionStatsCollector * composition;
+			MatePairingStatsCollector * pairing;
+			AlleleCountStatsCollector * alleles;
+			OrientationStatsCollector * orientation;
+			PloidyStatsCollector * ploidy;
+
+		private:
+			unsigned int _collectors;
+
+		public:
+			/**
+			 * @param collectors The CollectorRegistry::CollectorT bits selected
+			 * @param chromIDNameMap Reference names, filled in once the input is open
+			 * @param regionStore The sampled regions of the coverage histogram, or NULL
+			 * @param coverageSkipFactor Only 1 in every skipFactor region is sampled
+			 * @param mismatchTags Whether mismatches are read from the MD and NM tags
+			 * @param variantSites The sites alleles are counted at, or NULL
+			 */
+			CollectorSet(unsigned int collectors,
+					std::map<int32_t, std::string>& chromIDNameMap,
+					const GenomicRegionStore * regionStore = NULL,
+					unsigned int coverageSkipFactor = 0,
+					bool mismatchTags = false,
+					const VariantSiteList * variantSites = NULL);
+			~CollectorSet();
+
+			CollectorSet(const CollectorSet&) = delete;
+			CollectorSet& operator=(const CollectorSet&) = delete;
+
+			/**
+			 * Add the collectors as children of a tree's root, and have the
+			 * root keep its counters only if they are selected
+			 */
+			void attachTo(BasicStatsCollector& root);
+
+			/**
+			 * Switch the collectors to an input sorted by name, or not sorted
+			 */
+			void setNameSorted(bool nameSorted);
+	};
+}
+
+#endif
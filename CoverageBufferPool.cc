@@ -0,0 +1,82 @@
+#include "CoverageBufferPool.h"
+
+using namespace BamstatsAlive;
+
+CoverageBufferPool::CoverageBufferPool() : _largestCapacity(0) {
+	_free.clear();
+	_inUse.clear();
+}
+
+CoverageBufferPool::~CoverageBufferPool() {
+	for(auto it = _free.begin(); it != _free.end(); it++) delete [] it->data;
+	for(auto it = _inUse.begin(); it != _inUse.end(); it++) delete [] it->data;
+}
+
+CoverageBufferPool::valueT * CoverageBufferPool::acquire(size_t length) {
+
+	// reuse a free buffer that is large enough, zeroing only what was touched
+	for(auto it = _free.begin(); it != _free.end(); it++) {
+		if(it->capacity < length) continue;
+
+		BufferT buffer = *it;
+		_free.erase(it);
+
+		memset(buffer.data, 0, sizeof(valueT) * buffer.dirtyLength);
+		buffer.dirtyLength = 0;
+
+		_inUse.push_back(buffer);
+		return buffer.data;
+	}
+
+	// none fits, so drop the smaller free buffers and grow to the largest seen
+	for(auto it = _free.begin(); it != _free.end(); it++) delete [] it->data;
+	_free.clear();
+
+	if(length > _largestCapacity) _largestCapacity = length;
+
+	BufferT buffer;
+	buffer.capacity = _largestCapacity;
+	buffer.data = new valueT [buffer.capacity]();
+	buffer.dirtyLength = 0;
+
+	LOGS<<"CoverageBufferPool grows to "<<buffer.capacity<<std::endl;
+
+	_inUse.push_back(buffer);
+	return buffer.data;
+}
+
+void CoverageBufferPool::release(valueT * buffer, size_t touchedLength) {
+	if(buffer == NULL) return;
+
+	for(auto it = _inUse.begin(); it != _inUse.end(); it++) {
+		if(it->data != buffer) continue;
+
+		BufferT released = *it;
+		_inUse.erase(it);
+
+		released.dirtyLength = touchedLength < released.capacity ? touchedLength : released.capacity;
+		_free.push_back(released);
+		return;
+	}
+
+	assert(false && "releasing a buffer not owned by the pool");
+}
+
+size_t CoverageBufferPool::memoryUsage() const {
+	size_t elements = 0;
+	for(auto it = _free.begin(); it != _free.end(); it++) elements += it->capacity;
+	for(auto it = _inUse.begin(); it != _inUse.end(); it++) elements += it->capacity;
+	return elements * sizeof(valueT) + (_free.capacity() + _inUse.capacity()) * sizeof(BufferT);
+}
+
+bool CoverageBufferPool::trim() {
+	if(_free.empty()) return false;
+
+	for(auto it = _free.begin(); it != _free.end(); it++) delete [] it->data;
+	_free.clear();
+
+	_largestCapacity = 0;
+	for(auto it = _inUse.begin(); it != _inUse.end(); it++)
+		if(it->capacity > _largestCapacity) _largestCapacity = it->capacity;
+	return true;
+}
@@ -0,0 +1,77 @@
+#ifndef COVERAGEBUFFERPOOL_H
+#define COVERAGEBUFFERPOOL_H
+
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+#include <cstring>
+
+namespace BamstatsAlive {
+
+	/**
+	 * A recycling allocator for per-region coverage arrays
+	 *
+	 * Every time the read stream enters a new region, a zero filled coverage
+	 * array spanning the region is needed, and it is thrown away once the
+	 * stream leaves the region. For panels with many small targets, fresh
+	 * allocation and zeroing of those arrays dominates the region switch.
+	 *
+	 * The pool hands out buffers that are at least as large as requested,
+	 * grows buffers to the largest capacity seen so far, and only re-zeroes
+	 * the span that the previous user actually touched.
+	 */
+	class CoverageBufferPool {
+		public:
+			typedef unsigned int valueT;
+
+		private:
+			typedef struct _bufferT {
+				valueT * data;
+				size_t capacity;
+				size_t dirtyLength;
+			} BufferT;
+
+			std::vector<BufferT> _free;
+			std::vector<BufferT> _inUse;
+			size_t _largestCapacity;
+
+		public:
+			CoverageBufferPool();
+			~CoverageBufferPool();
+
+			/**
+			 * Obtain a zero filled buffer
+			 *
+			 * @param length The number of elements needed
+			 * @return A buffer of at least length elements, all zero
+			 */
+			valueT * acquire(size_t length);
+
+			/**
+			 * Return a buffer to the pool
+			 *
+			 * @param buffer A buffer previously obtained through acquire()
+			 * @param touchedLength Number of leading elements that may be non-zero
+			 */
+			void release(valueT * buffer, size_t touchedLength);
+
+			inline size_t largestCapacity() const { return _largestCapacity; }
+
+			/**
+			 * The memory held by the buffers, free or in use, in bytes
+			 */
+			size_t memoryUsage() const;
+
+			/**
+			 * Free the buffers not in use, and forget the largest length
+			 * seen, so that later buffers are only as large as needed
+			 *
+			 * @return false if there was nothing to free
+			 */
+			bool trim();
+	};
+}
+
+#endif
@@ -0,0 +1,138 @@
+#include "CoverageHistogram.h"
+
+using namespace BamstatsAlive;
+using namespace std;
+
+// the cap has to reach the first log bin that splits a doubling in eight
+static const CoverageHistogram::depthT kMinExactDepths = 8;
+
+CoverageHistogram::CoverageHistogram(depthT exactDepths) :
+	_positions(0),
+	_depthSum(0)
+{
+	setExactDepths(exactDepths);
+}
+
+void CoverageHistogram::setExactDepths(depthT exactDepths) {
+	_exactDepths = max(exactDepths, kMinExactDepths);
+	if(_exactDepths > kMaxExactDepths) _exactDepths = kMaxExactDepths;
+	_firstLogBin = logBinOf(_exactDepths + 1);
+	_bins.clear();
+	_positions = 0;
+	_depthSum = 0;
+}
+
+void CoverageHistogram::allocate() {
+	// up to the log bin of the deepest depthT
+	_bins.assign(_exactDepths + 1 + logBinOf(~static_cast<depthT>(0)) - _firstLogBin + 1, 0);
+}
+
+uint64_t CoverageHistogram::binLabel(size_t bin) const {
+	if(bin <= _exactDepths) return bin;
+
+	unsigned int logBin = bin - _exactDepths - 1 + _firstLogBin;
+	uint64_t lowest = static_cast<uint64_t>(8 + logBin % 8) << (logBin / 8 - 3);
+
+	// the first log bin starts past the cap
+	return max(lowest, static_cast<uint64_t>(_exactDepths) + 1);
+}
+
+void CoverageHistogram::addSpan(const depthT * depths, size_t length) {
+	if(length == 0) return;
+	if(_bins.empty()) allocate();
+
+	for(size_t i=0; i<length; ) {
+		depthT depth = depths[i];
+		size_t run = 1;
+		while(i + run < length && depths[i + run] == depth) run++;
+
+		_bins[binOf(depth)] += run;
+		_depthSum += static_cast<uint64_t>(depth) * run;
+		i += run;
+	}
+	_positions += length;
+}
+
+void CoverageHistogram::merge(const CoverageHistogram& other) {
+	if(other._positions == 0) return;
+	if(_bins.empty()) allocate();
+
+	if(other._exactDepths == _exactDepths) {
+		for(size_t i=0; i<_bins.size(); i++) _bins[i] += other._bins[i];
+	}
+	else {
+		// rebin by the lowest depth of the other's bins
+		for(size_t i=0; i<other._bins.size(); i++) {
+			if(other._bins[i] > 0) _bins[binOf(other.binLabel(i))] += other._bins[i];
+		}
+	}
+
+	_positions += other._positions;
+	_depthSum += other._depthSum;
+}
+
+size_t CoverageHistogram::memoryUsage() const {
+	return _bins.capacity() * sizeof(uint64_t);
+}
+
+json_t * CoverageHistogram::toJson(unsigned int binWidth) const {
+	json_t * j_hist = json_object();
+	if(binWidth < 1) binWidth = 1;
+
+	// bins are in the order of their labels, so equal labels are neighbours
+	uint64_t label = 0;
+	uint64_t count = 0;
+	for(size_t i=0; i<_bins.size(); i++) {
+		if(_bins[i] == 0) continue;
+
+		uint64_t binLowest = binLabel(i);
+		if(i <= _exactDepths) binLowest = binLowest / binWidth * binWidth;
+
+		if(count > 0 && binLowest != label) {
+			stringstream labelSS; labelSS << label;
+			json_object_set_new(j_hist, labelSS.str().c_str(), json_real(count / static_cast<double>(_positions)));
+			count = 0;
+		}
+		label = binLowest;
+		count += _bins[i];
+	}
+
+	if(count > 0) {
+		stringstream labelSS; labelSS << label;
+		json_object_set_new(j_hist, labelSS.str().c_str(), json_real(count / static_cast<double>(_positions)));
+	}
+
+	return j_hist;
+}
+
+json_t * CoverageHistogram::saveState() const {
+	json_t * j_state = json_object();
+	json_object_set_new(j_state, "depth_sum", json_integer(_depthSum));
+
+	json_t * j_bins = json_object();
+	for(size_t i=0; i<_bins.size(); i++) {
+		if(_bins[i] == 0) continue;
+		stringstream labelSS; labelSS << binLabel(i);
+		json_object_set_new(j_bins, labelSS.str().c_str(), json_integer(_bins[i]));
+	}
+	json_object_set_new(j_state, "bins", j_bins);
+	return j_state;
+}
+
+void CoverageHistogram::loadState(const json_t * stateObj) {
+	setExactDepths(_exactDepths);
+
+	const json_t * j_bins = json_object_get(stateObj, "bins");
+	if(json_is_object(j_bins)) {
+		const char * key;
+		json_t * value;
+		json_object_foreach(const_cast<json_t *>(j_bins), key, value) {
+			depthT depth = 0;
+			stringstream labelSS(key); labelSS >> depth;
+			add(depth, json_integer_value(value));
+		}
+	}
+
+	// the log bins do not tell the exact depths
+	_depthSum = json_integer_value(json_object_get(stateObj, "depth_sum"));
+}
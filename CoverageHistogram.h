@@ -0,0 +1,100 @@
+#ifndef COVERAGEHISTOGRAM_H
+#define COVERAGEHISTOGRAM_H
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+namespace BamstatsAlive {
+
+	/**
+	 * A histogram of per-base depths
+	 *
+	 * Depths up to a cap are counted exactly in a dense array, so that a
+	 * position costs a single indexed increment however deep the data.
+	 * Deeper positions, as in amplicon or ultra-deep sequencing, fall into
+	 * logarithmic bins, eight per doubling of the depth, each labelled by
+	 * the lowest depth it holds. Counts are 64 bits wide, and the sum of
+	 * the depths is kept exactly, so the mean depth does not suffer from
+	 * the log bins.
+	 */
+	class CoverageHistogram {
+		public:
+			typedef unsigned int depthT;
+
+			static const depthT kDefaultExactDepths = 1000;
+			/** The most depths counted exactly, as every histogram holds a counter for each */
+			static const depthT kMaxExactDepths = 1 << 20;
+
+		private:
+			depthT _exactDepths;
+			// the log bin the first depth past the cap falls into
+			unsigned int _firstLogBin;
+			// the exact depths, then the log bins; allocated on first use
+			std::vector<uint64_t> _bins;
+			uint64_t _positions;
+			uint64_t _depthSum;
+
+			static inline unsigned int logBinOf(depthT depth) {
+				unsigned int msb = 31 - __builtin_clz(depth);
+				return msb * 8 + ((depth >> (msb - 3)) & 7);
+			}
+
+			inline size_t binOf(depthT depth) const {
+				return depth <= _exactDepths ? depth : _exactDepths + 1 + logBinOf(depth) - _firstLogBin;
+			}
+
+			/** The lowest depth of a bin */
+			uint64_t binLabel(size_t bin) const;
+
+			void allocate();
+
+		public:
+			/**
+			 * @param exactDepths The depths counted exactly, at least 8 and
+			 *        at most kMaxExactDepths
+			 */
+			CoverageHistogram(depthT exactDepths = kDefaultExactDepths);
+
+			/**
+			 * Change the cap, dropping everything counted so far
+			 */
+			void setExactDepths(depthT exactDepths);
+
+			inline void add(depthT depth, uint64_t count = 1) {
+				if(_bins.empty()) allocate();
+				_bins[binOf(depth)] += count;
+				_positions += count;
+				_depthSum += static_cast<uint64_t>(depth) * count;
+			}
+
+			/**
+			 * Add the depths of consecutive positions, runs of the same
+			 * depth taking a single increment
+			 */
+			void addSpan(const depthT * depths, size_t length);
+
+			void merge(const CoverageHistogram& other);
+
+			inline uint64_t positions() const { return _positions; }
+			inline double meanDepth() const { return _positions > 0 ? _depthSum / static_cast<double>(_positions) : 0; }
+
+			/**
+			 * The memory held by the bins, in bytes
+			 */
+			size_t memoryUsage() const;
+
+			/**
+			 * @param binWidth Width of the bins the exact depths are reported in
+			 * @return A new json object of the fraction of the positions at
+			 *         each depth, keyed by the lowest depth of the bin
+			 */
+			json_t * toJson(unsigned int binWidth = 1) const;
+
+			json_t * saveState() const;
+			void loadState(const json_t * stateObj);
+	};
+}
+
+#endif
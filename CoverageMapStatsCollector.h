@@ -5,30 +5,40 @@
 
 #include "AbstractStatCollector.h"
 #include "GenomicRegionStore.h"
+#include "CoverageBufferPool.h"
+#include "CoverageHistogram.h"
 
 namespace BamstatsAlive {
 
 	class CoverageMapStatsCollector : public AbstractStatCollector {
-		public:
-			using coverageHistT = std::map<size_t, unsigned int>;
-
 		protected:
+			virtual const char * collectorName() const { return "coverage_map"; }
 			virtual void processAlignmentImpl(const BamTools::BamAlignment& al, const BamTools::RefVector& refVector);
 			virtual void appendJsonImpl(json_t * jsonRootObj);
+			virtual void mergeImpl(const AbstractStatCollector& other);
+			virtual void saveStateImpl(json_t * stateObj);
+			virtual void loadStateImpl(const json_t * stateObj);
 
 		private:	
 			const GenomicRegionStore::GenomicRegionT *_currentRegion;
-			unsigned int * _regionalCoverageMap;
-			const coverageHistT& _existingCoverageHist;
-			coverageHistT _coverageHist;
+			CoverageBufferPool& _bufferPool;
+			CoverageBufferPool::valueT * _regionalCoverageMap;
+			CoverageHistogram& _coverageHist;
 			size_t _coveredLength;
+			size_t _touchedLength;
 
 		public:
-			CoverageMapStatsCollector(const GenomicRegionStore::GenomicRegionT * currentRegion, const coverageHistT& existingHistogram);
+			/**
+			 * @param currentRegion The region whose per-base coverage is tracked
+			 * @param bufferPool The pool from which the coverage array is borrowed
+			 * @param histogram The histogram finalized positions are merged into, in place
+			 */
+			CoverageMapStatsCollector(
+					const GenomicRegionStore::GenomicRegionT * currentRegion,
+					CoverageBufferPool& bufferPool,
+					CoverageHistogram& histogram);
 
 			virtual ~CoverageMapStatsCollector();
-
-			coverageHistT getEffectiveHistogram(unsigned int& totalPos); 
 	};
 }
 
@@ -0,0 +1,386 @@
+#include "CoverageTrackStatsCollector.h"
+#include "PerfCounters.h"
+
+using namespace BamstatsAlive;
+using namespace std;
+
+typedef TargetCoverageStatsCollector::TargetT TargetT;
+typedef TargetCoverageStatsCollector::TargetVec TargetVec;
+
+// references missing from the input (-1) sort after all the others
+static inline uint32_t refOrder(int32_t refID) { return static_cast<uint32_t>(refID); }
+
+// whether the target ends before the position
+static inline bool isBefore(const TargetT& target, int32_t refID, int32_t pos) {
+	return refOrder(target.refID) < refOrder(refID) || (target.refID == refID && target.endPos < pos);
+}
+
+CoverageTrackStatsCollector::CoverageTrackStatsCollector(const GenomicRegionStore& regionStore, int32_t binSize) :
+	AbstractStatCollector(),
+	_regionStore(regionStore),
+	_openRefID(-1),
+	_firstLevel(0),
+	_keepReported(false),
+	_targets(NULL),
+	_currentTarget(0),
+	_lastTarget(0),
+	_sweepRefID(-1),
+	_sweepPos(0),
+	_depth(0)
+{
+	GenomicRegionStore::GenomicRegionRange regions = regionStore.regions();
+	for(size_t i=0; i<regions.size(); i++) {
+		if(regions[i].chromIndex >= _chromNames.size()) _chromNames.resize(regions[i].chromIndex + 1, "");
+		_chromNames[regions[i].chromIndex] = regions[i].chrom();
+	}
+
+	for(size_t l=0; l<kZoomLevels; l++) {
+		_binSizes[l] = l == 0 ? max(binSize, 1) : _binSizes[l - 1] * kZoomFactor;
+		_emitted[l] = 0;
+		_openBins[l].positions = 0;
+	}
+}
+
+void CoverageTrackStatsCollector::beginTargets(const TargetVec& targets, size_t firstTarget, size_t lastTarget) {
+	endTargets();
+
+	_targets = &targets;
+	_currentTarget = firstTarget;
+	_lastTarget = lastTarget;
+	resetSweep(-1);
+}
+
+void CoverageTrackStatsCollector::endTargets() {
+	if(_targets == NULL) return;
+
+	for(; _currentTarget < _lastTarget; _currentTarget++)
+		finishPositions((*_targets)[_currentTarget], (*_targets)[_currentTarget].endPos);
+
+	for(size_t l=0; l<kZoomLevels; l++)
+		if(_openBins[l].positions > 0) closeBin(l);
+
+	_depthChanges.clear();
+	_targets = NULL;
+}
+
+void CoverageTrackStatsCollector::resetSweep(int32_t refID) {
+	_depthChanges.clear();
+	_depth = 0;
+	_sweepRefID = refID;
+	_sweepPos = 0;
+}
+
+void CoverageTrackStatsCollector::advance(int32_t refID, int32_t pos) {
+	const TargetVec& targets = *_targets;
+
+	// a sorted input has no more reads before the position
+	while(_currentTarget < _lastTarget) {
+		const TargetT& target = targets[_currentTarget];
+
+		if(isBefore(target, refID, pos)) {
+			finishPositions(target, target.endPos);
+			_currentTarget++;
+			continue;
+		}
+
+		if(target.refID == refID && target.startPos < pos) finishPositions(target, pos - 1);
+		break;
+	}
+
+	if(refID != _sweepRefID) resetSweep(refID);
+	closePassedBins(refID, pos);
+}
+
+void CoverageTrackStatsCollector::finishPositions(const TargetT& target, int32_t endPos) {
+	BSA_PERF_SCOPE(PerfCounters::kStageCoverage);
+
+	if(target.refID != _sweepRefID) resetSweep(target.refID);
+
+	if(target.refID != _openRefID) {
+		for(size_t l=0; l<kZoomLevels; l++)
+			if(_openBins[l].positions > 0) closeBin(l);
+		_openRefID = target.refID;
+	}
+
+	uint32_t chromIndex = _regionStore.regions()[target.firstRegion].chromIndex;
+	int32_t binSize = _binSizes[0];
+
+	// depth is constant between two changes, so positions go run by run
+	int32_t pos = max(_sweepPos, target.startPos);
+	while(pos <= endPos) {
+		while(!_depthChanges.empty() && _depthChanges.begin()->first <= pos) {
+			_depth += _depthChanges.begin()->second;
+			_depthChanges.erase(_depthChanges.begin());
+		}
+
+		int32_t runEnd = endPos;
+		if(!_depthChanges.empty() && _depthChanges.begin()->first <= endPos) runEnd = _depthChanges.begin()->first - 1;
+
+		uint32_t depth = max<int64_t>(_depth, 0);
+		for(int32_t from = pos; from <= runEnd; ) {
+			int32_t binStart = from - from % binSize;
+			int32_t to = min(runEnd, binStart + binSize - 1);
+			uint32_t positions = to - from + 1;
+
+			addToBin(0, chromIndex, binStart, positions, static_cast<uint64_t>(positions) * depth, depth, depth);
+			from = to + 1;
+		}
+
+		pos = runEnd + 1;
+	}
+
+	_sweepPos = max(_sweepPos, endPos + 1);
+}
+
+void CoverageTrackStatsCollector::addToBin(size_t level, uint32_t chromIndex, int32_t startPos, uint32_t positions, uint64_t depthSum, uint32_t minDepth, uint32_t maxDepth) {
+	TrackBinT& bin = _openBins[level];
+
+	if(bin.positions > 0 && (bin.chromIndex != chromIndex || bin.startPos != startPos)) closeBin(level);
+
+	if(bin.positions == 0) {
+		bin.chromIndex = chromIndex;
+		bin.startPos = startPos;
+		bin.depthSum = 0;
+		bin.minDepth = minDepth;
+		bin.maxDepth = maxDepth;
+	}
+	else {
+		bin.minDepth = min(bin.minDepth, minDepth);
+		bin.maxDepth = max(bin.maxDepth, maxDepth);
+	}
+
+	bin.positions += positions;
+	bin.depthSum += depthSum;
+}
+
+void CoverageTrackStatsCollector::closeBin(size_t level) {
+	TrackBinT bin = _openBins[level];
+	_openBins[level].positions = 0;
+	if(level >= _firstLevel) _bins[level].push_back(bin);
+
+	// the bins of a level make up those of the next
+	if(level + 1 < kZoomLevels) {
+		int32_t binSize = _binSizes[level + 1];
+		addToBin(level + 1, bin.chromIndex, bin.startPos - bin.startPos % binSize, bin.positions, bin.depthSum, bin.minDepth, bin.maxDepth);
+	}
+}
+
+void CoverageTrackStatsCollector::closePassedBins(int32_t refID, int32_t pos) {
+	// finer levels first, as closing a bin adds to the level above
+	for(size_t l=0; l<kZoomLevels; l++) {
+		const TrackBinT& bin = _openBins[l];
+		if(bin.positions > 0 && (refID != _openRefID || bin.startPos + _binSizes[l] <= pos)) closeBin(l);
+	}
+}
+
+void CoverageTrackStatsCollector::coalesceBins(size_t level) {
+	TrackBinVec& bins = _bins[level];
+
+	stable_sort(bins.begin(), bins.end(), [](const TrackBinT& a, const TrackBinT& b) {
+		if(a.chromIndex != b.chromIndex) return a.chromIndex < b.chromIndex;
+		return a.startPos < b.startPos;
+	});
+
+	// a bin spanning targets swept separately is finished more than once
+	size_t kept = 0;
+	for(size_t i=0; i<bins.size(); i++) {
+		if(kept > 0 && bins[kept - 1].chromIndex == bins[i].chromIndex && bins[kept - 1].startPos == bins[i].startPos) {
+			TrackBinT& bin = bins[kept - 1];
+			bin.positions += bins[i].positions;
+			bin.depthSum += bins[i].depthSum;
+			bin.minDepth = min(bin.minDepth, bins[i].minDepth);
+			bin.maxDepth = max(bin.maxDepth, bins[i].maxDepth);
+		}
+		else bins[kept++] = bins[i];
+	}
+	bins.resize(kept);
+}
+
+void CoverageTrackStatsCollector::processAlignmentImpl(const BamTools::BamAlignment& al, const BamTools::RefVector& refVector) {
+	if(_targets == NULL || !al.IsMapped() || al.RefID < 0) return;
+
+	advance(al.RefID, al.Position);
+
+	int32_t pos = al.Position;
+	for(auto op = al.CigarData.begin(); op != al.CigarData.end(); op++) {
+		switch(op->Type) {
+			case 'M': case '=': case 'X': {
+				// finished positions stay as they are, should the input not be sorted
+				int32_t from = max(pos, _sweepPos);
+				int32_t to = pos + static_cast<int32_t>(op->Length) - 1;
+
+				if(from <= to && TargetCoverageStatsCollector::locateTarget(*_targets, al.RefID, from, to) != TargetCoverageStatsCollector::kNoTarget) {
+					_depthChanges[from]++;
+					_depthChanges[to + 1]--;
+				}
+				pos += op->Length;
+				break;
+			}
+			case 'D': case 'N':
+				pos += op->Length;
+				break;
+		}
+	}
+}
+
+void CoverageTrackStatsCollector::appendJsonImpl(json_t * jsonRootObj) {
+	json_t * j_tracks = json_array();
+
+	// one track per zoom level and chromosome among the bins finished since the last frame
+	for(size_t l=0; l<kZoomLevels; l++) {
+		const TrackBinVec& bins = _bins[l];
+		json_t * j_start = NULL, * j_mean = NULL, * j_min = NULL, * j_max = NULL;
+
+		for(size_t i=_emitted[l]; i<bins.size(); i++) {
+			const TrackBinT& bin = bins[i];
+
+			if(j_start == NULL || bin.chromIndex != bins[i - 1].chromIndex) {
+				json_t * j_track = json_object();
+				json_object_set_new(j_track, "chr", json_string(_chromNames[bin.chromIndex]));
+				json_object_set_new(j_track, "bin_size", json_integer(_binSizes[l]));
+				json_object_set_new(j_track, "start", j_start = json_array());
+				json_object_set_new(j_track, "mean", j_mean = json_array());
+				json_object_set_new(j_track, "min", j_min = json_array());
+				json_object_set_new(j_track, "max", j_max = json_array());
+				json_array_append_new(j_tracks, j_track);
+			}
+
+			json_array_append_new(j_start, json_integer(bin.startPos));
+			json_array_append_new(j_mean, json_real(bin.depthSum / static_cast<double>(bin.positions)));
+			json_array_append_new(j_min, json_integer(bin.minDepth));
+			json_array_append_new(j_max, json_integer(bin.maxDepth));
+		}
+
+		_emitted[l] = bins.size();
+	}
+
+	json_object_set_new(jsonRootObj, "coverage_track", j_tracks);
+}
+
+void CoverageTrackStatsCollector::mergeImpl(const AbstractStatCollector& other) {
+	const CoverageTrackStatsCollector& otherTrack = dynamic_cast<const CoverageTrackStatsCollector&>(other);
+
+	// collectors are merged once their sweeps are over, and the merged
+	// tracks are reported as a whole
+	for(; _firstLevel < otherTrack._firstLevel; _firstLevel++) TrackBinVec().swap(_bins[_firstLevel]);
+
+	for(size_t l=_firstLevel; l<kZoomLevels; l++) {
+		_bins[l].insert(_bins[l].end(), otherTrack._bins[l].begin(), otherTrack._bins[l].end());
+		coalesceBins(l);
+		_emitted[l] = 0;
+	}
+}
+
+size_t CoverageTrackStatsCollector::memoryUsageImpl() const {
+	size_t bytes = vectorMemoryUsage(_chromNames) + mapMemoryUsage(_depthChanges);
+	for(size_t l=0; l<kZoomLevels; l++) bytes += vectorMemoryUsage(_bins[l]);
+	return bytes;
+}
+
+bool CoverageTrackStatsCollector::shedMemoryImpl() {
+	// bins already reported are only kept for merging and the sidecar, so
+	// they go first unless the collector is merged afterwards
+	bool shed = false;
+	for(size_t l=_firstLevel; l<kZoomLevels && !_keepReported; l++) {
+		if(_emitted[l] == 0) continue;
+		TrackBinVec(_bins[l].begin() + _emitted[l], _bins[l].end()).swap(_bins[l]);
+		_emitted[l] = 0;
+		shed = true;
+	}
+	if(shed) {
+		LOGS<<"Dropping the coverage track bins already reported"<<std::endl;
+		return true;
+	}
+
+	// then keep the coarser zoom levels only
+	if(_firstLevel + 1 < kZoomLevels) {
+		LOGS<<"Dropping the coverage track bins of "<<_binSizes[_firstLevel]<<" bases"<<std::endl;
+		TrackBinVec().swap(_bins[_firstLevel]);
+		_firstLevel++;
+		return true;
+	}
+
+	return false;
+}
+
+void CoverageTrackStatsCollector::saveStateImpl(json_t * stateObj) {
+	auto binToJson = [](const TrackBinT& bin) {
+		json_t * j_bin = json_array();
+		json_array_append_new(j_bin, json_integer(bin.chromIndex));
+		json_array_append_new(j_bin, json_integer(bin.startPos));
+		json_array_append_new(j_bin, json_integer(bin.depthSum));
+		json_array_append_new(j_bin, json_integer(bin.positions));
+		json_array_append_new(j_bin, json_integer(bin.minDepth));
+		json_array_append_new(j_bin, json_integer(bin.maxDepth));
+		return j_bin;
+	};
+
+	json_t * j_levels = json_array();
+	json_t * j_open = json_array();
+	for(size_t l=0; l<kZoomLevels; l++) {
+		json_t * j_bins = json_array();
+		for(auto it = _bins[l].begin(); it != _bins[l].end(); it++) json_array_append_new(j_bins, binToJson(*it));
+		json_array_append_new(j_levels, j_bins);
+		json_array_append_new(j_open, binToJson(_openBins[l]));
+	}
+	json_object_set_new(stateObj, "bins", j_levels);
+	json_object_set_new(stateObj, "open_bins", j_open);
+	json_object_set_new(stateObj, "open_ref", json_integer(_openRefID));
+	json_object_set_new(stateObj, "first_level", json_integer(_firstLevel));
+
+	json_object_set_new(stateObj, "current_target", json_integer(_currentTarget));
+	json_object_set_new(stateObj, "sweep_ref", json_integer(_sweepRefID));
+	json_object_set_new(stateObj, "sweep_pos", json_integer(_sweepPos));
+	json_object_set_new(stateObj, "depth", json_integer(_depth));
+
+	json_t * j_changes = json_array();
+	for(auto it = _depthChanges.begin(); it != _depthChanges.end(); it++) {
+		json_array_append_new(j_changes, json_integer(it->first));
+		json_array_append_new(j_changes, json_integer(it->second));
+	}
+	json_object_set_new(stateObj, "depth_changes", j_changes);
+}
+
+void CoverageTrackStatsCollector::loadStateImpl(const json_t * stateObj) {
+	auto binFromJson = [](const json_t * j_bin) {
+		TrackBinT bin;
+		bin.chromIndex = json_integer_value(json_array_get(j_bin, 0));
+		bin.startPos = json_integer_value(json_array_get(j_bin, 1));
+		bin.depthSum = json_integer_value(json_array_get(j_bin, 2));
+		bin.positions = json_integer_value(json_array_get(j_bin, 3));
+		bin.minDepth = json_integer_value(json_array_get(j_bin, 4));
+		bin.maxDepth = json_integer_value(json_array_get(j_bin, 5));
+		return bin;
+	};
+
+	const json_t * j_levels = json_object_get(stateObj, "bins");
+	const json_t * j_open = json_object_get(stateObj, "open_bins");
+	for(size_t l=0; l<kZoomLevels; l++) {
+		const json_t * j_bins = json_array_get(j_levels, l);
+
+		_bins[l].clear();
+		for(size_t i=0; i<json_array_size(j_bins); i++) {
+			TrackBinT bin = binFromJson(json_array_get(j_bins, i));
+			// bins outside of the region store's chromosomes would not be nameable
+			if(bin.chromIndex < _chromNames.size() && bin.positions > 0) _bins[l].push_back(bin);
+		}
+		_emitted[l] = 0;
+
+		_openBins[l] = binFromJson(json_array_get(j_open, l));
+		if(_openBins[l].chromIndex >= _chromNames.size()) _openBins[l].positions = 0;
+	}
+	_openRefID = json_integer_value(json_object_get(stateObj, "open_ref"));
+	_firstLevel = min<size_t>(json_integer_value(json_object_get(stateObj, "first_level")), kZoomLevels - 1);
+	for(size_t l=0; l<_firstLevel; l++) _bins[l].clear();
+
+	// the targets themselves come from beginTargets(), the state only says how far the sweep went
+	_currentTarget = json_integer_value(json_object_get(stateObj, "current_target"));
+	_sweepRefID = json_integer_value(json_object_get(stateObj, "sweep_ref"));
+	_sweepPos = json_integer_value(json_object_get(stateObj, "sweep_pos"));
+	_depth = json_integer_value(json_object_get(stateObj, "depth"));
+
+	const json_t * j_changes = json_object_get(stateObj, "depth_changes");
+	_depthChanges.clear();
+	for(size_t i=0; i+1<json_array_size(j_changes); i+=2)
+		_depthChanges[json_integer_value(json_array_get(j_changes, i))] = json_integer_value(json_array_get(j_changes, i + 1));
+}
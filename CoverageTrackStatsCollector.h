@@ -0,0 +1,125 @@
+#ifndef COVERAGETRACKSTATSCOLLECTOR_H
+#define COVERAGETRACKSTATSCOLLECTOR_H
+
+#pragma once
+
+#include "AbstractStatCollector.h"
+#include "GenomicRegionStore.h"
+#include "TargetCoverageStatsCollector.h"
+
+namespace BamstatsAlive {
+
+	/**
+	 * Binned coverage tracks over a region set, for drawing coverage plots
+	 *
+	 * Positions of the regions are summarized into bins aligned to multiples
+	 * of the bin size, each holding the mean, min and max depth of its
+	 * positions inside the regions. Every zoom level has bins kZoomFactor
+	 * times as large as the level below, like the zoom levels of a bigWig.
+	 *
+	 * The regions are swept in the order of a coordinate sorted input like
+	 * TargetCoverageStatsCollector does, but depth is kept as the changes
+	 * the reads' cigars make to it, so a bin is finished as soon as the
+	 * reads pass its end rather than at the end of its region. Each frame
+	 * carries the bins finished since the previous frame.
+	 *
+	 * The bins kept grow with the span swept. Under a memory limit, the
+	 * bins already reported are dropped first, unless the collector is
+	 * merged afterwards, then the finest zoom levels down to the coarsest.
+	 */
+	class CoverageTrackStatsCollector : public AbstractStatCollector {
+		public:
+			static const unsigned int kZoomLevels = 4;
+			static const unsigned int kZoomFactor = 4;
+
+		protected:
+			virtual const char * collectorName() const { return "coverage_track"; }
+			virtual void processAlignmentImpl(const BamTools::BamAlignment& al, const BamTools::RefVector& refVector);
+			virtual void appendJsonImpl(json_t * jsonRootObj);
+			virtual void mergeImpl(const AbstractStatCollector& other);
+			virtual void saveStateImpl(json_t * stateObj);
+			virtual void loadStateImpl(const json_t * stateObj);
+			virtual size_t memoryUsageImpl() const;
+			virtual bool shedMemoryImpl();
+
+		private:
+			typedef struct _trackBinT {
+				uint32_t chromIndex;
+				int32_t startPos;
+				uint64_t depthSum;
+				/** Positions of the bin inside of the regions, 0 for no bin */
+				uint32_t positions;
+				uint32_t minDepth;
+				uint32_t maxDepth;
+			} TrackBinT;
+
+			typedef std::vector<TrackBinT> TrackBinVec;
+
+			const GenomicRegionStore& _regionStore;
+			std::vector<const char *> _chromNames;
+			int32_t _binSizes[kZoomLevels];
+
+			// finished bins of every level, those from _emitted on not reported yet
+			TrackBinVec _bins[kZoomLevels];
+			size_t _emitted[kZoomLevels];
+			TrackBinT _openBins[kZoomLevels];
+			int32_t _openRefID;
+			// levels below are still summed up, but their bins not kept, to save memory
+			size_t _firstLevel;
+			// the reported bins are needed by a merge
+			bool _keepReported;
+
+			// the range of targets being swept, positions before _sweepPos are finished
+			const TargetCoverageStatsCollector::TargetVec * _targets;
+			size_t _currentTarget;
+			size_t _lastTarget;
+			int32_t _sweepRefID;
+			int32_t _sweepPos;
+			int64_t _depth;
+			std::map<int32_t, int32_t> _depthChanges;
+
+			void advance(int32_t refID, int32_t pos);
+			void finishPositions(const TargetCoverageStatsCollector::TargetT& target, int32_t endPos);
+			void resetSweep(int32_t refID);
+
+			void addToBin(size_t level, uint32_t chromIndex, int32_t startPos, uint32_t positions, uint64_t depthSum, uint32_t minDepth, uint32_t maxDepth);
+			void closeBin(size_t level);
+			void closePassedBins(int32_t refID, int32_t pos);
+
+			/** Sort the bins of a level, and combine those of the same position */
+			void coalesceBins(size_t level);
+
+		public:
+			/**
+			 * @param regionStore The regions tracks are made for
+			 * @param binSize The bin size of the finest zoom level
+			 */
+			CoverageTrackStatsCollector(const GenomicRegionStore& regionStore, int32_t binSize);
+
+			/**
+			 * Start sweeping a range of targets
+			 *
+			 * The alignments processed afterwards have to come in coordinate
+			 * order; coverage outside of the range is ignored.
+			 *
+			 * @param targets The targets as created by TargetCoverageStatsCollector::mergeRegions(),
+			 *        which have to outlive the sweep
+			 * @param firstTarget The first target of the range
+			 * @param lastTarget One past the last target of the range
+			 */
+			void beginTargets(const TargetCoverageStatsCollector::TargetVec& targets, size_t firstTarget, size_t lastTarget);
+
+			/**
+			 * Finish every bin of the range, including those no read reached
+			 */
+			void endTargets();
+
+			/**
+			 * Keep the bins already reported when shedding memory, for a
+			 * collector merged into another afterwards
+			 */
+			inline void setKeepReported(bool keepReported) { _keepReported = keepReported; }
+	};
+}
+
+#endif
@@ -0,0 +1,177 @@
+#include "DuplicationStatsCollector.h"
+
+#include <cmath>
+
+using namespace BamstatsAlive;
+using namespace std;
+
+static const uint32_t kFlagSupplementary = 0x800;
+
+// the finalizer of splitmix64, spreads every input bit over the whole word
+static inline uint64_t mix64(uint64_t x) {
+	x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27; x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return x;
+}
+
+static inline uint64_t pack(int32_t refID, int32_t pos, bool reverse) {
+	return (static_cast<uint64_t>(static_cast<uint32_t>(refID)) << 33)
+		| (static_cast<uint64_t>(static_cast<uint32_t>(pos)) << 1)
+		| (reverse ? 1 : 0);
+}
+
+/**
+ * The reference position sequencing started from, including clipped bases
+ */
+static int32_t unclippedFivePrime(const BamTools::BamAlignment& al) {
+	const std::vector<BamTools::CigarOp>& cigar = al.CigarData;
+
+	if(!al.IsReverseStrand()) {
+		int32_t pos = al.Position;
+		for(auto op = cigar.begin(); op != cigar.end() && (op->Type == 'S' || op->Type == 'H'); op++) pos -= op->Length;
+		return pos;
+	}
+
+	int32_t pos = al.Position - 1;
+	for(auto op = cigar.begin(); op != cigar.end(); op++) {
+		switch(op->Type) {
+			case 'M': case '=': case 'X': case 'D': case 'N':
+				pos += op->Length;
+				break;
+		}
+	}
+	for(auto op = cigar.rbegin(); op != cigar.rend() && (op->Type == 'S' || op->Type == 'H'); op++) pos += op->Length;
+	return pos;
+}
+
+DuplicationStatsCollector::DuplicationStatsCollector() :
+	AbstractStatCollector(),
+	_registers(kRegisterCount, 0),
+	_fragments(0),
+	_rankCounts(65, 0)
+{
+	_rankCounts[0] = kRegisterCount;
+}
+
+void DuplicationStatsCollector::processAlignmentImpl(const BamTools::BamAlignment& al, const BamTools::RefVector& refVector) {
+	if(!al.IsMapped() || !al.IsPrimaryAlignment() || (al.AlignmentFlag & kFlagSupplementary)) return;
+
+	uint64_t hash = mix64(pack(al.RefID, unclippedFivePrime(al), al.IsReverseStrand()));
+
+	if(al.IsPaired() && al.IsMateMapped()) {
+		// one fingerprint per pair
+		if(!al.IsFirstMate()) return;
+		hash = mix64(hash ^ pack(al.MateRefID, al.MatePosition, al.IsMateReverseStrand()));
+	}
+
+	_fragments++;
+	addFingerprint(hash);
+}
+
+void DuplicationStatsCollector::addFingerprint(uint64_t hash) {
+	// the leading bits pick a register, which keeps the longest run of
+	// leading zeros seen in the remaining bits
+	size_t index = hash >> (64 - kPrecision);
+	uint64_t rest = (hash << kPrecision) | (1ULL << (kPrecision - 1));
+	uint8_t rank = __builtin_clzll(rest) + 1;
+
+	uint8_t& reg = _registers[index];
+	if(rank <= reg) return;
+
+	_rankCounts[reg]--;
+	_rankCounts[rank]++;
+	reg = rank;
+}
+
+void DuplicationStatsCollector::recomputeSums() {
+	_rankCounts.assign(_rankCounts.size(), 0);
+	for(size_t i=0; i<kRegisterCount; i++) _rankCounts[_registers[i]]++;
+}
+
+double DuplicationStatsCollector::distinctFragments() const {
+	const double m = kRegisterCount;
+	const double alpha = 0.7213 / (1 + 1.079 / m);
+
+	double inverseSum = 0;
+	for(size_t r=0; r<_rankCounts.size(); r++) inverseSum += ldexp(static_cast<double>(_rankCounts[r]), -static_cast<int>(r));
+
+	double estimate = alpha * m * m / inverseSum;
+
+	// linear counting is more accurate while many registers are unset
+	size_t zeroRegisters = _rankCounts[0];
+	if(estimate <= 2.5 * m && zeroRegisters > 0)
+		estimate = m * log(m / zeroRegisters);
+
+	return min(estimate, static_cast<double>(_fragments));
+}
+
+double DuplicationStatsCollector::estimateLibrarySize(double fragments, double distinct) {
+	if(distinct <= 0 || distinct >= fragments) return 0;
+
+	// unique fragments expected from sequencing n fragments of a library of x molecules
+	auto f = [fragments, distinct](double x) { return distinct / x - 1 + exp(-fragments / x); };
+
+	double low = 1.0, high = 100.0;
+	if(f(low * distinct) < 0) return 0;
+	while(f(high * distinct) > 0) high *= 10.0;
+
+	for(int i=0; i<40; i++) {
+		double mid = (low + high) / 2.0;
+		double v = f(mid * distinct);
+		if(v == 0) break;
+		else if(v > 0) low = mid;
+		else high = mid;
+	}
+
+	return distinct * (low + high) / 2.0;
+}
+
+void DuplicationStatsCollector::appendJsonImpl(json_t * jsonRootObj) {
+	double distinct = distinctFragments();
+	double librarySize = estimateLibrarySize(_fragments, distinct);
+
+	json_t * j_duplication = json_object();
+	json_object_set_new(j_duplication, "fragments", json_integer(_fragments));
+	json_object_set_new(j_duplication, "distinct_fragments", json_integer(llround(distinct)));
+	json_object_set_new(j_duplication, "duplicate_fraction", json_real(_fragments > 0 ? 1.0 - distinct / _fragments : 0));
+	json_object_set_new(j_duplication, "estimated_library_size", librarySize > 0 ? json_integer(llround(librarySize)) : json_null());
+	json_object_set_new(jsonRootObj, "duplication", j_duplication);
+}
+
+void DuplicationStatsCollector::mergeImpl(const AbstractStatCollector& other) {
+	const DuplicationStatsCollector& otherDuplication = dynamic_cast<const DuplicationStatsCollector&>(other);
+
+	// the union of two sketches keeps the larger register
+	for(size_t i=0; i<kRegisterCount; i++)
+		_registers[i] = max(_registers[i], otherDuplication._registers[i]);
+	_fragments += otherDuplication._fragments;
+
+	recomputeSums();
+}
+
+size_t DuplicationStatsCollector::memoryUsageImpl() const {
+	return vectorMemoryUsage(_registers) + vectorMemoryUsage(_rankCounts);
+}
+
+void DuplicationStatsCollector::saveStateImpl(json_t * stateObj) {
+	// registers stay below 64, one printable character each
+	std::string registers(kRegisterCount, '0');
+	for(size_t i=0; i<kRegisterCount; i++) registers[i] = '0' + _registers[i];
+
+	json_object_set_new(stateObj, "registers", json_string(registers.c_str()));
+	json_object_set_new(stateObj, "fragments", json_integer(_fragments));
+}
+
+void DuplicationStatsCollector::loadStateImpl(const json_t * stateObj) {
+	const char * registers = json_string_value(json_object_get(stateObj, "registers"));
+
+	for(size_t i=0; i<kRegisterCount; i++) {
+		bool valid = registers != NULL && registers[i] >= '0' && registers[i] <= '0' + 64;
+		_registers[i] = valid ? registers[i] - '0' : 0;
+		if(registers != NULL && registers[i] == '\0') registers = NULL;
+	}
+	_fragments = json_integer_value(json_object_get(stateObj, "fragments"));
+
+	recomputeSums();
+}
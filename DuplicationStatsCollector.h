@@ -0,0 +1,77 @@
+#ifndef DUPLICATIONSTATSCOLLECTOR_H
+#define DUPLICATIONSTATSCOLLECTOR_H
+
+#pragma once
+
+#include "AbstractStatCollector.h"
+
+#include <stdint.h>
+
+namespace BamstatsAlive {
+
+	/**
+	 * Estimates the duplicate rate and the library complexity without
+	 * relying on duplicate flags
+	 *
+	 * Every fragment is reduced to a fingerprint of its unclipped 5' end,
+	 * strand and, for pairs with both mates mapped, the position and strand
+	 * of the mate; a pair is fingerprinted through its first mate only.
+	 * Duplicates share fingerprints, so the number of distinct fingerprints
+	 * estimates the number of unique fragments. It is counted in a
+	 * HyperLogLog sketch of fixed size, about 0.4% relative error, which is
+	 * mergeable and needs the same memory for a thousand or billions of
+	 * reads.
+	 *
+	 * The library size follows from the Lander-Waterman equation, as in
+	 * Picard's EstimateLibraryComplexity.
+	 */
+	class DuplicationStatsCollector : public AbstractStatCollector {
+		public:
+			/** log2 of the number of sketch registers */
+			static const unsigned int kPrecision = 16;
+			static const size_t kRegisterCount = 1 << kPrecision;
+
+		protected:
+			virtual const char * collectorName() const { return "duplication"; }
+			virtual void processAlignmentImpl(const BamTools::BamAlignment& al, const BamTools::RefVector& refVector);
+			virtual void appendJsonImpl(json_t * jsonRootObj);
+			virtual void mergeImpl(const AbstractStatCollector& other);
+			virtual void saveStateImpl(json_t * stateObj);
+			virtual void loadStateImpl(const json_t * stateObj);
+			virtual size_t memoryUsageImpl() const;
+
+		private:
+			std::vector<uint8_t> _registers;
+			uint64_t _fragments;
+
+			// registers per value, kept up to date with the registers so
+			// estimates are summed over a few ranks in a fixed order, the
+			// same however the registers were filled or merged
+			std::vector<uint32_t> _rankCounts;
+
+			void addFingerprint(uint64_t hash);
+			void recomputeSums();
+
+		public:
+			DuplicationStatsCollector();
+
+			/**
+			 * The estimated number of distinct fragments seen
+			 */
+			double distinctFragments() const;
+
+			inline uint64_t fragments() const { return _fragments; }
+
+			/**
+			 * Solve the Lander-Waterman equation for the library size
+			 *
+			 * @param fragments Number of fragments sequenced
+			 * @param distinct Number of distinct fragments among them
+			 * @return The estimated number of molecules in the library, or 0
+			 *         if the fragments do not show any duplication
+			 */
+			static double estimateLibrarySize(double fragments, double distinct);
+	};
+}
+
+#endif
@@ -0,0 +1,52 @@
+#include "FdOutputStream.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <cerrno>
+
+using namespace BamstatsAlive;
+
+FdOutputStream::FdOutputBuffer::FdOutputBuffer(int fd) : _fd(fd) {
+	setp(_buffer, _buffer + sizeof(_buffer));
+}
+
+bool FdOutputStream::FdOutputBuffer::flushBuffer() {
+	const char * data = pbase();
+	size_t remaining = pptr() - pbase();
+
+	while(remaining > 0) {
+		ssize_t written = send(_fd, data, remaining, MSG_NOSIGNAL);
+		if(written < 0 && errno == ENOTSOCK) written = ::write(_fd, data, remaining);
+		if(written < 0 && errno == EINTR) continue;
+		if(written <= 0) return false;
+
+		data += written;
+		remaining -= written;
+	}
+
+	setp(_buffer, _buffer + sizeof(_buffer));
+	return true;
+}
+
+FdOutputStream::FdOutputBuffer::int_type FdOutputStream::FdOutputBuffer::overflow(int_type c) {
+	if(!flushBuffer()) return traits_type::eof();
+
+	if(!traits_type::eq_int_type(c, traits_type::eof())) {
+		*pptr() = traits_type::to_char_type(c);
+		pbump(1);
+	}
+
+	return traits_type::not_eof(c);
+}
+
+int FdOutputStream::FdOutputBuffer::sync() {
+	return flushBuffer() ? 0 : -1;
+}
+
+FdOutputStream::FdOutputStream(int fd) : std::ostream(NULL), _buffer(fd) {
+	rdbuf(&_buffer);
+}
+
+FdOutputStream::~FdOutputStream() {
+	flush();
+}
@@ -0,0 +1,41 @@
+#ifndef FDOUTPUTSTREAM_H
+#define FDOUTPUTSTREAM_H
+
+#pragma once
+
+#include <ostream>
+#include <streambuf>
+
+namespace BamstatsAlive {
+
+	/**
+	 * A buffered std::ostream writing to a file descriptor, such as a
+	 * connected socket. A failed write, e.g. because the peer went away,
+	 * puts the stream into the bad state instead of raising SIGPIPE.
+	 */
+	class FdOutputStream : public std::ostream {
+		private:
+			class FdOutputBuffer : public std::streambuf {
+				private:
+					int _fd;
+					char _buffer[64 * 1024];
+
+					bool flushBuffer();
+
+				protected:
+					virtual int_type overflow(int_type c);
+					virtual int sync();
+
+				public:
+					FdOutputBuffer(int fd);
+			};
+
+			FdOutputBuffer _buffer;
+
+		public:
+			FdOutputStream(int fd);
+			virtual ~FdOutputStream();
+	};
+}
+
+#endif
@@ -0,0 +1,83 @@
+#include "FrameWriter.h"
+#include "PerfCounters.h"
+
+#include <cstring>
+
+using namespace BamstatsAlive;
+
+FrameWriter::FrameWriter(std::ostream& out) : _out(out) {
+}
+
+size_t FrameWriter::writeJson(json_t * jsonRootObj, const char * terminator) {
+	char * dumped = json_dumps(jsonRootObj, JSON_COMPACT | JSON_ENSURE_ASCII | JSON_PRESERVE_ORDER);
+	size_t length = strlen(dumped) + strlen(terminator) + 1;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_out<<dumped<<terminator<<std::endl;
+	}
+
+	free(dumped);
+	return length;
+}
+
+bool FrameWriter::isGood() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _out.good();
+}
+
+void FrameWriter::writeFrame(AbstractStatCollector& rootStatCollector, const std::string& sampleId, json_t * perfObj, json_t * memoryObj) {
+	size_t bytesOut;
+
+	{
+		BSA_PERF_SCOPE(PerfCounters::kStageJsonEmit);
+
+		// Create the root object that contains everything
+		json_t * j_root = json_object();
+
+		if(!sampleId.empty())
+			json_object_set_new(j_root, "sample", json_string(sampleId.c_str()));
+
+		// Let the root object of the collector tree create Json
+		rootStatCollector.appendJson(j_root);
+
+		if(perfObj != NULL)
+			json_object_set_new(j_root, "perf", perfObj);
+
+		if(memoryObj != NULL)
+			json_object_set_new(j_root, "memory", memoryObj);
+
+		bytesOut = writeJson(j_root, ";");
+		json_decref(j_root);
+	}
+
+	if(PerfCounters::current() != NULL) PerfCounters::current()->addBytesOut(bytesOut);
+}
+
+void FrameWriter::writeObject(const char * key, json_t * obj, const std::string& sampleId) {
+	json_t * j_root = json_object();
+
+	if(!sampleId.empty())
+		json_object_set_new(j_root, "sample", json_string(sampleId.c_str()));
+
+	json_object_set_new(j_root, key, obj);
+
+	writeJson(j_root, ";");
+	json_decref(j_root);
+}
+
+void FrameWriter::writeError(const std::string& message, const std::string& sampleId) {
+	if(sampleId.empty()) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		_out<<"{\"status\":\"error\", \"message\":\""<<message<<"\"}"<<std::endl;
+		return;
+	}
+
+	json_t * j_root = json_object();
+	json_object_set_new(j_root, "status", json_string("error"));
+	json_object_set_new(j_root, "message", json_string(message.c_str()));
+	json_object_set_new(j_root, "sample", json_string(sampleId.c_str()));
+
+	writeJson(j_root, "");
+	json_decref(j_root);
+}
@@ -0,0 +1,64 @@
+#ifndef FRAMEWRITER_H
+#define FRAMEWRITER_H
+
+#pragma once
+
+#include "AbstractStatCollector.h"
+
+#include <mutex>
+
+namespace BamstatsAlive {
+
+	/**
+	 * Serializes statistics frames to an output stream
+	 *
+	 * A frame is the json dump of a collector tree followed by ';'. Frames
+	 * may be tagged with the sample they belong to, and writing is
+	 * serialized so that several jobs can share the same output.
+	 */
+	class FrameWriter {
+		private:
+			std::ostream& _out;
+			std::mutex _mutex;
+
+			size_t writeJson(json_t * jsonRootObj, const char * terminator);
+
+		public:
+			FrameWriter(std::ostream& out);
+
+			/**
+			 * Whether frames still reach their destination, e.g. the client
+			 * of a server connection has not gone away
+			 */
+			bool isGood();
+
+			/**
+			 * Write the statistics of a collector tree as one frame
+			 *
+			 * @param rootStatCollector The root of the collector tree
+			 * @param sampleId The sample tag of the frame, or empty for none
+			 * @param perfObj Self-profiling counters to include, the reference is stolen
+			 * @param memoryObj Memory usage to include, the reference is stolen
+			 */
+			void writeFrame(AbstractStatCollector& rootStatCollector, const std::string& sampleId = "", json_t * perfObj = NULL, json_t * memoryObj = NULL);
+
+			/**
+			 * Write a frame holding a single named object
+			 *
+			 * @param key The name of the object
+			 * @param obj The object to write, the reference is stolen
+			 * @param sampleId The sample tag of the frame, or empty for none
+			 */
+			void writeObject(const char * key, json_t * obj, const std::string& sampleId = "");
+
+			/**
+			 * Write an error status object
+			 *
+			 * @param message The error message
+			 * @param sampleId The sample the error belongs to, or empty for none
+			 */
+			void writeError(const std::string& message, const std::string& sampleId = "");
+	};
+}
+
+#endif
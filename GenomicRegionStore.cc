@@ -1,18 +1,48 @@
 #include "GenomicRegionStore.h"
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <cstdio>
+#include <fstream>
+
 using namespace BamstatsAlive;
 
-GenomicRegionStore::GenomicRegionStore(const std::string& regionJson) {
+const char GenomicRegionStore::kIndexMagic[8] = { 'B', 'S', 'A', 'R', 'I', 'D', 'X', '2' };
+
+// index files of any version start alike, and those of other versions are rejected
+static const size_t kIndexMagicPrefix = 7;
+
+namespace {
+	typedef struct _regionSpecT {
+		std::string chrom;
+		int32_t startPos;
+		int32_t endPos;
+		uint32_t inputIndex;
+
+		bool operator<(const struct _regionSpecT& other) const {
+			int c = strcmp(chrom.c_str(), other.chrom.c_str());
+			if(c != 0) return c < 0;
+			if(startPos != other.startPos) return startPos < other.startPos;
+			if(endPos != other.endPos) return endPos < other.endPos;
+			return inputIndex < other.inputIndex;
+		}
+	} RegionSpecT;
+
+	typedef std::vector<RegionSpecT> RegionSpecVec;
+}
+
+static void parseJson(const std::string& regionJson, RegionSpecVec& specs) {
 
 	json_t *root;
 	json_error_t error;
 
 	root = json_loads(regionJson.c_str(), 0, &error);
 
-	if(!root) throw new InvalidJsonStringException;
+	if(!root) throw new GenomicRegionStore::InvalidJsonStringException;
 	if(!json_is_array(root)) {
 		json_decref(root);
-		throw new JsonRootNotArrayException;
+		throw new GenomicRegionStore::JsonRootNotArrayException;
 	}
 
 	for(int i=0; i<json_array_size(root); i++) {
@@ -21,7 +51,7 @@ GenomicRegionStore::GenomicRegionStore(const std::string& regionJson) {
 		arrayItem = json_array_get(root, i);
 		if(!json_is_object(arrayItem)) {
 			json_decref(root);
-			throw new ArrayItemsNotObjectException;
+			throw new GenomicRegionStore::ArrayItemsNotObjectException;
 		}
 
 		jvChr = json_object_get(arrayItem, "chr");
@@ -30,32 +60,299 @@ GenomicRegionStore::GenomicRegionStore(const std::string& regionJson) {
 
 		if(!json_is_string(jvChr) || !json_is_integer(jvStartPos) || !json_is_integer(jvEndPos)) {
 			json_decref(root);
-			throw new UnexpectedFieldDataTypeException;
+			throw new GenomicRegionStore::UnexpectedFieldDataTypeException;
 		}
 
-		const char *chr = json_string_value(jvChr);
-		int32_t startPos = json_integer_value(jvStartPos);
-		int32_t endPos = json_integer_value(jvEndPos);
+		json_int_t startPos = json_integer_value(jvStartPos);
+		json_int_t endPos = json_integer_value(jvEndPos);
+		if(startPos < 0 || endPos < startPos || endPos > INT32_MAX) {
+			json_decref(root);
+			throw new GenomicRegionStore::InvalidRegionException;
+		}
 
-		struct _regionT newRegion(chr, startPos, endPos);
-		_regions.push_back(newRegion);
+		RegionSpecT spec;
+		spec.chrom = json_string_value(jvChr);
+		spec.startPos = startPos;
+		spec.endPos = endPos;
+		spec.inputIndex = specs.size();
+		specs.push_back(spec);
 	}
 
 	json_decref(root);
 }
 
+static void parseBed(const std::string& regionBed, RegionSpecVec& specs) {
+	std::istringstream is(regionBed);
+	std::string line;
+
+	while(std::getline(is, line)) {
+		if(!line.empty() && line[line.length() - 1] == '\r') line.erase(line.length() - 1);
+
+		size_t first = line.find_first_not_of(" \t");
+		if(first == std::string::npos || line[first] == '#') continue;
+		if(line.compare(first, 5, "track") == 0 || line.compare(first, 7, "browser") == 0) continue;
+
+		std::istringstream fields(line);
+		std::string chrom;
+		long long bedStart, bedEnd;
+		if(!(fields>>chrom>>bedStart>>bedEnd) || bedStart < 0 || bedEnd < bedStart || bedEnd > INT32_MAX)
+			throw new GenomicRegionStore::InvalidBedLineException;
+
+		// an empty interval holds no position
+		if(bedEnd == bedStart) continue;
+
+		// BED intervals are half open, regions include their end position
+		RegionSpecT spec;
+		spec.chrom = chrom;
+		spec.startPos = bedStart;
+		spec.endPos = bedEnd - 1;
+		spec.inputIndex = specs.size();
+		specs.push_back(spec);
+	}
+}
+
+GenomicRegionStore::GenomicRegionStore() :
+	_mappedImage(NULL), _mappedLength(0),
+	_image(NULL), _header(NULL), _chroms(NULL), _regions(NULL)
+{
+}
+
+GenomicRegionStore::GenomicRegionStore(const std::string& regionSpec) :
+	_mappedImage(NULL), _mappedLength(0),
+	_image(NULL), _header(NULL), _chroms(NULL), _regions(NULL)
+{
+	if(regionSpec.compare(0, kIndexMagicPrefix, kIndexMagic, kIndexMagicPrefix) == 0) {
+		_ownedImage.assign(regionSpec.begin(), regionSpec.end());
+		attachImage(_ownedImage.data(), _ownedImage.size());
+		return;
+	}
+
+	RegionSpecVec specs;
+
+	size_t first = regionSpec.find_first_not_of(" \t\r\n");
+	if(first != std::string::npos && regionSpec[first] != '[')
+		parseBed(regionSpec, specs);
+	else
+		parseJson(regionSpec, specs);
+
+	std::sort(specs.begin(), specs.end());
+
+	/* lay out the image */
+
+	std::vector<std::string> chromNames;
+	for(size_t i=0; i<specs.size(); i++) {
+		if(chromNames.empty() || chromNames.back() != specs[i].chrom)
+			chromNames.push_back(specs[i].chrom);
+	}
+
+	size_t namesLength = 0;
+	for(size_t i=0; i<chromNames.size(); i++) namesLength += chromNames[i].length() + 1;
+
+	ImageHeaderT header;
+	memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+	header.chromCount = chromNames.size();
+	header.regionCount = specs.size();
+	header.chromsOffset = sizeof(ImageHeaderT);
+	header.regionsOffset = header.chromsOffset + header.chromCount * sizeof(ChromT);
+	header.namesOffset = header.regionsOffset + header.regionCount * sizeof(GenomicRegionT);
+	header.imageSize = header.namesOffset + namesLength;
+
+	_ownedImage.assign(header.imageSize, 0);
+	char * image = _ownedImage.data();
+	memcpy(image, &header, sizeof(header));
+
+	ChromT * chroms = reinterpret_cast<ChromT *>(image + header.chromsOffset);
+	GenomicRegionT * regions = reinterpret_cast<GenomicRegionT *>(image + header.regionsOffset);
+
+	uint64_t nameOffset = header.namesOffset;
+	size_t regionIndex = 0;
+	for(size_t c=0; c<chromNames.size(); c++) {
+		memcpy(image + nameOffset, chromNames[c].c_str(), chromNames[c].length() + 1);
+
+		chroms[c].nameOffset = nameOffset;
+		chroms[c].firstRegion = regionIndex;
+
+		int32_t maxEnd = INT32_MIN;
+		for(; regionIndex < specs.size() && specs[regionIndex].chrom == chromNames[c]; regionIndex++) {
+			GenomicRegionT& region = regions[regionIndex];
+			region.startPos = specs[regionIndex].startPos;
+			region.endPos = specs[regionIndex].endPos;
+			maxEnd = std::max(maxEnd, region.endPos);
+			region.maxEnd = maxEnd;
+			region.chromIndex = c;
+			region.inputIndex = specs[regionIndex].inputIndex;
+			region.chromOffset = static_cast<int64_t>(nameOffset) - static_cast<int64_t>(reinterpret_cast<char *>(&region) - image);
+		}
+
+		chroms[c].regionCount = regionIndex - chroms[c].firstRegion;
+		nameOffset += chromNames[c].length() + 1;
+	}
+
+	attachImage(_ownedImage.data(), _ownedImage.size());
+}
+
+GenomicRegionStore::~GenomicRegionStore() {
+	if(_mappedImage) munmap(_mappedImage, _mappedLength);
+}
+
+void GenomicRegionStore::attachImage(const char * image, size_t length) {
+
+	/* an index file may come from anywhere, check every offset before trusting it */
+
+	if(length < sizeof(ImageHeaderT)) throw new InvalidIndexException;
+
+	const ImageHeaderT * header = reinterpret_cast<const ImageHeaderT *>(image);
+	if(memcmp(header->magic, kIndexMagic, sizeof(kIndexMagic)) != 0 || header->imageSize != length)
+		throw new InvalidIndexException;
+
+	if(header->chromsOffset != sizeof(ImageHeaderT)
+			|| header->chromCount > length / sizeof(ChromT)
+			|| header->regionCount > length / sizeof(GenomicRegionT)
+			|| header->regionsOffset != header->chromsOffset + header->chromCount * sizeof(ChromT)
+			|| header->namesOffset != header->regionsOffset + header->regionCount * sizeof(GenomicRegionT)
+			|| header->namesOffset > length)
+		throw new InvalidIndexException;
+
+	if(header->regionCount > 0 && (header->chromCount == 0 || image[length - 1] != '\0'))
+		throw new InvalidIndexException;
+
+	const ChromT * chroms = reinterpret_cast<const ChromT *>(image + header->chromsOffset);
+	const GenomicRegionT * regions = reinterpret_cast<const GenomicRegionT *>(image + header->regionsOffset);
+
+	uint64_t expectedFirst = 0;
+	for(uint64_t c=0; c<header->chromCount; c++) {
+		const ChromT& chrom = chroms[c];
+
+		if(chrom.nameOffset < header->namesOffset || chrom.nameOffset >= length
+				|| chrom.firstRegion != expectedFirst
+				|| chrom.regionCount > header->regionCount - chrom.firstRegion)
+			throw new InvalidIndexException;
+
+		if(c > 0 && strcmp(image + chroms[c - 1].nameOffset, image + chrom.nameOffset) >= 0)
+			throw new InvalidIndexException;
+
+		int32_t maxEnd = INT32_MIN;
+		for(uint64_t r=chrom.firstRegion; r<chrom.firstRegion + chrom.regionCount; r++) {
+			const GenomicRegionT& region = regions[r];
+			maxEnd = std::max(maxEnd, region.endPos);
+
+			if(region.chromIndex != c || region.maxEnd != maxEnd
+					|| region.startPos < 0 || region.endPos < region.startPos
+					|| region.inputIndex >= header->regionCount
+					|| region.chrom() != image + chrom.nameOffset
+					|| (r > chrom.firstRegion && region.startPos < regions[r - 1].startPos))
+				throw new InvalidIndexException;
+		}
+
+		expectedFirst += chrom.regionCount;
+	}
+
+	if(expectedFirst != header->regionCount) throw new InvalidIndexException;
+
+	_image = image;
+	_header = header;
+	_chroms = chroms;
+	_regions = regions;
+}
+
+GenomicRegionStore * GenomicRegionStore::fromFile(const std::string& path) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0) throw new CannotOpenFileException;
+
+	struct stat st;
+	char magic[sizeof(kIndexMagic)];
+	bool isIndex = fstat(fd, &st) == 0
+		&& static_cast<size_t>(st.st_size) >= sizeof(ImageHeaderT)
+		&& pread(fd, magic, sizeof(magic), 0) == sizeof(magic)
+		&& memcmp(magic, kIndexMagic, kIndexMagicPrefix) == 0;
+
+	if(!isIndex) {
+		close(fd);
+
+		std::ifstream fs(path);
+		std::string regionSpec((std::istreambuf_iterator<char>(fs)), std::istreambuf_iterator<char>());
+		return new GenomicRegionStore(regionSpec);
+	}
+
+	void * mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(mapped == MAP_FAILED) throw new CannotOpenFileException;
+
+	GenomicRegionStore * store = new GenomicRegionStore();
+	store->_mappedImage = mapped;
+	store->_mappedLength = st.st_size;
+
+	try {
+		store->attachImage(static_cast<const char *>(mapped), st.st_size);
+	}
+	catch(...) {
+		delete store;
+		throw;
+	}
+
+	return store;
+}
+
+bool GenomicRegionStore::writeIndex(const std::string& path) const {
+	// write aside and rename, so a concurrent fromFile() never maps a partial index
+	std::string tmpPath = path + ".tmp";
+
+	std::ofstream os(tmpPath.c_str(), std::ios::binary | std::ios::trunc);
+	os.write(_image, _header->imageSize);
+	os.close();
+
+	if(!os.good() || rename(tmpPath.c_str(), path.c_str()) != 0) {
+		unlink(tmpPath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
 const GenomicRegionStore::GenomicRegionT& GenomicRegionStore::kRegionNotFound() {
-	static GenomicRegionT notfound("", 0, 0);
-	return notfound;
+	// the name follows the region, like the names of an image do
+	static const struct {
+		GenomicRegionT region;
+		char name[8];
+	} notfound = { { 0, 0, 0, 0, sizeof(GenomicRegionT), 0, 0 }, "" };
+
+	return notfound.region;
+}
+
+const GenomicRegionStore::ChromT * GenomicRegionStore::locateChrom(const char *chrom) const {
+	size_t low = 0, high = _header->chromCount;
+
+	while(low < high) {
+		size_t mid = low + (high - low) / 2;
+		int c = strcmp(_image + _chroms[mid].nameOffset, chrom);
+		if(c == 0) return &_chroms[mid];
+		if(c < 0) low = mid + 1;
+		else high = mid;
+	}
+
+	return NULL;
 }
 
-const GenomicRegionStore::GenomicRegionT& GenomicRegionStore::locateRegion(const char *chrom, int32_t pos) {
+const GenomicRegionStore::GenomicRegionT& GenomicRegionStore::locateRegion(const char *chrom, int32_t pos) const {
+
+	const ChromT * c = locateChrom(chrom);
+	if(c == NULL) return GenomicRegionStore::kRegionNotFound();
+
+	const GenomicRegionT * first = _regions + c->firstRegion;
+	const GenomicRegionT * last = first + c->regionCount;
+
+	// the last region starting at or before pos is the first candidate
+	const GenomicRegionT * it = std::upper_bound(first, last, pos,
+			[](int32_t p, const GenomicRegionT& region) { return p < region.startPos; });
 
-	GenomicRegionVec::iterator it;
-	for(it = _regions.begin(); it != _regions.end(); it++) {
-		if(it->contains(chrom, pos))
-			return *it;
+	// walk back until no earlier region can reach pos, keeping the
+	// containing region listed first in the region set
+	const GenomicRegionT * found = NULL;
+	while(it != first) {
+		--it;
+		if(it->maxEnd < pos) break;
+		if(it->endPos >= pos && (found == NULL || it->inputIndex < found->inputIndex)) found = it;
 	}
 
-	return GenomicRegionStore::kRegionNotFound();
+	return found ? *found : GenomicRegionStore::kRegionNotFound();
 }
@@ -5,51 +5,161 @@
 
 #include <stdint.h>
 #include <vector>
+#include <string>
 #include <iostream>
 
 #include <cstring>
 
 namespace BamstatsAlive {
 
-
+	/**
+	 * A read-only set of genomic regions
+	 *
+	 * The regions live in a single flat image: a header, a table of the
+	 * chromosomes sorted by name, the regions sorted by chromosome and start
+	 * position, and the chromosome names. Every offset in the image is
+	 * relative to the image itself, so the image parsed from a json or BED
+	 * region set is byte for byte the index file written by writeIndex(),
+	 * and fromFile() maps such a file into memory and uses it in place
+	 * without allocating anything.
+	 *
+	 * Index files are written in the byte order of the host.
+	 */
 	class GenomicRegionStore {
 
 		public:
 			typedef struct _regionT {
-				const char * chrom;
 				int32_t startPos;
 				int32_t endPos;
+				/** The largest endPos of this and all the preceding regions of the chromosome */
+				int32_t maxEnd;
+				uint32_t chromIndex;
+				/** Offset from this region to its NUL terminated chromosome name */
+				int64_t chromOffset;
+				/** Position of the region in the region set it was built from */
+				uint32_t inputIndex;
+				uint32_t reserved;
 
-				_regionT(const char *chrom, int32_t startPos, int32_t endPos) : 
-					chrom(NULL), startPos(startPos), endPos(endPos) 
-				{ this->chrom = strdup(chrom); }
+				inline const char * chrom() const { return reinterpret_cast<const char *>(this) + chromOffset; }
 
 				bool contains(const char *chrom, int32_t pos) const {
-					if(strcmp(chrom, this->chrom) != 0) return false;
+					if(strcmp(chrom, this->chrom()) != 0) return false;
 					if(pos < startPos || pos > endPos) return false;
 					return true;
 				}
 			} GenomicRegionT;
 
-			typedef std::vector<GenomicRegionT> GenomicRegionVec;
+			/** The regions of the store, sorted by chromosome name and start position */
+			class GenomicRegionRange {
+				private:
+					const GenomicRegionT * _begin;
+					const GenomicRegionT * _end;
+				public:
+					GenomicRegionRange(const GenomicRegionT * begin, const GenomicRegionT * end) : _begin(begin), _end(end) {}
+
+					inline const GenomicRegionT * begin() const { return _begin; }
+					inline const GenomicRegionT * end() const { return _end; }
+					inline size_t size() const { return _end - _begin; }
+					inline const GenomicRegionT& operator[](size_t i) const { return _begin[i]; }
+			};
 
 		protected:
-			GenomicRegionVec _regions;
+			typedef struct _imageHeaderT {
+				char magic[8];
+				uint64_t imageSize;
+				uint64_t chromCount;
+				uint64_t regionCount;
+				uint64_t chromsOffset;
+				uint64_t regionsOffset;
+				uint64_t namesOffset;
+			} ImageHeaderT;
+
+			typedef struct _chromT {
+				/** Offset of the NUL terminated name from the start of the image */
+				uint64_t nameOffset;
+				uint64_t firstRegion;
+				uint64_t regionCount;
+			} ChromT;
+
+			static const char kIndexMagic[8];
+
+			std::vector<char> _ownedImage;
+			void * _mappedImage;
+			size_t _mappedLength;
+
+			const char * _image;
+			const ImageHeaderT * _header;
+			const ChromT * _chroms;
+			const GenomicRegionT * _regions;
+
+			GenomicRegionStore();
+
+			/**
+			 * Validate an image and point the store into it
+			 *
+			 * @param image The image, which has to outlive the store
+			 * @param length The length of the image in bytes
+			 */
+			void attachImage(const char * image, size_t length);
+
+			const ChromT * locateChrom(const char *chrom) const;
 
 		public:
-			GenomicRegionStore(const std::string& regionJson);
-
-			inline const GenomicRegionVec& regions() { return _regions; }
+			/**
+			 * Build the store from a region set held in memory
+			 *
+			 * @param regionSpec Either a json array of {"chr", "start", "end"}
+			 *        objects, BED lines, or the content of an index file
+			 */
+			GenomicRegionStore(const std::string& regionSpec);
+			~GenomicRegionStore();
+
+			GenomicRegionStore(const GenomicRegionStore&) = delete;
+			GenomicRegionStore& operator=(const GenomicRegionStore&) = delete;
+
+			/**
+			 * Build the store from a region file, mapping it into memory if it
+			 * is an index file
+			 *
+			 * @param path The json, BED or index file
+			 * @return The store, owned by the caller
+			 */
+			static GenomicRegionStore * fromFile(const std::string& path);
+
+			/**
+			 * Write the image of the store as an index file, to be loaded by fromFile()
+			 *
+			 * @return Whether the index file has been written
+			 */
+			bool writeIndex(const std::string& path) const;
+
+			inline GenomicRegionRange regions() const { return GenomicRegionRange(_regions, _regions + _header->regionCount); }
+
+			/** The image of the store, identical to the content of its index file */
+			inline const char * image() const { return _image; }
+			inline size_t imageSize() const { return _header->imageSize; }
 
 			// methods for locating a region
-			static const GenomicRegionT& kRegionNotFound(); 
-			const GenomicRegionT& locateRegion(const char *chrom, int32_t pos);
+			static const GenomicRegionT& kRegionNotFound();
+
+			/**
+			 * Locate a region containing a position
+			 *
+			 * If the position falls in overlapping regions, the one listed
+			 * first in the region set is returned, as the regional statistics
+			 * have always been attributed to it.
+			 */
+			const GenomicRegionT& locateRegion(const char *chrom, int32_t pos) const;
+
 
-			
 			class InvalidJsonStringException {};
 			class JsonRootNotArrayException {};
 			class ArrayItemsNotObjectException {};
 			class UnexpectedFieldDataTypeException {};
+			class InvalidBedLineException {};
+			class InvalidRegionException {};
+			class InvalidIndexException {};
+			class CannotOpenFileException {};
 	};
 }
 
@@ -1,17 +1,91 @@
 #include "HistogramStatsCollector.h"
+#include "PerfCounters.h"
+#include "CollectorRegistry.h"
 #include <cmath>
 
 using namespace BamstatsAlive;
 using namespace std;
 
-HistogramStatsCollector::HistogramStatsCollector(std::map<int32_t, std::string>& chromIDNameMap, unsigned int skipFactor, GenomicRegionStore* regionStore) : 
+// bin widths of the mapping quality, fragment size, read length and coverage
+// histograms at each resolution of progressive output, and the reads after
+// which it is reached even if the distributions still move
+typedef struct _resolutionT {
+	unsigned int mapqBin;
+	unsigned int fragBin;
+	unsigned int lengthBin;
+	unsigned int coverageBin;
+	uint64_t reads;
+} ResolutionT;
+
+static const ResolutionT kResolutions[] = {
+	{ 10, 50, 10, 10, 0 },
+	{ 5, 10, 2, 2, 20000 },
+	{ 1, 1, 1, 1, 200000 }
+};
+static const size_t kFullResolution = sizeof(kResolutions) / sizeof(kResolutions[0]) - 1;
+
+// a distribution has settled when the log of its median moved by less than
+// about 2% over the last frames
+static const unsigned int kSettleFrames = 5;
+static const double kSettleThreshold = 0.02;
+
+template<class K>
+static json_t * histogramToJson(const map<K, unsigned int>& hist) {
+	json_t * j_hist = json_object();
+	for(auto it = hist.cbegin(); it != hist.cend(); it++) {
+		stringstream labelSS; labelSS << it->first;
+		json_object_set_new(j_hist, labelSS.str().c_str(), json_integer(it->second));
+	}
+	return j_hist;
+}
+
+template<class K>
+static json_t * histogramToJson(const map<K, unsigned int>& hist, unsigned int binWidth) {
+	if(binWidth <= 1) return histogramToJson(hist);
+
+	// each bin is labelled by its lowest value
+	K width = binWidth;
+	map<K, unsigned int> bins;
+	for(auto it = hist.cbegin(); it != hist.cend(); it++) {
+		K bin = it->first >= 0 ? it->first / width * width : -((width - 1 - it->first) / width * width);
+		bins[bin] += it->second;
+	}
+	return histogramToJson(bins);
+}
+
+template<class K>
+static void histogramFromJson(map<K, unsigned int>& hist, const json_t * j_hist) {
+	hist.clear();
+	if(!json_is_object(j_hist)) return;
+
+	const char * key;
+	json_t * value;
+	json_object_foreach(const_cast<json_t *>(j_hist), key, value) {
+		K label;
+		stringstream labelSS(key); labelSS >> label;
+		hist[label] = json_integer_value(value);
+	}
+}
+
+HistogramStatsCollector::HistogramStatsCollector(std::map<int32_t, std::string>& chromIDNameMap, unsigned int skipFactor, const GenomicRegionStore* regionStore) : 
 	_chromIDNameMap(chromIDNameMap),
 	kCovHistSkipFactor(skipFactor), 
 	m_covHistAccumu(0),
 	_currentRegion(nullptr),
 	_regionStore(regionStore),
 	_coverageCollector(nullptr),
-	m_covHistTotalPos(0)
+	_inputInRegions(false),
+	_summaryOnly(false),
+	_selection(CollectorRegistry::kHistogramCollectors),
+	_nameSorted(false),
+	_progressive(false),
+	_resolution(kFullResolution),
+	_framesAtResolution(0),
+	_progressiveReads(0),
+	_mapqMonitor(kSettleFrames, kSettleThreshold),
+	_fragMonitor(kSettleFrames, kSettleThreshold),
+	_lengthMonitor(kSettleFrames, kSettleThreshold),
+	_coverageMonitor(kSettleFrames, kSettleThreshold)
 {
 	memset(m_mappingQualHist, 0, sizeof(unsigned int) * 256);
 	memset(m_baseQualHist, 0, sizeof(unsigned int) * 51);
@@ -21,6 +95,7 @@ HistogramStatsCollector::HistogramStatsCollector(std::map<int32_t, std::string>&
 }
 
 HistogramStatsCollector::~HistogramStatsCollector() {
+	if(_coverageCollector) delete _coverageCollector;
 }
 
 void HistogramStatsCollector::updateReferenceHistogram(const BamTools::BamAlignment& al, const BamTools::RefVector& refVector) {
@@ -33,6 +108,9 @@ void HistogramStatsCollector::updateMappingQualityHistogram(const BamTools::BamA
 }
 
 void HistogramStatsCollector::updateReadLengthHistogram(const BamTools::BamAlignment& al) {
+	m_lengthSketch.add(al.Length);
+	if(_summaryOnly) return;
+
 	if(m_lengthHist.find(al.Length) != m_lengthHist.end())
 		m_lengthHist[al.Length]++;
 	else
@@ -42,15 +120,23 @@ void HistogramStatsCollector::updateReadLengthHistogram(const BamTools::BamAlign
 void HistogramStatsCollector::updateFragmentSizeHistogram(const BamTools::BamAlignment& al) {
 	if ( al.IsPaired() && al.IsMapped() && al.IsMateMapped()) {
 		if( al.RefID == al.MateRefID && al.MatePosition > al.Position )  {
-			int32_t frag = al.InsertSize; //al.MatePosition - al.Position;
-			if(m_fragHist.find(frag) != m_fragHist.end())
-				m_fragHist[frag]++;
-			else
-				m_fragHist[frag] = 1;
+			addFragmentSize(al.InsertSize); //al.MatePosition - al.Position;
 		}
 	}
 }
 
+void HistogramStatsCollector::addFragmentSize(int32_t frag) {
+	if(!(_selection & CollectorRegistry::kCollectFrag)) return;
+
+	m_fragSketch.add(frag);
+	if(_summaryOnly) return;
+
+	if(m_fragHist.find(frag) != m_fragHist.end())
+		m_fragHist[frag]++;
+	else
+		m_fragHist[frag] = 1;
+}
+
 void HistogramStatsCollector::updateBaseQualityHistogram(const BamTools::BamAlignment& al) {
 	const unsigned char *q = (const unsigned char *)al.Qualities.c_str();
 	if (q[0] != 0xff) {
@@ -69,15 +155,19 @@ void HistogramStatsCollector::updateRegionalStats(const BamTools::BamAlignment&
 	decltype(_currentRegion) _thisReadRegion = nullptr;
 
 	// locate the region the current read is in
-	const GenomicRegionStore::GenomicRegionT& regionWithStart = _regionStore->locateRegion(_chromIDNameMap[al.RefID].c_str(), al.Position);
+	{
+		BSA_PERF_SCOPE(PerfCounters::kStageRegionLookup);
 
-	if(&regionWithStart != &GenomicRegionStore::kRegionNotFound()) {
-		_thisReadRegion = &regionWithStart;
-	}
-	else {
-		const GenomicRegionStore::GenomicRegionT& regionWithEnd = _regionStore->locateRegion(_chromIDNameMap[al.RefID].c_str(), al.Position + al.Length);
-		if(&regionWithEnd != &GenomicRegionStore::kRegionNotFound()) {
-			_thisReadRegion = &regionWithEnd;
+		const GenomicRegionStore::GenomicRegionT& regionWithStart = _regionStore->locateRegion(_chromIDNameMap[al.RefID].c_str(), al.Position);
+
+		if(&regionWithStart != &GenomicRegionStore::kRegionNotFound()) {
+			_thisReadRegion = &regionWithStart;
+		}
+		else {
+			const GenomicRegionStore::GenomicRegionT& regionWithEnd = _regionStore->locateRegion(_chromIDNameMap[al.RefID].c_str(), al.Position + al.Length);
+			if(&regionWithEnd != &GenomicRegionStore::kRegionNotFound()) {
+				_thisReadRegion = &regionWithEnd;
+			}
 		}
 	}
 
@@ -85,8 +175,8 @@ void HistogramStatsCollector::updateRegionalStats(const BamTools::BamAlignment&
 		if(_currentRegion != nullptr ) {
 			if(m_covHistAccumu == 0) {
 				// switched outside of pile up region
-				// update histogram and delete coverage collector
-				m_covHist = _coverageCollector->getEffectiveHistogram(m_covHistTotalPos);
+				// the histogram is already merged in place, so just
+				// return the coverage buffer to the pool
 				delete _coverageCollector;
 				_coverageCollector = nullptr;
 			}
@@ -102,43 +192,123 @@ void HistogramStatsCollector::updateRegionalStats(const BamTools::BamAlignment&
 	if(m_covHistAccumu != 0) return;
 	if(_currentRegion == nullptr) return;
 
-	updateBaseQualityHistogram(al);
+	if(_selection & CollectorRegistry::kCollectBaseq) updateBaseQualityHistogram(al);
+	if(!(_selection & CollectorRegistry::kCollectCoverage)) return;
 
 	// feed pileup
 	//_currentRegionLength = _currentRegion->endPos - _currentRegion->startPos + 1;
 
 	if(_coverageCollector == nullptr) {
-		_coverageCollector = new CoverageMapStatsCollector(_currentRegion, m_covHist);
+		_coverageCollector = new CoverageMapStatsCollector(_currentRegion, _coverageBufferPool, m_covHist);
 	}
 	_coverageCollector->processAlignment(al, refVector);
 }
 
+unsigned int HistogramStatsCollector::requiredFieldsImpl() const {
+	// base qualities are only counted inside of regions
+	if(!(_selection & CollectorRegistry::kCollectBaseq)) return 0;
+	return (_regionStore || _inputInRegions || _nameSorted) ? kFieldQualities : 0;
+}
+
+void HistogramStatsCollector::setProgressive(bool progressive) {
+	_progressive = progressive;
+	_resolution = progressive ? 0 : kFullResolution;
+	_framesAtResolution = 0;
+}
+
 void HistogramStatsCollector::processAlignmentImpl(const BamTools::BamAlignment& al, const BamTools::RefVector& refVector) {
 
-	updateReferenceHistogram(al, refVector);
+	if(_progressive) _progressiveReads++;
 
-	updateMappingQualityHistogram(al);
+	if(_selection & CollectorRegistry::kCollectRefAln) updateReferenceHistogram(al, refVector);
 
-	updateReadLengthHistogram(al);
+	if(_selection & CollectorRegistry::kCollectMapq) updateMappingQualityHistogram(al);
 
-	updateFragmentSizeHistogram(al);
+	if(_selection & CollectorRegistry::kCollectLength) updateReadLengthHistogram(al);
+
+	// mates of name sorted input are paired elsewhere, and regions mean nothing there
+	if(_nameSorted) {
+		if(_selection & CollectorRegistry::kCollectBaseq) updateBaseQualityHistogram(al);
+		return;
+	}
+
+	if(_selection & CollectorRegistry::kCollectFrag) updateFragmentSizeHistogram(al);
+
+	if(_inputInRegions && (_selection & CollectorRegistry::kCollectBaseq)) updateBaseQualityHistogram(al);
 
 	updateRegionalStats(al, refVector);
 }
 
+static QuantileSummaryT histogramSummary(const unsigned int * hist, size_t size) {
+	QuantileSummaryT summary;
+	for(size_t i=0; i<size; i++) summary.count += hist[i];
+	if(summary.count == 0) return summary;
+
+	const double ranks[] = { 0.01, 0.25, 0.5, 0.75, 0.99 };
+	int32_t * values[] = { &summary.p1, &summary.q1, &summary.median, &summary.q3, &summary.p99 };
+
+	size_t r = 0;
+	uint64_t rank = 0;
+	bool seen = false;
+	for(size_t i=0; i<size; i++) {
+		if(hist[i] == 0) continue;
+		if(!seen) summary.min = i;
+		seen = true;
+		summary.max = i;
+
+		rank += hist[i];
+		while(r < 5 && rank >= ranks[r] * summary.count) *values[r++] = i;
+	}
+
+	return summary;
+}
+
 void HistogramStatsCollector::appendJsonImpl(json_t *jsonRootObj) {
 
+   const ResolutionT& resolution = kResolutions[_resolution];
+
+   // quantiles, exact for mapping qualities and sketched for the unbounded ones
+   QuantileSummaryT mapqSummary, fragSummary, lengthSummary;
+   if(_selection & CollectorRegistry::kCollectMapq) {
+      mapqSummary = histogramSummary(m_mappingQualHist, 256);
+      json_object_set_new(jsonRootObj, "mapq_quantiles", mapqSummary.toJson());
+   }
+   if(_selection & CollectorRegistry::kCollectFrag) {
+      fragSummary = m_fragSketch.summary();
+      json_object_set_new(jsonRootObj, "frag_quantiles", fragSummary.toJson());
+   }
+   if(_selection & CollectorRegistry::kCollectLength) {
+      lengthSummary = m_lengthSketch.summary();
+      json_object_set_new(jsonRootObj, "length_quantiles", lengthSummary.toJson());
+   }
+
+   // bin widths of the histograms below, labelled by their lowest value
+   if(_progressive) {
+      json_t * j_resolution = json_object();
+      json_object_set_new(j_resolution, "level", json_integer(_resolution));
+      json_object_set_new(j_resolution, "mapq", json_integer(resolution.mapqBin));
+      json_object_set_new(j_resolution, "frag", json_integer(resolution.fragBin));
+      json_object_set_new(j_resolution, "length", json_integer(resolution.lengthBin));
+      json_object_set_new(j_resolution, "coverage", json_integer(resolution.coverageBin));
+      json_object_set_new(jsonRootObj, "resolution", j_resolution);
+   }
+
    // Mapping quality map
-   json_t * j_mapq_hist = json_object();
-   for(size_t i=0; i<256; i++) {
-      if (m_mappingQualHist[i] > 0) {
-         stringstream labelSS; labelSS << i;
-         json_object_set_new(j_mapq_hist, labelSS.str().c_str(), json_integer(m_mappingQualHist[i]));
+   if(_selection & CollectorRegistry::kCollectMapq) {
+      json_t * j_mapq_hist = json_object();
+      for(size_t i=0; i<256; i+=resolution.mapqBin) {
+         unsigned int count = 0;
+         for(size_t j=i; j<i+resolution.mapqBin && j<256; j++) count += m_mappingQualHist[j];
+         if (count > 0) {
+            stringstream labelSS; labelSS << i;
+            json_object_set_new(j_mapq_hist, labelSS.str().c_str(), json_integer(count));
+         }
       }
+      json_object_set_new(jsonRootObj, "mapq_hist", j_mapq_hist);
    }
-   json_object_set_new(jsonRootObj, "mapq_hist", j_mapq_hist);
    
    // Base quality map
+   if(_selection & CollectorRegistry::kCollectBaseq) {
       json_t * j_baseq_hist = json_object();
       for(size_t i=0; i<=50; i++) {
          if (m_baseQualHist[i] > 0) {
@@ -147,42 +317,159 @@ void HistogramStatsCollector::appendJsonImpl(json_t *jsonRootObj) {
          }
       }
       json_object_set_new(jsonRootObj, "baseq_hist", j_baseq_hist);  
-   
-   // Fragment length hisogram array
-   json_t * j_frag_hist = json_object();
-   for(map<int32_t, unsigned int>::iterator it = m_fragHist.begin(); it!=m_fragHist.end(); it++) {
-      stringstream labelSS; labelSS<<it->first;
-      json_object_set_new(j_frag_hist, labelSS.str().c_str(), json_integer(it->second));
    }
-   json_object_set_new(jsonRootObj, "frag_hist", j_frag_hist);
    
-   // Read length histogram array
-   json_t * j_length_hist = json_object();
-   for(map<int32_t, unsigned int>::iterator it = m_lengthHist.begin(); it!=m_lengthHist.end(); it++) {
-      stringstream labelSS; labelSS << it->first;
-      json_object_set_new(j_length_hist, labelSS.str().c_str(), json_integer(it->second));
-   }
-   json_object_set_new(jsonRootObj, "length_hist", j_length_hist);
+   // Fragment length and read length histograms, only kept when reported
+   if(!_summaryOnly && (_selection & CollectorRegistry::kCollectFrag))
+      json_object_set_new(jsonRootObj, "frag_hist", histogramToJson(m_fragHist, resolution.fragBin));
+
+   if(!_summaryOnly && (_selection & CollectorRegistry::kCollectLength))
+      json_object_set_new(jsonRootObj, "length_hist", histogramToJson(m_lengthHist, resolution.lengthBin));
    
    // Reference alignment histogram array
-   json_t * j_refAln_hist = json_object();
-   for(map<std::string, unsigned int>::iterator it = m_refAlnHist.begin(); it!=m_refAlnHist.end(); it++) {
-      stringstream labelSS; labelSS << it->first;
-      json_object_set_new(j_refAln_hist, labelSS.str().c_str(), json_integer(it->second));
+   if(_selection & CollectorRegistry::kCollectRefAln) {
+      json_t * j_refAln_hist = json_object();
+      for(map<std::string, unsigned int>::iterator it = m_refAlnHist.begin(); it!=m_refAlnHist.end(); it++) {
+         stringstream labelSS; labelSS << it->first;
+         json_object_set_new(j_refAln_hist, labelSS.str().c_str(), json_integer(it->second));
+      }
+      json_object_set_new(jsonRootObj, "refAln_hist", j_refAln_hist);
    }
-   json_object_set_new(jsonRootObj, "refAln_hist", j_refAln_hist);
 
-   // coverage histogram
-   if(_coverageCollector != nullptr)
-	   _coverageCollector->appendJson(jsonRootObj);
-   else {
-	   json_t * j_cov_hist = json_object();
+   // coverage histogram, the pending region's coverage is merged in place
+   if(_selection & CollectorRegistry::kCollectCoverage)
+      json_object_set_new(jsonRootObj, "coverage_hist", m_covHist.toJson(resolution.coverageBin));
+}
 
-	   for(auto it = m_covHist.begin(); it != m_covHist.end(); it++) {
-		   stringstream labelSS; labelSS << it->first;
-		   json_object_set_new(j_cov_hist, labelSS.str().c_str(), json_real( it->second / static_cast<double>(m_covHistTotalPos)));
-	   }
-	   json_object_set_new(jsonRootObj, "coverage_hist", j_cov_hist);
+void HistogramStatsCollector::advanceResolution() {
+	if(!_progressive || _resolution == kFullResolution) return;
+	_framesAtResolution++;
 
-   }
+	QuantileSummaryT mapq, frag, length;
+	if(_selection & CollectorRegistry::kCollectMapq) mapq = histogramSummary(m_mappingQualHist, 256);
+	if(_selection & CollectorRegistry::kCollectFrag) frag = m_fragSketch.summary();
+	if(_selection & CollectorRegistry::kCollectLength) length = m_lengthSketch.summary();
+
+	// a distribution without data has nothing left to settle
+	bool settled = true;
+	if(mapq.count > 0) {
+		_mapqMonitor.addValue(log1p(mapq.median));
+		settled = settled && _mapqMonitor.isSatisfied();
+	}
+	if(frag.count > 0) {
+		_fragMonitor.addValue(log1p(abs(frag.median)));
+		settled = settled && _fragMonitor.isSatisfied();
+	}
+	if(length.count > 0) {
+		_lengthMonitor.addValue(log1p(length.median));
+		settled = settled && _lengthMonitor.isSatisfied();
+	}
+	if(m_covHist.positions() > 0) {
+		_coverageMonitor.addValue(log1p(m_covHist.meanDepth()));
+		settled = settled && _coverageMonitor.isSatisfied();
+	}
+
+	// the monitors only trail frames reported at the current resolution
+	settled = settled && _framesAtResolution >= kSettleFrames;
+
+	if(settled || _progressiveReads >= kResolutions[_resolution + 1].reads) {
+		_resolution++;
+		_framesAtResolution = 0;
+	}
+}
+
+void HistogramStatsCollector::mergeImpl(const AbstractStatCollector& other) {
+	const HistogramStatsCollector& otherHist = dynamic_cast<const HistogramStatsCollector&>(other);
+
+	for(size_t i=0; i<256; i++) m_mappingQualHist[i] += otherHist.m_mappingQualHist[i];
+	for(size_t i=0; i<=50; i++) m_baseQualHist[i] += otherHist.m_baseQualHist[i];
+
+	// the full histograms are not kept once only the quantiles are reported,
+	// and are not whole once either side has stopped keeping them
+	if(otherHist._summaryOnly && !_summaryOnly) {
+		_summaryOnly = true;
+		m_fragHist.clear();
+		m_lengthHist.clear();
+	}
+	if(!_summaryOnly) {
+		for(auto it = otherHist.m_fragHist.cbegin(); it != otherHist.m_fragHist.cend(); it++)
+			m_fragHist[it->first] += it->second;
+
+		for(auto it = otherHist.m_lengthHist.cbegin(); it != otherHist.m_lengthHist.cend(); it++)
+			m_lengthHist[it->first] += it->second;
+	}
+
+	m_fragSketch.merge(otherHist.m_fragSketch);
+	m_lengthSketch.merge(otherHist.m_lengthSketch);
+
+	for(auto it = otherHist.m_refAlnHist.cbegin(); it != otherHist.m_refAlnHist.cend(); it++)
+		m_refAlnHist[it->first] += it->second;
+
+	// coverage of the other collector's current region is merged in place
+	// as it goes, so its histogram is already complete
+	m_covHist.merge(otherHist.m_covHist);
+}
+
+size_t HistogramStatsCollector::memoryUsageImpl() const {
+	return sizeof(m_mappingQualHist) + sizeof(m_baseQualHist)
+		+ mapMemoryUsage(m_fragHist) + mapMemoryUsage(m_lengthHist) + m_covHist.memoryUsage()
+		+ mapMemoryUsage(m_refAlnHist) + m_refAlnHist.size() * sizeof(std::string)
+		+ m_fragSketch.memoryUsage() + m_lengthSketch.memoryUsage()
+		+ _coverageBufferPool.memoryUsage();
+}
+
+bool HistogramStatsCollector::shedMemoryImpl() {
+	// fall back to the quantile sketches for the unbounded distributions
+	if(!_summaryOnly) {
+		LOGS<<"Keeping only the quantiles of the fragment size and read length distributions"<<std::endl;
+		_summaryOnly = true;
+		m_fragHist.clear();
+		m_lengthHist.clear();
+		return true;
+	}
+
+	// then only hold coverage buffers as long as the current region
+	return _coverageBufferPool.trim();
+}
+
+void HistogramStatsCollector::saveStateImpl(json_t * stateObj) {
+	json_t * j_mapq = json_array();
+	for(size_t i=0; i<256; i++) json_array_append_new(j_mapq, json_integer(m_mappingQualHist[i]));
+	json_object_set_new(stateObj, "mapq", j_mapq);
+
+	json_t * j_baseq = json_array();
+	for(size_t i=0; i<=50; i++) json_array_append_new(j_baseq, json_integer(m_baseQualHist[i]));
+	json_object_set_new(stateObj, "baseq", j_baseq);
+
+	json_object_set_new(stateObj, "frag", histogramToJson(m_fragHist));
+	json_object_set_new(stateObj, "length", histogramToJson(m_lengthHist));
+	json_object_set_new(stateObj, "frag_sketch", m_fragSketch.saveState());
+	json_object_set_new(stateObj, "length_sketch", m_lengthSketch.saveState());
+	json_object_set_new(stateObj, "ref_aln", histogramToJson(m_refAlnHist));
+	json_object_set_new(stateObj, "cov", m_covHist.saveState());
+	json_object_set_new(stateObj, "cov_accumu", json_integer(m_covHistAccumu));
+	// set by shedding as well, after which the histograms are incomplete
+	json_object_set_new(stateObj, "summary_only", json_boolean(_summaryOnly));
+}
+
+void HistogramStatsCollector::loadStateImpl(const json_t * stateObj) {
+	const json_t * j_mapq = json_object_get(stateObj, "mapq");
+	for(size_t i=0; i<256; i++) m_mappingQualHist[i] = json_integer_value(json_array_get(j_mapq, i));
+
+	const json_t * j_baseq = json_object_get(stateObj, "baseq");
+	for(size_t i=0; i<=50; i++) m_baseQualHist[i] = json_integer_value(json_array_get(j_baseq, i));
+
+	histogramFromJson(m_fragHist, json_object_get(stateObj, "frag"));
+	histogramFromJson(m_lengthHist, json_object_get(stateObj, "length"));
+	m_fragSketch.loadState(json_object_get(stateObj, "frag_sketch"));
+	m_lengthSketch.loadState(json_object_get(stateObj, "length_sketch"));
+	histogramFromJson(m_refAlnHist, json_object_get(stateObj, "ref_aln"));
+	m_covHist.loadState(json_object_get(stateObj, "cov"));
+	m_covHistAccumu = json_integer_value(json_object_get(stateObj, "cov_accumu"));
+	if(json_is_true(json_object_get(stateObj, "summary_only"))) _summaryOnly = true;
+
+	// state is only saved between regions
+	if(_coverageCollector) delete _coverageCollector;
+	_coverageCollector = nullptr;
+	_currentRegion = nullptr;
 }
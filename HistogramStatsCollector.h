@@ -6,6 +6,9 @@
 #include "AbstractStatCollector.h"
 #include "GenomicRegionStore.h"
 #include "CoverageMapStatsCollector.h"
+#include "CoverageBufferPool.h"
+#include "QuantileSketch.h"
+#include "StandardDeviationChangeMonitor.h"
 
 namespace BamstatsAlive {
 
@@ -17,19 +20,43 @@ namespace BamstatsAlive {
 			std::map<int32_t, unsigned int> m_fragHist;
 			std::map<int32_t, unsigned int> m_lengthHist;
 			std::map<std::string, unsigned int> m_refAlnHist;
-			CoverageMapStatsCollector::coverageHistT m_covHist;
-			unsigned int m_covHistTotalPos;
+			QuantileSketch m_fragSketch;
+			QuantileSketch m_lengthSketch;
+			CoverageHistogram m_covHist;
 			unsigned int m_covHistAccumu;
 			const unsigned int kCovHistSkipFactor;
 
+			virtual const char * collectorName() const { return "histogram"; }
 			virtual void processAlignmentImpl(const BamTools::BamAlignment& al, const BamTools::RefVector& refVector);
 			virtual void appendJsonImpl(json_t * jsonRootObj);
+			virtual void mergeImpl(const AbstractStatCollector& other);
+			virtual void saveStateImpl(json_t * stateObj);
+			virtual void loadStateImpl(const json_t * stateObj);
+			virtual size_t memoryUsageImpl() const;
+			virtual bool shedMemoryImpl();
+			virtual unsigned int requiredFieldsImpl() const;
 
 		private:
 			// Functions to deal with intermitted base coverage calculation
 			const GenomicRegionStore::GenomicRegionT *_currentRegion;
-			GenomicRegionStore *_regionStore;
+			const GenomicRegionStore *_regionStore;
 			CoverageMapStatsCollector * _coverageCollector;
+			CoverageBufferPool _coverageBufferPool;
+			bool _inputInRegions;
+			bool _summaryOnly;
+			unsigned int _selection;
+			bool _nameSorted;
+
+			// progressive output: the current resolution, how long it has
+			// been reported, and the drift of the distributions' medians
+			bool _progressive;
+			size_t _resolution;
+			unsigned int _framesAtResolution;
+			uint64_t _progressiveReads;
+			StandardDeviationChangeMonitor<double> _mapqMonitor;
+			StandardDeviationChangeMonitor<double> _fragMonitor;
+			StandardDeviationChangeMonitor<double> _lengthMonitor;
+			StandardDeviationChangeMonitor<double> _coverageMonitor;
 
 			std::map<int32_t, std::string>& _chromIDNameMap;
 
@@ -44,8 +71,70 @@ namespace BamstatsAlive {
 			HistogramStatsCollector(
 					std::map<int32_t, std::string>& chromIDNameMap,
 					unsigned int skipFactor = 0, 
-					GenomicRegionStore* regionStore = NULL);
+					const GenomicRegionStore* regionStore = NULL);
 			virtual ~HistogramStatsCollector();
+
+			/**
+			 * Check whether the read stream is currently outside of every
+			 * region, i.e. no partial coverage is pending and the state can
+			 * be saved without loss.
+			 */
+			inline bool isBetweenRegions() const { return _coverageCollector == nullptr && _currentRegion == nullptr; }
+
+			/**
+			 * Declare that only reads inside of regions are passed in, so
+			 * that base qualities are counted for every read even though the
+			 * collector has no region store of its own
+			 */
+			inline void setInputInRegions(bool inputInRegions) { _inputInRegions = inputInRegions; }
+
+			/**
+			 * Report the fragment size and read length distributions by
+			 * their quantiles only, leaving out the full histograms, which
+			 * are then not kept either
+			 */
+			inline void setSummaryOnly(bool summaryOnly) { _summaryOnly = summaryOnly; }
+
+			/**
+			 * Count depths up to cap exactly in the coverage histogram, and
+			 * deeper ones in log bins; drops the coverage counted so far
+			 */
+			inline void setCoverageCap(unsigned int cap) { m_covHist.setExactDepths(cap); }
+
+			/**
+			 * Keep and report only the selected histograms
+			 *
+			 * @param collectors CollectorRegistry::CollectorT bits, the others are ignored
+			 */
+			inline void setSelection(unsigned int collectors) { _selection = collectors; }
+
+			/**
+			 * Declare the input sorted by name, or not sorted: regions are not
+			 * looked up, base qualities are counted for every read, and
+			 * fragment sizes only come in through addFragmentSize()
+			 */
+			inline void setNameSorted(bool nameSorted) { _nameSorted = nameSorted; }
+
+			/**
+			 * Report the mapping quality, fragment size, read length and
+			 * coverage histograms in coarse bins at first, refining them as
+			 * reads come in and the distributions settle, rather than always
+			 * at full resolution
+			 */
+			void setProgressive(bool progressive);
+
+			/**
+			 * Move on to the next resolution once the distributions have
+			 * settled over the last frames, or enough reads have come in;
+			 * called once for every frame written, so that the resolution
+			 * does not depend on how often the json is built
+			 */
+			void advanceResolution();
+
+			/**
+			 * Count the fragment size of a pair
+			 */
+			void addFragmentSize(int32_t frag);
 	};
 }
 
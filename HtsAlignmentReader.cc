@@ -0,0 +1,210 @@
+#ifdef HAVE_HTSLIB
+
+#include "HtsAlignmentReader.h"
+
+#include <htslib/hts.h>
+#include <htslib/thread_pool.h>
+
+using namespace BamstatsAlive;
+
+// one decoding pool for all readers, so concurrent jobs share the threads
+static htsThreadPool sharedPool = { NULL, 0 };
+
+bool HtsAlignmentReader::createThreadPool(unsigned int threads) {
+	if(sharedPool.pool != NULL || threads == 0) return sharedPool.pool != NULL;
+
+	sharedPool.pool = hts_tpool_init(threads);
+	return sharedPool.pool != NULL;
+}
+
+void HtsAlignmentReader::destroyThreadPool() {
+	if(sharedPool.pool == NULL) return;
+
+	hts_tpool_destroy(sharedPool.pool);
+	sharedPool.pool = NULL;
+}
+
+static void setupReferenceCache() {
+	if(getenv("REF_CACHE") != NULL || getenv("HOME") == NULL) return;
+
+	std::string cache = std::string(getenv("HOME")) + "/.cache/bamstatsAlive/ref/%2s/%2s/%s";
+	setenv("REF_CACHE", cache.c_str(), 0);
+}
+
+HtsAlignmentReader::HtsAlignmentReader() :
+	_fields(0), _file(NULL), _header(NULL), _index(NULL),
+	_iterator(NULL), _iteratorTid(0), _record(NULL)
+{
+}
+
+HtsAlignmentReader::~HtsAlignmentReader() {
+	if(_record) bam_destroy1(_record);
+	if(_iterator) hts_itr_destroy(_iterator);
+	if(_index) hts_idx_destroy(_index);
+	if(_header) sam_hdr_destroy(_header);
+	if(_file) sam_close(_file);
+}
+
+bool HtsAlignmentReader::open(const std::string& filename, const AlignmentReaderOptionsT& options) {
+	_filename = filename;
+	_fields = options.fields;
+
+	setupReferenceCache();
+
+	_file = sam_open(filename.c_str(), "r");
+	if(_file == NULL) return false;
+
+	if(!options.reference.empty())
+		hts_set_opt(_file, CRAM_OPT_REFERENCE, options.reference.c_str());
+
+	applyFields();
+
+	if(options.decodeThreads > 0 && sharedPool.pool != NULL)
+		hts_set_opt(_file, HTS_OPT_THREAD_POOL, &sharedPool);
+
+	_header = sam_hdr_read(_file);
+	if(_header == NULL) return false;
+
+	for(int i=0; i<sam_hdr_nref(_header); i++) {
+		_refVector.push_back(BamTools::RefData(sam_hdr_tid2name(_header, i), sam_hdr_tid2len(_header, i)));
+	}
+
+	_record = bam_init1();
+	return _record != NULL;
+}
+
+void HtsAlignmentReader::applyFields() {
+	// only reconstruct what the collectors look at
+	int requiredFields = SAM_FLAG | SAM_RNAME | SAM_POS | SAM_MAPQ | SAM_CIGAR | SAM_RNEXT | SAM_PNEXT | SAM_TLEN;
+	if(_fields & kFieldName) requiredFields |= SAM_QNAME;
+	if(_fields & kFieldBases) requiredFields |= SAM_SEQ;
+	if(_fields & kFieldQualities) requiredFields |= SAM_QUAL;
+	if(_fields & kFieldTags) requiredFields |= SAM_AUX | SAM_RGAUX;
+	hts_set_opt(_file, CRAM_OPT_REQUIRED_FIELDS, requiredFields);
+
+	if(!(_fields & kFieldTags))
+		hts_set_opt(_file, CRAM_OPT_DECODE_MD, 0);
+}
+
+void HtsAlignmentReader::setFields(unsigned int fields) {
+	_fields = fields;
+	applyFields();
+}
+
+int HtsAlignmentReader::readRecord() {
+	if(_iterator == NULL) return sam_read1(_file, _header, _record);
+
+	while(true) {
+		int ret = sam_itr_next(_file, _iterator, _record);
+		if(ret != -1) return ret;
+
+		// this reference is exhausted, carry on with the next one and
+		// finally with the reads without coordinates
+		if(_iteratorTid == HTS_IDX_NOCOOR) return -1;
+
+		_iteratorTid++;
+		if(_iteratorTid >= sam_hdr_nref(_header)) _iteratorTid = HTS_IDX_NOCOOR;
+
+		hts_itr_destroy(_iterator);
+		_iterator = sam_itr_queryi(_index, _iteratorTid, 0, HTS_POS_MAX);
+		if(_iterator == NULL) return -1;
+	}
+}
+
+void HtsAlignmentReader::fillCoreData(BamTools::BamAlignment& al) {
+	const bam1_core_t& core = _record->core;
+	const uint32_t * cigar = bam_get_cigar(_record);
+
+	al.RefID = core.tid;
+	al.Position = core.pos;
+	al.Bin = core.bin;
+	al.MapQuality = core.qual;
+	al.AlignmentFlag = core.flag;
+	al.MateRefID = core.mtid;
+	al.MatePosition = core.mpos;
+	al.InsertSize = core.isize;
+
+	al.CigarData.clear();
+	for(uint32_t i=0; i<core.n_cigar; i++) {
+		al.CigarData.push_back(BamTools::CigarOp(BAM_CIGAR_STR[bam_cigar_op(cigar[i])], bam_cigar_oplen(cigar[i])));
+	}
+
+	// the sequence length is not known when CRAM skipped the bases
+	al.Length = core.l_qseq > 0 ? core.l_qseq : bam_cigar2qlen(core.n_cigar, cigar);
+
+	al.Name.clear();
+	al.QueryBases.clear();
+	al.AlignedBases.clear();
+	al.Qualities.clear();
+	al.TagData.clear();
+}
+
+void HtsAlignmentReader::fillCharData(BamTools::BamAlignment& al) {
+	const bam1_core_t& core = _record->core;
+
+	if(_fields & kFieldName)
+		al.Name = bam_get_qname(_record);
+
+	if((_fields & kFieldBases) && core.l_qseq > 0) {
+		const uint8_t * seq = bam_get_seq(_record);
+		al.QueryBases.resize(core.l_qseq);
+		for(int i=0; i<core.l_qseq; i++) al.QueryBases[i] = seq_nt16_str[bam_seqi(seq, i)];
+	}
+
+	if((_fields & kFieldQualities) && core.l_qseq > 0) {
+		const uint8_t * qual = bam_get_qual(_record);
+		if(qual[0] == 0xff) {
+			al.Qualities.assign(core.l_qseq, static_cast<char>(0xff));
+		}
+		else {
+			al.Qualities.resize(core.l_qseq);
+			for(int i=0; i<core.l_qseq; i++) al.Qualities[i] = static_cast<char>(qual[i] + 33);
+		}
+	}
+
+	if(_fields & kFieldTags)
+		al.TagData.assign(reinterpret_cast<const char *>(bam_get_aux(_record)), bam_get_l_aux(_record));
+}
+
+bool HtsAlignmentReader::getNextAlignment(BamTools::BamAlignment& al) {
+	if(readRecord() < 0) return false;
+	fillCoreData(al);
+	fillCharData(al);
+	return true;
+}
+
+bool HtsAlignmentReader::getNextAlignmentCore(BamTools::BamAlignment& al) {
+	if(readRecord() < 0) return false;
+	fillCoreData(al);
+	return true;
+}
+
+void HtsAlignmentReader::buildCharData(BamTools::BamAlignment& al) {
+	fillCharData(al);
+}
+
+const BamTools::RefVector& HtsAlignmentReader::referenceData() const {
+	return _refVector;
+}
+
+std::string HtsAlignmentReader::headerText() const {
+	return std::string(sam_hdr_str(_header), sam_hdr_length(_header));
+}
+
+bool HtsAlignmentReader::jump(int32_t refID, int32_t position) {
+	if(_index == NULL) _index = sam_index_load(_file, _filename.c_str());
+	if(_index == NULL) return false;
+
+	if(_iterator) hts_itr_destroy(_iterator);
+	_iteratorTid = refID;
+	_iterator = sam_itr_queryi(_index, refID, position, HTS_POS_MAX);
+
+	return _iterator != NULL;
+}
+
+bool HtsAlignmentReader::seek(int32_t refID, int32_t position) {
+	// the iterators of jump() already carry on to the reads without coordinates
+	return jump(refID, position);
+}
+
+#endif
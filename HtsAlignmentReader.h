@@ -0,0 +1,76 @@
+#ifndef HTSALIGNMENTREADER_H
+#define HTSALIGNMENTREADER_H
+
+#pragma once
+
+#ifdef HAVE_HTSLIB
+
+#include "AlignmentReader.h"
+
+#include <htslib/sam.h>
+
+namespace BamstatsAlive {
+
+	/**
+	 * Reads CRAM (or any htslib supported) input through htslib
+	 *
+	 * Only the fields requested in the options are decoded; for CRAM the
+	 * required fields are passed down to the decoder, so sequence and
+	 * quality reconstruction is skipped entirely when no collector needs
+	 * them. Slices are decoded by a thread pool shared by every reader of
+	 * the process, started once by createThreadPool(). References are
+	 * looked up through REF_PATH, and cached locally under REF_CACHE,
+	 * which defaults to ~/.cache/bamstatsAlive/ref when unset.
+	 */
+	class HtsAlignmentReader : public AlignmentReader {
+		private:
+			std::string _filename;
+			unsigned int _fields;
+			samFile * _file;
+			sam_hdr_t * _header;
+			hts_idx_t * _index;
+			hts_itr_t * _iterator;
+			int _iteratorTid;
+			bam1_t * _record;
+			BamTools::RefVector _refVector;
+
+			int readRecord();
+			void applyFields();
+			void fillCoreData(BamTools::BamAlignment& al);
+			void fillCharData(BamTools::BamAlignment& al);
+
+		public:
+			HtsAlignmentReader();
+			virtual ~HtsAlignmentReader();
+
+			/**
+			 * Start the pool decoding the slices of every reader, before
+			 * any reader is opened; later calls keep the first pool
+			 *
+			 * @return Whether there is a pool
+			 */
+			static bool createThreadPool(unsigned int threads);
+
+			/**
+			 * Stop the pool, once every reader has been closed
+			 */
+			static void destroyThreadPool();
+
+			bool open(const std::string& filename, const AlignmentReaderOptionsT& options);
+
+			virtual bool getNextAlignment(BamTools::BamAlignment& al);
+			virtual bool getNextAlignmentCore(BamTools::BamAlignment& al);
+			virtual void buildCharData(BamTools::BamAlignment& al);
+			virtual void setFields(unsigned int fields);
+
+			virtual const BamTools::RefVector& referenceData() const;
+			virtual std::string headerText() const;
+
+			virtual bool jump(int32_t refID, int32_t position);
+			virtual bool seek(int32_t refID, int32_t position);
+	};
+}
+
+#endif
+
+#endif
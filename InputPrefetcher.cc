@@ -0,0 +1,187 @@
+#include "InputPrefetcher.h"
+
+#include <chrono>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+
+using namespace BamstatsAlive;
+
+// the ring must hold more than the largest BGZF block
+static const size_t kMinCapacity = 1 << 20;
+
+// pipe buffer asked for, so the decoder finds more than a block waiting
+static const int kPipeSize = 1 << 20;
+
+// how often a reader blocked on an idle input checks whether to stop
+static const int kStopCheckMs = 100;
+
+// gzip header with the FEXTRA flag, whose first subfield is BGZF's BC
+static const size_t kBgzfHeaderSize = 18;
+
+InputPrefetcher::InputPrefetcher(size_t capacity) :
+	_sourceFd(-1),
+	_pipeWriteFd(-1),
+	_ring(std::max(capacity, kMinCapacity)),
+	_filled(0),
+	_released(0),
+	_drained(0),
+	_nextBlock(0),
+	_blockAligned(true),
+	_sourceDone(false),
+	_stopping(false),
+	_stallNs(0),
+	_blocks(0)
+{
+}
+
+InputPrefetcher::~InputPrefetcher() {
+	if(_sourceFd < 0) return;
+
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_spaceAvailable.notify_all();
+	_dataAvailable.notify_all();
+
+	// giving stdin back closes the pipe's read end, so a writer blocked on
+	// a decoder that stopped reading gets an error
+	dup2(_sourceFd, STDIN_FILENO);
+
+	_readerThread.join();
+	_writerThread.join();
+	close(_sourceFd);
+}
+
+bool InputPrefetcher::start() {
+	int fds[2];
+	if(pipe(fds) != 0) return false;
+
+#ifdef F_SETPIPE_SZ
+	fcntl(fds[1], F_SETPIPE_SZ, kPipeSize);
+#endif
+
+	_sourceFd = dup(STDIN_FILENO);
+	if(_sourceFd < 0 || dup2(fds[0], STDIN_FILENO) < 0) {
+		if(_sourceFd >= 0) close(_sourceFd);
+		_sourceFd = -1;
+		close(fds[0]);
+		close(fds[1]);
+		return false;
+	}
+	close(fds[0]);
+	_pipeWriteFd = fds[1];
+
+	_readerThread = std::thread(&InputPrefetcher::readerLoop, this);
+	_writerThread = std::thread(&InputPrefetcher::writerLoop, this);
+	return true;
+}
+
+void InputPrefetcher::releaseBlocks() {
+	if(!_blockAligned) {
+		_released = _filled;
+		return;
+	}
+
+	while(_nextBlock + kBgzfHeaderSize <= _filled) {
+		bool isBgzf = ringByte(_nextBlock) == 0x1f && ringByte(_nextBlock + 1) == 0x8b
+			&& ringByte(_nextBlock + 2) == 8 && (ringByte(_nextBlock + 3) & 4)
+			&& ringByte(_nextBlock + 12) == 'B' && ringByte(_nextBlock + 13) == 'C';
+
+		if(!isBgzf) {
+			// pass anything else on as it comes
+			_blockAligned = false;
+			_released = _filled;
+			return;
+		}
+
+		uint64_t blockSize = (ringByte(_nextBlock + 16) | (ringByte(_nextBlock + 17) << 8)) + 1;
+		if(_nextBlock + blockSize > _filled) break;
+
+		_nextBlock += blockSize;
+		_released = _nextBlock;
+		_blocks++;
+	}
+}
+
+void InputPrefetcher::readerLoop() {
+	while(true) {
+		size_t offset, space;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_spaceAvailable.wait(lock, [this]{ return _stopping || _filled - _drained < _ring.size(); });
+			if(_stopping) return;
+
+			offset = _filled % _ring.size();
+			space = std::min(_ring.size() - (_filled - _drained), _ring.size() - offset);
+		}
+
+		// the writer never looks past the released offset, so the free
+		// part of the ring is filled without the lock
+		struct pollfd pfd = { _sourceFd, POLLIN, 0 };
+		int ready;
+		while((ready = poll(&pfd, 1, kStopCheckMs)) == 0 || (ready < 0 && errno == EINTR)) {
+			if(_stopping) return;
+		}
+
+		ssize_t n = ready < 0 ? -1 : read(_sourceFd, &_ring[offset], space);
+		if(n < 0 && errno == EINTR) continue;
+
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			if(n <= 0) {
+				// a truncated last block is passed on for the decoder to report
+				_sourceDone = true;
+				_released = _filled;
+			}
+			else {
+				_filled += n;
+				releaseBlocks();
+			}
+		}
+		_dataAvailable.notify_one();
+
+		if(n <= 0) return;
+	}
+}
+
+void InputPrefetcher::writerLoop() {
+	// a decoder that went away makes writes fail rather than kill the process
+	sigset_t sigpipe;
+	sigemptyset(&sigpipe);
+	sigaddset(&sigpipe, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &sigpipe, NULL);
+
+	while(true) {
+		uint64_t from, to;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			if(_released == _drained && !_sourceDone && !_stopping) {
+				auto waitStart = std::chrono::steady_clock::now();
+				_dataAvailable.wait(lock, [this]{ return _stopping || _sourceDone || _released > _drained; });
+				_stallNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - waitStart).count();
+			}
+			if(_stopping || _released == _drained) break;
+
+			from = _drained;
+			to = std::min(_released, from + (_ring.size() - from % _ring.size()));
+		}
+
+		ssize_t n = write(_pipeWriteFd, &_ring[from % _ring.size()], to - from);
+		if(n < 0 && errno == EINTR) continue;
+		if(n < 0) break;
+
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_drained += n;
+		}
+		_spaceAvailable.notify_one();
+	}
+
+	// the end of the pipe is the end of the input for the decoder
+	close(_pipeWriteFd);
+	_pipeWriteFd = -1;
+}
@@ -0,0 +1,96 @@
+#ifndef INPUTPREFETCHER_H
+#define INPUTPREFETCHER_H
+
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+#include <stdint.h>
+
+namespace BamstatsAlive {
+
+	/**
+	 * Reads stdin ahead of the decoder, on threads of its own
+	 *
+	 * A reader thread pulls the input into a large ring buffer as fast as
+	 * it comes, so the upstream process is not held up while reads are
+	 * being processed, and a writer thread feeds the buffered input to the
+	 * decoder through a pipe put in place of stdin. The input is only
+	 * passed on in whole BGZF blocks, so the decoder never waits for the
+	 * rest of a block it has started; input that is not BGZF is passed on
+	 * as it comes.
+	 *
+	 * The time the writer has nothing to pass on is accounted as input
+	 * stall, which tells whether a job is bound by its input or by its
+	 * own work.
+	 */
+	class InputPrefetcher {
+		private:
+			// the original stdin, read by the reader thread
+			int _sourceFd;
+			int _pipeWriteFd;
+
+			std::vector<char> _ring;
+
+			// absolute stream offsets: read from the source, released to
+			// the writer (whole blocks) and written to the pipe
+			uint64_t _filled;
+			uint64_t _released;
+			uint64_t _drained;
+			uint64_t _nextBlock;
+			bool _blockAligned;
+			bool _sourceDone;
+			std::atomic<bool> _stopping;
+
+			std::mutex _mutex;
+			std::condition_variable _spaceAvailable;
+			std::condition_variable _dataAvailable;
+
+			std::thread _readerThread;
+			std::thread _writerThread;
+
+			std::atomic<uint64_t> _stallNs;
+			std::atomic<uint64_t> _blocks;
+
+			void readerLoop();
+			void writerLoop();
+
+			/**
+			 * Advance the released offset over the complete BGZF blocks
+			 * read so far, with the mutex held
+			 */
+			void releaseBlocks();
+
+			inline uint8_t ringByte(uint64_t offset) const { return _ring[offset % _ring.size()]; }
+
+		public:
+			/**
+			 * @param capacity Bytes of input buffered ahead of the decoder
+			 */
+			InputPrefetcher(size_t capacity);
+
+			/**
+			 * Stop prefetching and give stdin back
+			 */
+			~InputPrefetcher();
+
+			/**
+			 * Put the pipe in place of stdin and start reading ahead
+			 *
+			 * @return false if stdin could not be replaced, in which case it
+			 *         is left as it was
+			 */
+			bool start();
+
+			/** Nanoseconds there was no input to pass on so far */
+			inline uint64_t stallNs() const { return _stallNs.load(std::memory_order_relaxed); }
+
+			/** Complete BGZF blocks passed on so far */
+			inline uint64_t blocks() const { return _blocks.load(std::memory_order_relaxed); }
+	};
+}
+
+#endif
@@ -0,0 +1,157 @@
+#include "MatePairingStatsCollector.h"
+#include "TargetCoverageStatsCollector.h"
+
+using namespace BamstatsAlive;
+using namespace std;
+
+static const uint32_t kFlagSupplementary = 0x800;
+
+static uint64_t nameHash(const std::string& name) {
+	// FNV-1a
+	uint64_t h = 14695981039346656037ULL;
+	for(size_t i=0; i<name.length(); i++) {
+		h ^= static_cast<unsigned char>(name[i]);
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+MatePairingStatsCollector::MatePairingStatsCollector() :
+	AbstractStatCollector(),
+	_active(false),
+	_fragmentSink(NULL),
+	_pairs(0),
+	_bothMapped(0),
+	_oneMapped(0),
+	_crossReference(0),
+	_unpaired(0)
+{
+}
+
+unsigned int MatePairingStatsCollector::requiredFieldsImpl() const {
+	return _active ? kFieldName : 0;
+}
+
+void MatePairingStatsCollector::processAlignmentImpl(const BamTools::BamAlignment& al, const BamTools::RefVector& refVector) {
+	if(!_active) return;
+	if(!al.IsPaired() || !al.IsPrimaryAlignment() || (al.AlignmentFlag & kFlagSupplementary)) return;
+
+	PendingMateT mate;
+	mate.nameHash = nameHash(al.Name);
+	mate.refID = al.RefID;
+	mate.startPos = al.Position;
+	mate.endPos = al.IsMapped() ? TargetCoverageStatsCollector::referenceEnd(al) : al.Position;
+	mate.isMapped = al.IsMapped();
+
+	// the mate is almost always the read right before
+	for(auto it = _pending.rbegin(); it != _pending.rend(); it++) {
+		if(it->nameHash != mate.nameHash) continue;
+
+		pairMates(*it, mate);
+		_pending.erase(next(it).base());
+		return;
+	}
+
+	if(_pending.size() == kPairingWindow) {
+		_pending.pop_front();
+		_unpaired++;
+	}
+	_pending.push_back(mate);
+}
+
+void MatePairingStatsCollector::pairMates(const PendingMateT& first, const PendingMateT& second) {
+	_pairs++;
+
+	if(first.isMapped != second.isMapped) {
+		_oneMapped++;
+		return;
+	}
+	if(!first.isMapped) return;
+
+	_bothMapped++;
+	if(first.refID != second.refID) {
+		_crossReference++;
+		return;
+	}
+
+	// from the leftmost to the rightmost aligned base of the two mates
+	int32_t fragment = max(first.endPos, second.endPos) - min(first.startPos, second.startPos) + 1;
+	if(_fragmentSink) _fragmentSink->addFragmentSize(fragment);
+}
+
+void MatePairingStatsCollector::appendJsonImpl(json_t * jsonRootObj) {
+	if(!_active && _pairs == 0) return;
+
+	json_t * j_pairing = json_object();
+	json_object_set_new(j_pairing, "pairs", json_integer(_pairs));
+	json_object_set_new(j_pairing, "both_mapped", json_integer(_bothMapped));
+	json_object_set_new(j_pairing, "one_mapped", json_integer(_oneMapped));
+	json_object_set_new(j_pairing, "neither_mapped", json_integer(_pairs - _bothMapped - _oneMapped));
+	json_object_set_new(j_pairing, "cross_reference", json_integer(_crossReference));
+	// reads still waiting for their mate have none so far
+	json_object_set_new(j_pairing, "unpaired_reads", json_integer(_unpaired + _pending.size()));
+	json_object_set_new(jsonRootObj, "pairing", j_pairing);
+}
+
+void MatePairingStatsCollector::mergeImpl(const AbstractStatCollector& other) {
+	const MatePairingStatsCollector& otherPairing = dynamic_cast<const MatePairingStatsCollector&>(other);
+
+	_pairs += otherPairing._pairs;
+	_bothMapped += otherPairing._bothMapped;
+	_oneMapped += otherPairing._oneMapped;
+	_crossReference += otherPairing._crossReference;
+
+	// mates of another input never show up here
+	_unpaired += otherPairing._unpaired + otherPairing._pending.size();
+}
+
+size_t MatePairingStatsCollector::memoryUsageImpl() const {
+	return _pending.size() * sizeof(PendingMateT);
+}
+
+void MatePairingStatsCollector::saveStateImpl(json_t * stateObj) {
+	json_object_set_new(stateObj, "pairs", json_integer(_pairs));
+	json_object_set_new(stateObj, "both_mapped", json_integer(_bothMapped));
+	json_object_set_new(stateObj, "one_mapped", json_integer(_oneMapped));
+	json_object_set_new(stateObj, "cross_reference", json_integer(_crossReference));
+	json_object_set_new(stateObj, "unpaired", json_integer(_unpaired));
+
+	json_t * j_pending = json_array();
+	for(auto it = _pending.begin(); it != _pending.end(); it++) {
+		// the hash does not fit a json integer
+		stringstream hashSS; hashSS << it->nameHash;
+
+		json_t * j_mate = json_array();
+		json_array_append_new(j_mate, json_string(hashSS.str().c_str()));
+		json_array_append_new(j_mate, json_integer(it->refID));
+		json_array_append_new(j_mate, json_integer(it->startPos));
+		json_array_append_new(j_mate, json_integer(it->endPos));
+		json_array_append_new(j_mate, json_boolean(it->isMapped));
+		json_array_append_new(j_pending, j_mate);
+	}
+	json_object_set_new(stateObj, "pending", j_pending);
+}
+
+void MatePairingStatsCollector::loadStateImpl(const json_t * stateObj) {
+	_pairs = json_integer_value(json_object_get(stateObj, "pairs"));
+	_bothMapped = json_integer_value(json_object_get(stateObj, "both_mapped"));
+	_oneMapped = json_integer_value(json_object_get(stateObj, "one_mapped"));
+	_crossReference = json_integer_value(json_object_get(stateObj, "cross_reference"));
+	_unpaired = json_integer_value(json_object_get(stateObj, "unpaired"));
+
+	_pending.clear();
+	const json_t * j_pending = json_object_get(stateObj, "pending");
+	for(size_t i=0; i<json_array_size(j_pending); i++) {
+		const json_t * j_mate = json_array_get(j_pending, i);
+		const char * hash = json_string_value(json_array_get(j_mate, 0));
+
+		PendingMateT mate;
+		mate.nameHash = 0;
+		if(hash) stringstream(hash) >> mate.nameHash;
+		mate.refID = json_integer_value(json_array_get(j_mate, 1));
+		mate.startPos = json_integer_value(json_array_get(j_mate, 2));
+		mate.endPos = json_integer_value(json_array_get(j_mate, 3));
+		mate.isMapped = json_is_true(json_array_get(j_mate, 4));
+		_pending.push_back(mate);
+	}
+}
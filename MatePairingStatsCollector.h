@@ -0,0 +1,82 @@
+#ifndef MATEPAIRINGSTATSCOLLECTOR_H
+#define MATEPAIRINGSTATSCOLLECTOR_H
+
+#pragma once
+
+#include "AbstractStatCollector.h"
+#include "HistogramStatsCollector.h"
+
+#include <deque>
+#include <stdint.h>
+
+namespace BamstatsAlive {
+
+	/**
+	 * Pairs the mates of a name sorted or unsorted input
+	 *
+	 * In such inputs the mates of a pair come next to each other, rather
+	 * than anywhere along the genome, so they are paired by name in a small
+	 * window of the latest reads instead of through the mate fields of each
+	 * read. A pair's fragment size is then measured from both mates'
+	 * alignments, and passed to the histogram collector in place of the
+	 * insert size it takes from coordinate sorted input. A read whose mate
+	 * does not show up within the window counts as unpaired.
+	 *
+	 * The collector is part of every tree, so trees of inputs of any order
+	 * can be merged, but only looks at reads once activated.
+	 */
+	class MatePairingStatsCollector : public AbstractStatCollector {
+		public:
+			/** Reads awaiting their mate, beyond which the oldest is given up */
+			static const size_t kPairingWindow = 64;
+
+		protected:
+			virtual const char * collectorName() const { return "pairing"; }
+			virtual void processAlignmentImpl(const BamTools::BamAlignment& al, const BamTools::RefVector& refVector);
+			virtual void appendJsonImpl(json_t * jsonRootObj);
+			virtual void mergeImpl(const AbstractStatCollector& other);
+			virtual void saveStateImpl(json_t * stateObj);
+			virtual void loadStateImpl(const json_t * stateObj);
+			virtual size_t memoryUsageImpl() const;
+			virtual unsigned int requiredFieldsImpl() const;
+
+		private:
+			// names are compared by their hash, a false match among a
+			// window of reads being far less likely than a broken pair
+			typedef struct _pendingMateT {
+				uint64_t nameHash;
+				int32_t refID;
+				int32_t startPos;
+				int32_t endPos;
+				bool isMapped;
+			} PendingMateT;
+
+			bool _active;
+			HistogramStatsCollector * _fragmentSink;
+			std::deque<PendingMateT> _pending;
+
+			uint64_t _pairs;
+			uint64_t _bothMapped;
+			uint64_t _oneMapped;
+			uint64_t _crossReference;
+			uint64_t _unpaired;
+
+			void pairMates(const PendingMateT& first, const PendingMateT& second);
+
+		public:
+			MatePairingStatsCollector();
+
+			/**
+			 * Start pairing the reads passed in, for name sorted or unsorted input
+			 */
+			inline void setActive(bool active) { _active = active; }
+			inline bool isActive() const { return _active; }
+
+			/**
+			 * Report fragment sizes to a histogram collector, or to none
+			 */
+			inline void setFragmentSink(HistogramStatsCollector * fragmentSink) { _fragmentSink = fragmentSink; }
+	};
+}
+
+#endif
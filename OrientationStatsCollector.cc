@@ -0,0 +1,131 @@
+#include "OrientationStatsCollector.h"
+
+#include <cstring>
+
+using namespace BamstatsAlive;
+using namespace std;
+
+static const uint32_t kFlagPaired = 0x1;
+static const uint32_t kFlagUnmapped = 0x4;
+static const uint32_t kFlagMateUnmapped = 0x8;
+static const uint32_t kFlagReverse = 0x10;
+static const uint32_t kFlagSecondary = 0x100;
+static const uint32_t kFlagSupplementary = 0x800;
+
+static const char * const kOrientationNames[] = { "FR", "RF", "FF" };
+
+// by the read's and the mate's reverse strand bits (0x10 and 0x20), the
+// read being the leftmost mate
+static const OrientationStatsCollector::OrientationT kOrientationTable[4] = {
+	OrientationStatsCollector::kOrientationFF,
+	OrientationStatsCollector::kOrientationRF,
+	OrientationStatsCollector::kOrientationFR,
+	OrientationStatsCollector::kOrientationFF
+};
+
+OrientationStatsCollector::OrientationStatsCollector() : AbstractStatCollector() {
+	memset(_orientations, 0, sizeof(_orientations));
+}
+
+void OrientationStatsCollector::resizeReferences(const BamTools::RefVector& refVector) {
+	_refNames.resize(refVector.size());
+	for(size_t i=0; i<refVector.size(); i++) _refNames[i] = refVector[i].RefName;
+
+	_forwardReads.resize(refVector.size(), 0);
+	_reverseReads.resize(refVector.size(), 0);
+}
+
+void OrientationStatsCollector::processAlignmentImpl(const BamTools::BamAlignment& al, const BamTools::RefVector& refVector) {
+	uint32_t flag = al.AlignmentFlag;
+	if(flag & (kFlagUnmapped | kFlagSecondary | kFlagSupplementary)) return;
+	if(al.RefID < 0) return;
+
+	if(static_cast<size_t>(al.RefID) >= _forwardReads.size()) resizeReferences(refVector);
+
+	uint64_t reverse = (flag & kFlagReverse) != 0;
+	_reverseReads[al.RefID] += reverse;
+	_forwardReads[al.RefID] += 1 - reverse;
+
+	// both mates placed on the same reference, counted by the leftmost one
+	if((flag & (kFlagPaired | kFlagMateUnmapped)) != kFlagPaired || al.MateRefID != al.RefID) return;
+	if(al.Position > al.MatePosition || (al.Position == al.MatePosition && !al.IsFirstMate())) return;
+
+	_orientations[kOrientationTable[(flag >> 4) & 3]]++;
+}
+
+void OrientationStatsCollector::appendJsonImpl(json_t * jsonRootObj) {
+	json_t * j_orientation = json_object();
+	for(size_t o=0; o<kOrientations; o++) json_object_set_new(j_orientation, kOrientationNames[o], json_integer(_orientations[o]));
+	json_object_set_new(jsonRootObj, "pair_orientation", j_orientation);
+
+	// the forward fraction of each reference's reads
+	json_t * j_strands = json_object();
+	for(size_t i=0; i<_forwardReads.size(); i++) {
+		uint64_t reads = _forwardReads[i] + _reverseReads[i];
+		if(reads == 0) continue;
+
+		json_t * j_reference = json_object();
+		json_object_set_new(j_reference, "forward", json_integer(_forwardReads[i]));
+		json_object_set_new(j_reference, "reverse", json_integer(_reverseReads[i]));
+		json_object_set_new(j_reference, "forward_fraction", json_real(_forwardReads[i] / static_cast<double>(reads)));
+		json_object_set_new(j_strands, _refNames[i].c_str(), j_reference);
+	}
+	json_object_set_new(jsonRootObj, "strand_balance", j_strands);
+}
+
+void OrientationStatsCollector::mergeImpl(const AbstractStatCollector& other) {
+	const OrientationStatsCollector& otherOrientation = dynamic_cast<const OrientationStatsCollector&>(other);
+
+	for(size_t o=0; o<kOrientations; o++) _orientations[o] += otherOrientation._orientations[o];
+
+	// the references of the inputs are paired up by name
+	std::vector<size_t> refIndices = mergeReferenceNames(_refNames, otherOrientation._refNames);
+	_forwardReads.resize(_refNames.size(), 0);
+	_reverseReads.resize(_refNames.size(), 0);
+	for(size_t i=0; i<otherOrientation._forwardReads.size(); i++) {
+		_forwardReads[refIndices[i]] += otherOrientation._forwardReads[i];
+		_reverseReads[refIndices[i]] += otherOrientation._reverseReads[i];
+	}
+}
+
+size_t OrientationStatsCollector::memoryUsageImpl() const {
+	return sizeof(_orientations) + vectorMemoryUsage(_refNames) + vectorMemoryUsage(_forwardReads) + vectorMemoryUsage(_reverseReads);
+}
+
+void OrientationStatsCollector::saveStateImpl(json_t * stateObj) {
+	json_t * j_orientations = json_array();
+	for(size_t o=0; o<kOrientations; o++) json_array_append_new(j_orientations, json_integer(_orientations[o]));
+	json_object_set_new(stateObj, "orientations", j_orientations);
+
+	json_t * j_names = json_array();
+	json_t * j_forward = json_array();
+	json_t * j_reverse = json_array();
+	for(size_t i=0; i<_refNames.size(); i++) {
+		json_array_append_new(j_names, json_string(_refNames[i].c_str()));
+		json_array_append_new(j_forward, json_integer(_forwardReads[i]));
+		json_array_append_new(j_reverse, json_integer(_reverseReads[i]));
+	}
+	json_object_set_new(stateObj, "references", j_names);
+	json_object_set_new(stateObj, "forward", j_forward);
+	json_object_set_new(stateObj, "reverse", j_reverse);
+}
+
+void OrientationStatsCollector::loadStateImpl(const json_t * stateObj) {
+	const json_t * j_orientations = json_object_get(stateObj, "orientations");
+	for(size_t o=0; o<kOrientations; o++) _orientations[o] = json_integer_value(json_array_get(j_orientations, o));
+
+	const json_t * j_names = json_object_get(stateObj, "references");
+	const json_t * j_forward = json_object_get(stateObj, "forward");
+	const json_t * j_reverse = json_object_get(stateObj, "reverse");
+
+	size_t references = json_array_size(j_names);
+	_refNames.assign(references, std::string());
+	_forwardReads.assign(references, 0);
+	_reverseReads.assign(references, 0);
+	for(size_t i=0; i<references; i++) {
+		const char * name = json_string_value(json_array_get(j_names, i));
+		if(name) _refNames[i] = name;
+		_forwardReads[i] = json_integer_value(json_array_get(j_forward, i));
+		_reverseReads[i] = json_integer_value(json_array_get(j_reverse, i));
+	}
+}
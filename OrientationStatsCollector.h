@@ -0,0 +1,61 @@
+#ifndef ORIENTATIONSTATSCOLLECTOR_H
+#define ORIENTATIONSTATSCOLLECTOR_H
+
+#pragma once
+
+#include "AbstractStatCollector.h"
+
+#include <stdint.h>
+
+namespace BamstatsAlive {
+
+	/**
+	 * Pair orientation and per-reference strand balance, which tell a
+	 * failed library preparation from a good one
+	 *
+	 * A pair with both mates on the same reference is counted once, by its
+	 * leftmost mate, as FR (the left mate forward, the right one reverse,
+	 * as expected of paired-end libraries), RF (outward facing, as mate-pair
+	 * libraries) or FF (both on the same strand). The orientation comes
+	 * from a table indexed by the strand bits of the flag, and the strand
+	 * counts live in arrays indexed by reference ID, so a read costs a few
+	 * increments. Trees merge reference by reference, paired up by name.
+	 * Everything comes from the core record.
+	 */
+	class OrientationStatsCollector : public AbstractStatCollector {
+		public:
+			enum OrientationT {
+				kOrientationFR = 0,
+				kOrientationRF,
+				kOrientationFF,
+				kOrientations
+			};
+
+		protected:
+			virtual const char * collectorName() const { return "orientation"; }
+			virtual void processAlignmentImpl(const BamTools::BamAlignment& al, const BamTools::RefVector& refVector);
+			virtual void appendJsonImpl(json_t * jsonRootObj);
+			virtual void mergeImpl(const AbstractStatCollector& other);
+			virtual void saveStateImpl(json_t * stateObj);
+			virtual void loadStateImpl(const json_t * stateObj);
+			virtual size_t memoryUsageImpl() const;
+
+		private:
+			uint64_t _orientations[kOrientations];
+
+			// by reference ID
+			std::vector<std::string> _refNames;
+			std::vector<uint64_t> _forwardReads;
+			std::vector<uint64_t> _reverseReads;
+
+			/**
+			 * Size the per-reference arrays to the references of the input
+			 */
+			void resizeReferences(const BamTools::RefVector& refVector);
+
+		public:
+			OrientationStatsCollector();
+	};
+}
+
+#endif
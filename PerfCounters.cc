@@ -0,0 +1,115 @@
+#include "PerfCounters.h"
+
+#include <mutex>
+#include <new>
+
+using namespace BamstatsAlive;
+
+static thread_local PerfCounters * currentCounters = NULL;
+
+#ifdef BSA_PERF
+// count the heap allocations of the threads working on a job into its
+// counters, so concurrent jobs do not count each other's
+void * operator new(size_t size) {
+	PerfCounters * counters = currentCounters;
+	if(counters != NULL) counters->addAllocation();
+	void * p = malloc(size ? size : 1);
+	if(p == NULL) throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void * p) noexcept {
+	free(p);
+}
+#endif
+
+static std::mutex stageNamesMutex;
+
+static std::vector<std::string>& stageNames() {
+	static std::vector<std::string> names = { "decode", "region_lookup", "coverage", "json_emit" };
+	return names;
+}
+
+PerfCounters::PerfCounters() :
+	_stageNs(kFixedStageCount, 0),
+	_stageCalls(kFixedStageCount, 0),
+	_reads(0), _bytesIn(0), _bytesOut(0),
+	_allocations(0),
+	_hasInputStall(false), _inputStallNs(0), _inputBlocks(0),
+	_start(std::chrono::steady_clock::now())
+{
+}
+
+size_t PerfCounters::registerStage(const std::string& name) {
+	std::lock_guard<std::mutex> lock(stageNamesMutex);
+
+	std::vector<std::string>& names = stageNames();
+	auto loc = std::find(names.begin(), names.end(), name);
+	if(loc != names.end()) return loc - names.begin();
+
+	names.push_back(name);
+	return names.size() - 1;
+}
+
+PerfCounters * PerfCounters::current() {
+	return currentCounters;
+}
+
+void PerfCounters::setCurrent(PerfCounters * counters) {
+	currentCounters = counters;
+}
+
+uint64_t PerfCounters::recordBytes(const BamTools::BamAlignment& al) {
+	// block size, fixed fields, name, cigar, packed bases, qualities and tags
+	return 4 + 32 + al.Name.length() + 1 + 4 * al.CigarData.size()
+		+ (al.Length + 1) / 2 + al.Length + al.TagData.length();
+}
+
+void PerfCounters::merge(const PerfCounters& other) {
+	if(other._stageNs.size() > _stageNs.size()) {
+		_stageNs.resize(other._stageNs.size(), 0);
+		_stageCalls.resize(other._stageCalls.size(), 0);
+	}
+
+	for(size_t i=0; i<other._stageNs.size(); i++) {
+		_stageNs[i] += other._stageNs[i];
+		_stageCalls[i] += other._stageCalls[i];
+	}
+
+	_reads += other._reads;
+	_bytesIn += other._bytesIn;
+	_bytesOut += other._bytesOut;
+	_allocations += other._allocations;
+}
+
+json_t * PerfCounters::toJson() const {
+	double seconds = std::chrono::duration_cast<std::chrono::duration<double> >(std::chrono::steady_clock::now() - _start).count();
+	json_t * j_perf = json_object();
+	json_object_set_new(j_perf, "reads", json_integer(_reads));
+	json_object_set_new(j_perf, "seconds", json_real(seconds));
+	json_object_set_new(j_perf, "reads_per_sec", json_real(seconds > 0 ? _reads / seconds : 0));
+	json_object_set_new(j_perf, "bytes_in", json_integer(_bytesIn));
+	json_object_set_new(j_perf, "bytes_out", json_integer(_bytesOut));
+	json_object_set_new(j_perf, "allocations", json_integer(_allocations));
+	json_object_set_new(j_perf, "allocations_per_read", json_real(_reads > 0 ? _allocations / static_cast<double>(_reads) : 0));
+
+	if(_hasInputStall) {
+		double stallSeconds = _inputStallNs / 1e9;
+		json_object_set_new(j_perf, "input_stall_seconds", json_real(stallSeconds));
+		json_object_set_new(j_perf, "compute_seconds", json_real(std::max(seconds - stallSeconds, 0.0)));
+		json_object_set_new(j_perf, "input_blocks", json_integer(_inputBlocks));
+	}
+
+	json_t * j_stages = json_object();
+	{
+		std::lock_guard<std::mutex> lock(stageNamesMutex);
+		const std::vector<std::string>& names = stageNames();
+		for(size_t i=0; i<_stageNs.size() && i<names.size(); i++) {
+			if(_stageCalls[i] == 0) continue;
+			json_object_set_new(j_stages, names[i].c_str(), json_real(_reads > 0 ? _stageNs[i] / static_cast<double>(_reads) : 0));
+		}
+	}
+	json_object_set_new(j_perf, "ns_per_read", j_stages);
+
+	return j_perf;
+}
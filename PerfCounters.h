@@ -0,0 +1,141 @@
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace BamstatsAlive {
+
+	/**
+	 * Lightweight self-profiling counters
+	 *
+	 * Time spent in the hot stages of a job (read decoding, region lookup,
+	 * coverage updates, json emission and each collector's
+	 * processAlignmentImpl) is accumulated by scoped timers into the
+	 * counters of the job running on the current thread. The timers are
+	 * only compiled in when building with -DBSA_PERF (make perf), otherwise
+	 * BSA_PERF_SCOPE expands to nothing.
+	 *
+	 * Stages may nest, e.g. the histogram collector's time includes the
+	 * region lookup and coverage updates it performs.
+	 */
+	class PerfCounters {
+		public:
+			enum {
+				kStageDecode = 0,
+				kStageRegionLookup,
+				kStageCoverage,
+				kStageJsonEmit,
+				kFixedStageCount
+			};
+
+#ifdef BSA_PERF
+			static const bool kEnabled = true;
+#else
+			static const bool kEnabled = false;
+#endif
+
+		private:
+			std::vector<uint64_t> _stageNs;
+			std::vector<uint64_t> _stageCalls;
+			uint64_t _reads;
+			uint64_t _bytesIn;
+			uint64_t _bytesOut;
+			uint64_t _allocations;
+			bool _hasInputStall;
+			uint64_t _inputStallNs;
+			uint64_t _inputBlocks;
+			std::chrono::steady_clock::time_point _start;
+
+		public:
+			PerfCounters();
+
+			/**
+			 * Register a named stage, such as a collector
+			 *
+			 * @param name The name the stage is reported under
+			 * @return The index of the stage, stable for the whole process
+			 */
+			static size_t registerStage(const std::string& name);
+
+			/** The counters of the job running on the calling thread, or NULL */
+			static PerfCounters * current();
+			static void setCurrent(PerfCounters * counters);
+
+			/**
+			 * Estimate the uncompressed BAM record size of an alignment
+			 */
+			static uint64_t recordBytes(const BamTools::BamAlignment& al);
+
+			inline void addStageTime(size_t stage, uint64_t ns) {
+				if(stage >= _stageNs.size()) {
+					_stageNs.resize(stage + 1, 0);
+					_stageCalls.resize(stage + 1, 0);
+				}
+				_stageNs[stage] += ns;
+				_stageCalls[stage]++;
+			}
+
+			inline void addRead(uint64_t bytes) { _reads++; _bytesIn += bytes; }
+			inline void addBytesOut(uint64_t bytes) { _bytesOut += bytes; }
+			/** Count a heap allocation made while the counters are current */
+			inline void addAllocation() { _allocations++; }
+
+			/**
+			 * Record the time the input had nothing ready so far, when it is
+			 * prefetched; the rest of the run is accounted as compute
+			 */
+			inline void setInputStall(uint64_t ns, uint64_t blocks) {
+				_hasInputStall = true;
+				_inputStallNs = ns;
+				_inputBlocks = blocks;
+			}
+
+			/**
+			 * Add the reads and stage times of counters kept by another
+			 * thread working on the same job
+			 */
+			void merge(const PerfCounters& other);
+
+			/**
+			 * Create the json representation of the counters
+			 *
+			 * @return A new json object with throughput, per stage time per
+			 *         read, bytes in/out and allocations
+			 */
+			json_t * toJson() const;
+	};
+
+	/**
+	 * Adds the lifetime of the scope to a stage of the current counters
+	 */
+	class PerfScope {
+		private:
+			size_t _stage;
+			std::chrono::steady_clock::time_point _start;
+
+		public:
+			PerfScope(size_t stage) : _stage(stage), _start(std::chrono::steady_clock::now()) {}
+
+			~PerfScope() {
+				PerfCounters * counters = PerfCounters::current();
+				if(counters == NULL) return;
+				auto elapsed = std::chrono::steady_clock::now() - _start;
+				counters->addStageTime(_stage, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+			}
+	};
+}
+
+#ifdef BSA_PERF
+#define BSA_PERF_CONCAT_(a, b) a##b
+#define BSA_PERF_CONCAT(a, b) BSA_PERF_CONCAT_(a, b)
+#define BSA_PERF_SCOPE(stage) BamstatsAlive::PerfScope BSA_PERF_CONCAT(_bsaPerfScope, __LINE__)(stage)
+#else
+#define BSA_PERF_SCOPE(stage)
+#endif
+
+#endif
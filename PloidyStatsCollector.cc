@@ -0,0 +1,261 @@
+#include "PloidyStatsCollector.h"
+
+#include <cmath>
+#include <cctype>
+
+using namespace BamstatsAlive;
+using namespace std;
+
+static const uint32_t kFlagUnmapped = 0x4;
+static const uint32_t kFlagSecondary = 0x100;
+static const uint32_t kFlagFailedQC = 0x200;
+static const uint32_t kFlagDuplicate = 0x400;
+static const uint32_t kFlagSupplementary = 0x800;
+
+// Y density over the autosomal one above which Y is called present; a
+// single Y is expected near 0.5 less its large unmappable share, while
+// reads mismapped to Y keep an XX sample well under this
+static const double kMinYRatio = 0.05;
+
+enum ChromosomeT {
+	kChromosomeOther = 0,
+	kChromosomeAutosome,
+	kChromosomeX,
+	kChromosomeY
+};
+
+// by name, with or without a chr prefix
+static ChromosomeT chromosomeOf(const std::string& refName) {
+	size_t start = 0;
+	if(refName.size() > 3 && tolower(refName[0]) == 'c' && tolower(refName[1]) == 'h' && tolower(refName[2]) == 'r') start = 3;
+	if(start == refName.size()) return kChromosomeOther;
+
+	if(refName.size() == start + 1) {
+		if(refName[start] == 'X') return kChromosomeX;
+		if(refName[start] == 'Y') return kChromosomeY;
+	}
+	for(size_t i=start; i<refName.size(); i++) {
+		if(!isdigit(refName[i])) return kChromosomeOther;
+	}
+	return kChromosomeAutosome;
+}
+
+PloidyStatsCollector::PloidyStatsCollector() :
+	AbstractStatCollector(),
+	_hasIndexReads(false),
+	_inputInRegions(false),
+	_complete(false),
+	_unsorted(false),
+	_lastRefID(-1)
+{
+}
+
+void PloidyStatsCollector::resizeReferences(const BamTools::RefVector& refVector) {
+	_refNames.resize(refVector.size());
+	_refLengths.resize(refVector.size());
+	for(size_t i=0; i<refVector.size(); i++) {
+		_refNames[i] = refVector[i].RefName;
+		_refLengths[i] = refVector[i].RefLength;
+	}
+	_reads.resize(refVector.size(), 0);
+}
+
+void PloidyStatsCollector::setIndexStats(const BamIndexStats& indexStats, const BamTools::RefVector& refVector) {
+	if(!indexStats.isLoaded() || indexStats.refCounts().size() != refVector.size()) return;
+	if(_refNames.size() < refVector.size()) resizeReferences(refVector);
+
+	_indexReads.assign(refVector.size(), 0);
+	for(size_t i=0; i<refVector.size(); i++) _indexReads[i] = indexStats.refCounts()[i].mapped;
+	_hasIndexReads = true;
+}
+
+void PloidyStatsCollector::processAlignmentImpl(const BamTools::BamAlignment& al, const BamTools::RefVector& refVector) {
+	if(al.RefID < 0 || (al.AlignmentFlag & kFlagUnmapped)) return;
+
+	// a reference is complete once a sorted input moves past it
+	if(al.RefID < _lastRefID) _unsorted = true;
+	else _lastRefID = al.RefID;
+
+	if(al.AlignmentFlag & (kFlagSecondary | kFlagFailedQC | kFlagDuplicate | kFlagSupplementary)) return;
+	if(al.MapQuality < kMinMappingQuality) return;
+
+	if(static_cast<size_t>(al.RefID) >= _reads.size()) resizeReferences(refVector);
+	_reads[al.RefID]++;
+}
+
+void PloidyStatsCollector::appendJsonImpl(json_t * jsonRootObj) {
+
+	// the reads once they tell the whole genome, else the index, else the
+	// references the reads are done with
+	const std::vector<uint64_t> * counts = &_reads;
+	const char * source = "reads";
+	size_t usableRefs = _reads.size();
+	if(_inputInRegions || (!_complete && !_unsorted)) {
+		if(_hasIndexReads) {
+			counts = &_indexReads;
+			source = "index";
+			usableRefs = _indexReads.size();
+		}
+		else if(_inputInRegions) {
+			source = "none";
+			usableRefs = 0;
+		}
+		else usableRefs = min(usableRefs, static_cast<size_t>(max(_lastRefID, 0)));
+	}
+
+	std::vector<double> densities(usableRefs, 0);
+	std::vector<ChromosomeT> chromosomes(usableRefs, kChromosomeOther);
+	std::vector<double> autosomeDensities;
+	int xRef = -1, yRef = -1;
+
+	json_t * j_densities = json_object();
+	for(size_t i=0; i<usableRefs; i++) {
+		if(_refLengths[i] == 0) continue;
+
+		densities[i] = (*counts)[i] / (_refLengths[i] / 1e6);
+		chromosomes[i] = chromosomeOf(_refNames[i]);
+		if(chromosomes[i] == kChromosomeX) xRef = i;
+		if(chromosomes[i] == kChromosomeY) yRef = i;
+
+		if(_refLengths[i] < kMinReferenceLength) continue;
+		if(chromosomes[i] == kChromosomeAutosome && (*counts)[i] > 0) autosomeDensities.push_back(densities[i]);
+		json_object_set_new(j_densities, _refNames[i].c_str(), json_real(densities[i]));
+	}
+
+	// the median is not moved by a few aneuploid autosomes
+	double autosomeDensity = 0;
+	if(!autosomeDensities.empty()) {
+		size_t middle = autosomeDensities.size() / 2;
+		nth_element(autosomeDensities.begin(), autosomeDensities.begin() + middle, autosomeDensities.end());
+		autosomeDensity = autosomeDensities[middle];
+	}
+
+	json_t * j_ploidy = json_object();
+	json_object_set_new(j_ploidy, "source", json_string(source));
+	json_object_set_new(j_ploidy, "autosomal_density", json_real(autosomeDensity));
+	json_object_set_new(j_ploidy, "density", j_densities);
+
+	std::string sex = "unknown";
+	if(autosomeDensity > 0 && xRef >= 0) {
+		double xCopies = 2 * densities[xRef] / autosomeDensity;
+		json_object_set_new(j_ploidy, "x_copies", json_real(xCopies));
+
+		if(yRef >= 0) {
+			double yRatio = densities[yRef] / autosomeDensity;
+			json_object_set_new(j_ploidy, "y_ratio", json_real(yRatio));
+
+			long xCount = lround(xCopies);
+			if(xCount > 0) sex = std::string(xCount, 'X') + (yRatio >= kMinYRatio ? "Y" : "");
+		}
+	}
+	json_object_set_new(j_ploidy, "sex", json_string(sex.c_str()));
+
+	json_t * j_aneuploid = json_array();
+	for(size_t i=0; i<usableRefs && autosomeDensity > 0; i++) {
+		if(chromosomes[i] != kChromosomeAutosome || _refLengths[i] < kMinReferenceLength || (*counts)[i] < kMinFlagReads) continue;
+
+		double copies = 2 * densities[i] / autosomeDensity;
+		if(lround(copies) == 2) continue;
+
+		json_t * j_flag = json_object();
+		json_object_set_new(j_flag, "chrom", json_string(_refNames[i].c_str()));
+		json_object_set_new(j_flag, "copies", json_real(copies));
+		json_array_append_new(j_aneuploid, j_flag);
+	}
+	json_object_set_new(j_ploidy, "aneuploid", j_aneuploid);
+
+	json_object_set_new(jsonRootObj, "ploidy", j_ploidy);
+}
+
+void PloidyStatsCollector::mergeImpl(const AbstractStatCollector& other) {
+	const PloidyStatsCollector& otherPloidy = dynamic_cast<const PloidyStatsCollector&>(other);
+
+	// the references of the inputs are paired up by name
+	size_t references = _refNames.size();
+	std::vector<size_t> refIndices = mergeReferenceNames(_refNames, otherPloidy._refNames);
+	_refLengths.resize(_refNames.size(), 0);
+	_reads.resize(_refNames.size(), 0);
+	for(size_t i=0; i<otherPloidy._refNames.size(); i++) {
+		if(refIndices[i] >= references) _refLengths[refIndices[i]] = otherPloidy._refLengths[i];
+		_reads[refIndices[i]] += otherPloidy._reads[i];
+	}
+
+	if(otherPloidy._hasIndexReads) {
+		_indexReads.resize(_refNames.size(), 0);
+		for(size_t i=0; i<otherPloidy._indexReads.size() && i<refIndices.size(); i++) _indexReads[refIndices[i]] += otherPloidy._indexReads[i];
+		_hasIndexReads = true;
+	}
+
+	// the leading references both inputs list in the same order
+	int32_t sameOrder = 0;
+	while(static_cast<size_t>(sameOrder) < refIndices.size() && refIndices[sameOrder] == static_cast<size_t>(sameOrder)) sameOrder++;
+
+	if(otherPloidy.holdsNoReads()) return;
+
+	if(holdsNoReads()) {
+		_complete = otherPloidy._complete;
+		_unsorted = otherPloidy._unsorted;
+		_lastRefID = min(otherPloidy._lastRefID, sameOrder);
+		return;
+	}
+
+	// the merged reads tell the whole genome only if those of every input do,
+	// or else the references every input is done with
+	_complete = (_complete || _unsorted) && (otherPloidy._complete || otherPloidy._unsorted);
+	_unsorted = false;
+	_lastRefID = min(min(_lastRefID, otherPloidy._lastRefID), sameOrder);
+}
+
+size_t PloidyStatsCollector::memoryUsageImpl() const {
+	return vectorMemoryUsage(_refNames) + vectorMemoryUsage(_refLengths) + vectorMemoryUsage(_reads) + vectorMemoryUsage(_indexReads);
+}
+
+void PloidyStatsCollector::saveStateImpl(json_t * stateObj) {
+	json_t * j_names = json_array();
+	json_t * j_lengths = json_array();
+	json_t * j_reads = json_array();
+	for(size_t i=0; i<_refNames.size(); i++) {
+		json_array_append_new(j_names, json_string(_refNames[i].c_str()));
+		json_array_append_new(j_lengths, json_integer(_refLengths[i]));
+		json_array_append_new(j_reads, json_integer(_reads[i]));
+	}
+	json_object_set_new(stateObj, "references", j_names);
+	json_object_set_new(stateObj, "lengths", j_lengths);
+	json_object_set_new(stateObj, "reads", j_reads);
+
+	if(_hasIndexReads) {
+		json_t * j_index = json_array();
+		for(size_t i=0; i<_indexReads.size(); i++) json_array_append_new(j_index, json_integer(_indexReads[i]));
+		json_object_set_new(stateObj, "index_reads", j_index);
+	}
+
+	json_object_set_new(stateObj, "complete", json_boolean(_complete));
+	json_object_set_new(stateObj, "unsorted", json_boolean(_unsorted));
+	json_object_set_new(stateObj, "last_ref", json_integer(_lastRefID));
+}
+
+void PloidyStatsCollector::loadStateImpl(const json_t * stateObj) {
+	const json_t * j_names = json_object_get(stateObj, "references");
+	const json_t * j_lengths = json_object_get(stateObj, "lengths");
+	const json_t * j_reads = json_object_get(stateObj, "reads");
+
+	size_t references = json_array_size(j_names);
+	_refNames.assign(references, std::string());
+	_refLengths.assign(references, 0);
+	_reads.assign(references, 0);
+	for(size_t i=0; i<references; i++) {
+		const char * name = json_string_value(json_array_get(j_names, i));
+		if(name) _refNames[i] = name;
+		_refLengths[i] = json_integer_value(json_array_get(j_lengths, i));
+		_reads[i] = json_integer_value(json_array_get(j_reads, i));
+	}
+
+	const json_t * j_index = json_object_get(stateObj, "index_reads");
+	_hasIndexReads = json_is_array(j_index);
+	_indexReads.assign(_hasIndexReads ? json_array_size(j_index) : 0, 0);
+	for(size_t i=0; i<_indexReads.size(); i++) _indexReads[i] = json_integer_value(json_array_get(j_index, i));
+
+	_complete = json_is_true(json_object_get(stateObj, "complete"));
+	_unsorted = json_is_true(json_object_get(stateObj, "unsorted"));
+	_lastRefID = json_integer_value(json_object_get(stateObj, "last_ref"));
+}
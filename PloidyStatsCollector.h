@@ -0,0 +1,88 @@
+#ifndef PLOIDYSTATSCOLLECTOR_H
+#define PLOIDYSTATSCOLLECTOR_H
+
+#pragma once
+
+#include "AbstractStatCollector.h"
+#include "BamIndexStats.h"
+
+#include <stdint.h>
+
+namespace BamstatsAlive {
+
+	/**
+	 * Chromosomal sex and aneuploidy, estimated from the read density of
+	 * every reference
+	 *
+	 * The density of a reference is its reads per Mb of its length in the
+	 * header, and its copy number twice its density over the median
+	 * density of the autosomes. The sex is called from the copies of X and
+	 * the presence of Y, and autosomes whose copy number rounds to other
+	 * than 2 are flagged.
+	 *
+	 * Reads only count when primary, non duplicate and of good mapping
+	 * quality, and the density of a reference is only used once the reads
+	 * of a coordinate sorted input have moved past it. Until then, the
+	 * mapped read counts of the bam index, when there is one, give a
+	 * coarse answer before any read is decoded.
+	 */
+	class PloidyStatsCollector : public AbstractStatCollector {
+		public:
+			static const uint16_t kMinMappingQuality = 20;
+			/** References shorter than this are left out of the autosomal median and the flags */
+			static const uint64_t kMinReferenceLength = 1000000;
+			/** Reads an autosome needs before it is flagged */
+			static const uint64_t kMinFlagReads = 1000;
+
+		protected:
+			virtual const char * collectorName() const { return "ploidy"; }
+			virtual void processAlignmentImpl(const BamTools::BamAlignment& al, const BamTools::RefVector& refVector);
+			virtual void appendJsonImpl(json_t * jsonRootObj);
+			virtual void mergeImpl(const AbstractStatCollector& other);
+			virtual void saveStateImpl(json_t * stateObj);
+			virtual void loadStateImpl(const json_t * stateObj);
+			virtual size_t memoryUsageImpl() const;
+
+		private:
+			// by reference ID
+			std::vector<std::string> _refNames;
+			std::vector<uint64_t> _refLengths;
+			std::vector<uint64_t> _reads;
+			std::vector<uint64_t> _indexReads;
+
+			bool _hasIndexReads;
+			bool _inputInRegions;
+			bool _complete;
+			bool _unsorted;
+			int32_t _lastRefID;
+
+			void resizeReferences(const BamTools::RefVector& refVector);
+
+			/** Whether no mapped read came in and the input is not over, as in a tree only merged into */
+			inline bool holdsNoReads() const { return _lastRefID < 0 && !_complete; }
+
+		public:
+			PloidyStatsCollector();
+
+			/**
+			 * Take the mapped read counts of the bam index, to answer from
+			 * before the reads come in
+			 */
+			void setIndexStats(const BamIndexStats& indexStats, const BamTools::RefVector& refVector);
+
+			inline bool hasIndexStats() const { return _hasIndexReads; }
+
+			/**
+			 * Declare that only reads inside of regions are passed in, whose
+			 * density says nothing about the references
+			 */
+			inline void setInputInRegions(bool inputInRegions) { _inputInRegions = inputInRegions; }
+
+			/**
+			 * Declare that every read of the input has been passed in
+			 */
+			inline void endInput() { _complete = true; }
+	};
+}
+
+#endif
@@ -0,0 +1,195 @@
+#include "QuantileSketch.h"
+
+#include <cmath>
+
+using namespace BamstatsAlive;
+using namespace std;
+
+static const double kCapacityRatio = 2.0 / 3.0;
+static const uint64_t kRandomSeed = 0x9e3779b97f4a7c15ULL;
+
+json_t * QuantileSummaryT::toJson() const {
+	json_t * j_summary = json_object();
+	json_object_set_new(j_summary, "count", json_integer(count));
+	json_object_set_new(j_summary, "min", json_integer(min));
+	json_object_set_new(j_summary, "p1", json_integer(p1));
+	json_object_set_new(j_summary, "q1", json_integer(q1));
+	json_object_set_new(j_summary, "median", json_integer(median));
+	json_object_set_new(j_summary, "q3", json_integer(q3));
+	json_object_set_new(j_summary, "p99", json_integer(p99));
+	json_object_set_new(j_summary, "max", json_integer(max));
+	json_object_set_new(j_summary, "iqr", json_integer(q3 - q1));
+	return j_summary;
+}
+
+QuantileSketch::QuantileSketch(unsigned int k) :
+	_k(k), _size(0), _maxSize(0), _count(0), _min(0), _max(0),
+	_random(kRandomSeed)
+{
+	grow();
+}
+
+size_t QuantileSketch::capacity(size_t level) const {
+	// lower levels get geometrically smaller
+	double depth = _compactors.size() - level - 1;
+	return max<size_t>(2, ceil(_k * pow(kCapacityRatio, depth)));
+}
+
+void QuantileSketch::grow() {
+	_compactors.push_back(vector<valueT>());
+
+	_maxSize = 0;
+	for(size_t h=0; h<_compactors.size(); h++) _maxSize += capacity(h);
+}
+
+void QuantileSketch::compress() {
+	for(size_t h=0; h<_compactors.size(); h++) {
+		if(_compactors[h].size() < capacity(h)) continue;
+
+		// growing may move the levels, take references afterwards
+		if(h + 1 >= _compactors.size()) grow();
+		vector<valueT>& level = _compactors[h];
+		vector<valueT>& above = _compactors[h + 1];
+
+		// half of the sorted items, odd or even ones by a fair coin, move up
+		sort(level.begin(), level.end());
+
+		_random ^= _random << 13; _random ^= _random >> 7; _random ^= _random << 17;
+		size_t offset = _random & 1;
+
+		size_t paired = level.size() & ~static_cast<size_t>(1);
+		for(size_t i=offset; i<paired; i+=2) above.push_back(level[i]);
+
+		// an odd item out stays
+		if(paired < level.size()) level[0] = level[paired];
+		level.resize(level.size() - paired);
+
+		_size = 0;
+		for(size_t l=0; l<_compactors.size(); l++) _size += _compactors[l].size();
+		if(_size < _maxSize) break;
+	}
+}
+
+size_t QuantileSketch::memoryUsage() const {
+	size_t bytes = _compactors.capacity() * sizeof(_compactors[0]);
+	for(size_t level=0; level<_compactors.size(); level++) bytes += _compactors[level].capacity() * sizeof(valueT);
+	return bytes;
+}
+
+void QuantileSketch::merge(const QuantileSketch& other) {
+	if(other._count == 0) return;
+
+	while(_compactors.size() < other._compactors.size()) grow();
+
+	for(size_t h=0; h<other._compactors.size(); h++)
+		_compactors[h].insert(_compactors[h].end(), other._compactors[h].begin(), other._compactors[h].end());
+
+	if(_count == 0 || other._min < _min) _min = other._min;
+	if(_count == 0 || other._max > _max) _max = other._max;
+	_count += other._count;
+
+	_size = 0;
+	for(size_t h=0; h<_compactors.size(); h++) _size += _compactors[h].size();
+	while(_size >= _maxSize) compress();
+}
+
+vector<pair<QuantileSketch::valueT, uint64_t> > QuantileSketch::weightedItems() const {
+	vector<pair<valueT, uint64_t> > items;
+	items.reserve(_size);
+
+	for(size_t h=0; h<_compactors.size(); h++) {
+		for(auto it = _compactors[h].begin(); it != _compactors[h].end(); it++)
+			items.push_back(make_pair(*it, static_cast<uint64_t>(1) << h));
+	}
+
+	sort(items.begin(), items.end());
+	return items;
+}
+
+QuantileSketch::valueT QuantileSketch::quantile(double q) const {
+	if(_count == 0) return 0;
+
+	vector<pair<valueT, uint64_t> > items = weightedItems();
+
+	uint64_t total = 0;
+	for(size_t i=0; i<items.size(); i++) total += items[i].second;
+
+	uint64_t rank = 0;
+	for(size_t i=0; i<items.size(); i++) {
+		rank += items[i].second;
+		if(rank >= q * total) return items[i].first;
+	}
+	return _max;
+}
+
+QuantileSummaryT QuantileSketch::summary() const {
+	QuantileSummaryT summary;
+	summary.count = _count;
+	if(_count == 0) return summary;
+
+	// sort once for all the quantiles
+	vector<pair<valueT, uint64_t> > items = weightedItems();
+
+	uint64_t total = 0;
+	for(size_t i=0; i<items.size(); i++) total += items[i].second;
+
+	const double ranks[] = { 0.01, 0.25, 0.5, 0.75, 0.99 };
+	int32_t * values[] = { &summary.p1, &summary.q1, &summary.median, &summary.q3, &summary.p99 };
+
+	size_t r = 0;
+	uint64_t rank = 0;
+	for(size_t i=0; i<items.size() && r<5; i++) {
+		rank += items[i].second;
+		while(r < 5 && rank >= ranks[r] * total) *values[r++] = items[i].first;
+	}
+	while(r < 5) *values[r++] = _max;
+
+	summary.min = _min;
+	summary.max = _max;
+	return summary;
+}
+
+json_t * QuantileSketch::saveState() const {
+	json_t * j_state = json_object();
+	json_object_set_new(j_state, "count", json_integer(_count));
+	json_object_set_new(j_state, "min", json_integer(_min));
+	json_object_set_new(j_state, "max", json_integer(_max));
+	// the coin of the compactions, so a restored sketch goes on as the saved one would
+	json_object_set_new(j_state, "random", json_integer(static_cast<json_int_t>(_random)));
+
+	json_t * j_levels = json_array();
+	for(size_t h=0; h<_compactors.size(); h++) {
+		json_t * j_level = json_array();
+		for(auto it = _compactors[h].begin(); it != _compactors[h].end(); it++)
+			json_array_append_new(j_level, json_integer(*it));
+		json_array_append_new(j_levels, j_level);
+	}
+	json_object_set_new(j_state, "levels", j_levels);
+
+	return j_state;
+}
+
+void QuantileSketch::loadState(const json_t * stateObj) {
+	_compactors.clear();
+	grow();
+
+	_count = json_integer_value(json_object_get(stateObj, "count"));
+	_min = json_integer_value(json_object_get(stateObj, "min"));
+	_max = json_integer_value(json_object_get(stateObj, "max"));
+
+	const json_t * j_random = json_object_get(stateObj, "random");
+	_random = json_is_integer(j_random) ? static_cast<uint64_t>(json_integer_value(j_random)) : kRandomSeed;
+	// xorshift never leaves zero
+	if(_random == 0) _random = kRandomSeed;
+
+	const json_t * j_levels = json_object_get(stateObj, "levels");
+	while(_compactors.size() < json_array_size(j_levels)) grow();
+
+	_size = 0;
+	for(size_t h=0; h<json_array_size(j_levels); h++) {
+		const json_t * j_level = json_array_get(j_levels, h);
+		for(size_t i=0; i<json_array_size(j_level); i++)
+			_compactors[h].push_back(json_integer_value(json_array_get(j_level, i)));
+		_size += _compactors[h].size();
+	}
+}
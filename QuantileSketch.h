@@ -0,0 +1,96 @@
+#ifndef QUANTILESKETCH_H
+#define QUANTILESKETCH_H
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+namespace BamstatsAlive {
+
+	/**
+	 * The quantiles reported for a distribution
+	 */
+	typedef struct _quantileSummaryT {
+		uint64_t count;
+		int32_t min, p1, q1, median, q3, p99, max;
+
+		_quantileSummaryT() : count(0), min(0), p1(0), q1(0), median(0), q3(0), p99(0), max(0) {}
+
+		/**
+		 * @return A new json object with the count, min, p1, q1, median,
+		 *         q3, p99, max and the interquartile range
+		 */
+		json_t * toJson() const;
+	} QuantileSummaryT;
+
+	/**
+	 * A KLL quantile sketch over integers
+	 *
+	 * The sketch keeps a stack of compactors, items at level h standing for
+	 * 2^h input values. When a level is full it is sorted and every other
+	 * item moves up a level, so the space stays around 3k items however
+	 * many values are added, and the rank error around 1.7/k. Sketches
+	 * built on separate inputs merge into the sketch of the combined input.
+	 */
+	class QuantileSketch {
+		public:
+			typedef int32_t valueT;
+
+		private:
+			unsigned int _k;
+			std::vector<std::vector<valueT> > _compactors;
+			size_t _size;
+			size_t _maxSize;
+			uint64_t _count;
+			valueT _min;
+			valueT _max;
+			uint64_t _random;
+
+			size_t capacity(size_t level) const;
+			void grow();
+			void compress();
+
+			/**
+			 * The retained items with their weights, sorted by value
+			 */
+			std::vector<std::pair<valueT, uint64_t> > weightedItems() const;
+
+		public:
+			/**
+			 * @param k The accuracy parameter, the capacity of the top level
+			 */
+			QuantileSketch(unsigned int k = 200);
+
+			inline void add(valueT value) {
+				if(_count == 0 || value < _min) _min = value;
+				if(_count == 0 || value > _max) _max = value;
+				_count++;
+
+				_compactors[0].push_back(value);
+				if(++_size >= _maxSize) compress();
+			}
+
+			void merge(const QuantileSketch& other);
+
+			inline uint64_t count() const { return _count; }
+
+			/**
+			 * The memory held by the compactors, in bytes
+			 */
+			size_t memoryUsage() const;
+
+			/**
+			 * @param q The rank, between 0 and 1
+			 * @return The value at rank q, 0 if the sketch is empty
+			 */
+			valueT quantile(double q) const;
+
+			QuantileSummaryT summary() const;
+
+			json_t * saveState() const;
+			void loadState(const json_t * stateObj);
+	};
+}
+
+#endif
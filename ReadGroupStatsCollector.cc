@@ -0,0 +1,220 @@
+#include "ReadGroupStatsCollector.h"
+
+#include <cstring>
+
+using namespace BamstatsAlive;
+using namespace std;
+
+static const size_t kNoIndex = static_cast<size_t>(-1);
+
+// header values are never empty
+const char * const ReadGroupStatsCollector::kNoGroupPartition = "";
+
+ReadGroupStatsCollector::ReadGroupStatsCollector(ModeT mode, const TreeFactoryT& treeFactory) :
+	AbstractStatCollector(),
+	_mode(mode),
+	_treeFactory(treeFactory),
+	_noGroupPartition(kNoIndex),
+	_lastGroup(kNoIndex)
+{
+}
+
+ReadGroupStatsCollector::~ReadGroupStatsCollector() {
+	for(size_t i=0; i<_partitions.size(); i++) delete _partitions[i];
+}
+
+bool ReadGroupStatsCollector::parseMode(const std::string& spec, ModeT& mode) {
+	if(spec == "rg") mode = kPartitionReadGroup;
+	else if(spec == "library") mode = kPartitionLibrary;
+	else return false;
+
+	return true;
+}
+
+unsigned int ReadGroupStatsCollector::requiredFieldsImpl() const {
+	// the partitions' trees are copies of collectors of the job, whose
+	// fields are required already
+	return kFieldTags;
+}
+
+size_t ReadGroupStatsCollector::partitionIndex(const std::string& name) {
+	for(size_t i=0; i<_partitionNames.size(); i++)
+		if(_partitionNames[i] == name) return i;
+
+	_partitionNames.push_back(name);
+	_partitions.push_back(_treeFactory());
+	_partitionReads.push_back(0);
+	return _partitions.size() - 1;
+}
+
+void ReadGroupStatsCollector::setReadGroups(const BamTools::SamHeader& header) {
+	vector<pair<string, string> > groups;
+	for(auto it = header.ReadGroups.ConstBegin(); it != header.ReadGroups.ConstEnd(); it++) {
+		if(it->ID.empty()) continue;
+
+		// read groups without a library are a library of their own
+		bool byLibrary = _mode == kPartitionLibrary && !it->Library.empty();
+		groups.push_back(make_pair(it->ID, byLibrary ? it->Library : it->ID));
+	}
+	sort(groups.begin(), groups.end());
+
+	_groupIDs.clear();
+	_groupPartitions.clear();
+	for(size_t i=0; i<groups.size(); i++) {
+		_groupIDs.push_back(groups[i].first);
+		_groupPartitions.push_back(partitionIndex(groups[i].second));
+	}
+	_lastGroup = kNoIndex;
+}
+
+const char * ReadGroupStatsCollector::findStringTag(const std::string& tagData, const char * tag) {
+	const char * p = tagData.data();
+	const char * end = p + tagData.size();
+
+	// every tag is its name, a type character and a value whose size follows from the type
+	while(end - p >= 3) {
+		char type = p[2];
+		const char * value = p + 3;
+		size_t size;
+
+		switch(type) {
+			case 'A': case 'c': case 'C':
+				size = 1;
+				break;
+			case 's': case 'S':
+				size = 2;
+				break;
+			case 'i': case 'I': case 'f':
+				size = 4;
+				break;
+			case 'Z': case 'H': {
+				const char * nul = static_cast<const char *>(memchr(value, '\0', end - value));
+				if(nul == NULL) return NULL;
+				size = nul - value + 1;
+				break;
+			}
+			case 'B': {
+				if(end - value < 5) return NULL;
+				uint32_t count;
+				memcpy(&count, value + 1, sizeof(count));
+
+				size_t elementSize;
+				switch(value[0]) {
+					case 'c': case 'C': elementSize = 1; break;
+					case 's': case 'S': elementSize = 2; break;
+					case 'i': case 'I': case 'f': elementSize = 4; break;
+					default: return NULL;
+				}
+				if(count > static_cast<size_t>(end - value - 5) / elementSize) return NULL;
+				size = 5 + count * elementSize;
+				break;
+			}
+			default:
+				return NULL;
+		}
+
+		if(p[0] == tag[0] && p[1] == tag[1]) return type == 'Z' ? value : NULL;
+		if(static_cast<size_t>(end - value) < size) return NULL;
+		p = value + size;
+	}
+
+	return NULL;
+}
+
+void ReadGroupStatsCollector::processAlignmentImpl(const BamTools::BamAlignment& al, const BamTools::RefVector& refVector) {
+	const char * id = findStringTag(al.TagData, "RG");
+	size_t group = kNoIndex;
+
+	if(id != NULL) {
+		// reads of a group mostly come together
+		if(_lastGroup != kNoIndex && strcmp(_groupIDs[_lastGroup].c_str(), id) == 0)
+			group = _lastGroup;
+		else {
+			auto it = lower_bound(_groupIDs.begin(), _groupIDs.end(), id,
+					[](const std::string& groupID, const char * key) { return strcmp(groupID.c_str(), key) < 0; });
+			if(it != _groupIDs.end() && strcmp(it->c_str(), id) == 0) group = it - _groupIDs.begin();
+		}
+	}
+
+	size_t partition;
+	if(group != kNoIndex) {
+		_lastGroup = group;
+		partition = _groupPartitions[group];
+	}
+	else {
+		if(_noGroupPartition == kNoIndex) _noGroupPartition = partitionIndex(kNoGroupPartition);
+		partition = _noGroupPartition;
+	}
+
+	_partitionReads[partition]++;
+	_partitions[partition]->processAlignment(al, refVector);
+}
+
+void ReadGroupStatsCollector::appendJsonImpl(json_t * jsonRootObj) {
+	json_t * j_groups = json_object();
+
+	for(size_t i=0; i<_partitions.size(); i++) {
+		if(_partitionReads[i] == 0) continue;
+
+		if(_partitionNames[i] == kNoGroupPartition)
+			json_object_set_new(jsonRootObj, "no_read_group", _partitions[i]->appendJson());
+		else
+			json_object_set_new(j_groups, _partitionNames[i].c_str(), _partitions[i]->appendJson());
+	}
+
+	json_object_set_new(jsonRootObj, "read_groups", j_groups);
+}
+
+void ReadGroupStatsCollector::mergeImpl(const AbstractStatCollector& other) {
+	const ReadGroupStatsCollector& otherGroups = dynamic_cast<const ReadGroupStatsCollector&>(other);
+
+	// partitions are paired up by name, inputs may have different read groups
+	for(size_t i=0; i<otherGroups._partitions.size(); i++) {
+		if(otherGroups._partitionReads[i] == 0) continue;
+
+		size_t partition = partitionIndex(otherGroups._partitionNames[i]);
+		_partitions[partition]->merge(*otherGroups._partitions[i]);
+		_partitionReads[partition] += otherGroups._partitionReads[i];
+	}
+}
+
+size_t ReadGroupStatsCollector::memoryUsageImpl() const {
+	size_t bytes = vectorMemoryUsage(_partitionNames) + vectorMemoryUsage(_partitions) + vectorMemoryUsage(_partitionReads)
+		+ vectorMemoryUsage(_groupIDs) + vectorMemoryUsage(_groupPartitions);
+	for(size_t p=0; p<_partitions.size(); p++) bytes += _partitions[p]->memoryUsage();
+	return bytes;
+}
+
+bool ReadGroupStatsCollector::shedMemoryImpl() {
+	bool shed = false;
+	for(size_t p=0; p<_partitions.size(); p++) shed = _partitions[p]->shedMemory() || shed;
+	return shed;
+}
+
+void ReadGroupStatsCollector::saveStateImpl(json_t * stateObj) {
+	json_t * j_partitions = json_object();
+
+	for(size_t i=0; i<_partitions.size(); i++) {
+		if(_partitionReads[i] == 0) continue;
+
+		json_t * j_partition = json_object();
+		json_object_set_new(j_partition, "reads", json_integer(_partitionReads[i]));
+		json_object_set_new(j_partition, "state", _partitions[i]->saveState());
+		json_object_set_new(j_partitions, _partitionNames[i].c_str(), j_partition);
+	}
+
+	json_object_set_new(stateObj, "partitions", j_partitions);
+}
+
+void ReadGroupStatsCollector::loadStateImpl(const json_t * stateObj) {
+	const json_t * j_partitions = json_object_get(stateObj, "partitions");
+
+	// partitions the header created keep their index, so reads still find them
+	const char * name;
+	json_t * j_partition;
+	json_object_foreach(const_cast<json_t *>(j_partitions), name, j_partition) {
+		size_t partition = partitionIndex(name);
+		_partitions[partition]->loadState(json_object_get(j_partition, "state"));
+		_partitionReads[partition] = json_integer_value(json_object_get(j_partition, "reads"));
+	}
+}
@@ -0,0 +1,102 @@
+#ifndef READGROUPSTATSCOLLECTOR_H
+#define READGROUPSTATSCOLLECTOR_H
+
+#pragma once
+
+#include "AbstractStatCollector.h"
+
+#include <functional>
+
+namespace BamstatsAlive {
+
+	/**
+	 * Statistics partitioned by read group or library
+	 *
+	 * The collector keeps a collector tree per partition and passes every
+	 * read to the tree of its partition, so that a multiplexed input does
+	 * not need to be split first. Each frame then carries the statistics of
+	 * every partition under "read_groups", keyed by read group ID or library
+	 * name.
+	 *
+	 * The read group IDs of the header are resolved to partitions once. A
+	 * read's group is found by scanning its raw tag data for RG, comparing
+	 * the value to the previous read's before looking it up, so that reads
+	 * do not allocate. Reads without a known read group go to a partition of
+	 * their own, reported under "no_read_group" rather than among the read
+	 * groups, so that it cannot be mistaken for one.
+	 */
+	class ReadGroupStatsCollector : public AbstractStatCollector {
+		public:
+			enum ModeT {
+				kPartitionNone = 0,
+				kPartitionReadGroup,
+				kPartitionLibrary
+			};
+
+			/** Creates the collector tree of a partition, which owns its children */
+			typedef std::function<AbstractStatCollector * ()> TreeFactoryT;
+
+			/** The name of the partition of reads without a known read group, which no read group ID or library can have */
+			static const char * const kNoGroupPartition;
+
+		protected:
+			virtual const char * collectorName() const { return "read_groups"; }
+			virtual void processAlignmentImpl(const BamTools::BamAlignment& al, const BamTools::RefVector& refVector);
+			virtual void appendJsonImpl(json_t * jsonRootObj);
+			virtual void mergeImpl(const AbstractStatCollector& other);
+			virtual void saveStateImpl(json_t * stateObj);
+			virtual void loadStateImpl(const json_t * stateObj);
+			virtual size_t memoryUsageImpl() const;
+			virtual bool shedMemoryImpl();
+			virtual unsigned int requiredFieldsImpl() const;
+
+		private:
+			ModeT _mode;
+			TreeFactoryT _treeFactory;
+
+			std::vector<std::string> _partitionNames;
+			std::vector<AbstractStatCollector *> _partitions;
+			std::vector<uint64_t> _partitionReads;
+
+			// the header's read group IDs, sorted, and the partition of each
+			std::vector<std::string> _groupIDs;
+			std::vector<size_t> _groupPartitions;
+			size_t _noGroupPartition;
+
+			// the read group of the previous read
+			size_t _lastGroup;
+
+			size_t partitionIndex(const std::string& name);
+
+		public:
+			/**
+			 * Find a string tag in the raw tag data of a record
+			 *
+			 * @return The NUL terminated value, or NULL if the tag is missing,
+			 *         not a string, or the data is truncated before it
+			 */
+			static const char * findStringTag(const std::string& tagData, const char * tag);
+
+			/**
+			 * @param mode How reads are partitioned
+			 * @param treeFactory Creates the collector tree of a new partition,
+			 *        which may only need fields the rest of the job's tree needs
+			 */
+			ReadGroupStatsCollector(ModeT mode, const TreeFactoryT& treeFactory);
+			virtual ~ReadGroupStatsCollector();
+
+			/**
+			 * Resolve the read groups of the input's header to partitions
+			 */
+			void setReadGroups(const BamTools::SamHeader& header);
+
+			/**
+			 * Parse a partitioning mode: rg or library
+			 *
+			 * @return false if the mode is not known
+			 */
+			static bool parseMode(const std::string& spec, ModeT& mode);
+	};
+}
+
+#endif
@@ -0,0 +1,117 @@
+#include "ReadSampler.h"
+
+#include <cmath>
+
+using namespace BamstatsAlive;
+
+static const double kZ95 = 1.959964;
+
+static uint64_t nameHash(const std::string& name) {
+	// FNV-1a followed by a finalizer, so similar names spread evenly
+	uint64_t h = 14695981039346656037ULL;
+	for(size_t i=0; i<name.length(); i++) {
+		h ^= static_cast<unsigned char>(name[i]);
+		h *= 1099511628211ULL;
+	}
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	return h;
+}
+
+ReadSampler::ReadSampler(ModeT mode, double fraction) :
+	_mode(mode), _fraction(fraction), _seen(0), _accepted(0)
+{
+	if(_fraction <= 0 || _fraction >= 1) {
+		_mode = kSampleNone;
+		_fraction = 1.0;
+	}
+
+	_stride = static_cast<uint64_t>(llround(1.0 / _fraction));
+	if(_stride == 0) _stride = 1;
+
+	_hashThreshold = _fraction >= 1.0 ? UINT64_MAX : static_cast<uint64_t>(ldexp(_fraction, 64));
+}
+
+bool ReadSampler::parseSpec(const std::string& spec, ModeT& mode, double& fraction) {
+	size_t colon = spec.find(':');
+	if(colon == std::string::npos) return false;
+
+	std::string modeName = spec.substr(0, colon);
+	fraction = atof(spec.c_str() + colon + 1);
+	if(fraction <= 0 || fraction > 1) return false;
+
+	if(modeName == "stride") mode = kSampleStride;
+	else if(modeName == "hash") mode = kSampleHash;
+	else if(modeName == "stratified") mode = kSampleStratified;
+	else return false;
+
+	return true;
+}
+
+bool ReadSampler::accept(const BamTools::BamAlignment& al) {
+	_seen++;
+
+	bool accepted = true;
+
+	switch(_mode) {
+		case kSampleNone:
+			break;
+		case kSampleStride:
+			accepted = (_seen - 1) % _stride == 0;
+			break;
+		case kSampleHash:
+			accepted = nameHash(al.Name) < _hashThreshold;
+			break;
+		case kSampleStratified:
+			{
+				// stratum 0 holds the reads without a reference
+				size_t stratum = al.RefID < 0 ? 0 : al.RefID + 1;
+				if(stratum >= _strataSeen.size()) _strataSeen.resize(stratum + 1, 0);
+				accepted = _strataSeen[stratum]++ % _stride == 0;
+			}
+			break;
+	}
+
+	if(accepted) _accepted++;
+	return accepted;
+}
+
+json_t * ReadSampler::toJson() const {
+	static const char * kModeNames[] = { "none", "stride", "hash", "stratified" };
+
+	json_t * j_sampling = json_object();
+	json_object_set_new(j_sampling, "mode", json_string(kModeNames[_mode]));
+	json_object_set_new(j_sampling, "fraction", json_real(_fraction));
+	json_object_set_new(j_sampling, "reads_seen", json_integer(_seen));
+	json_object_set_new(j_sampling, "reads_sampled", json_integer(_accepted));
+	return j_sampling;
+}
+
+json_t * ReadSampler::estimateJson(uint64_t count) const {
+	double n = static_cast<double>(_accepted);
+	double N = static_cast<double>(_seen);
+	double low = 0, high = 1;
+
+	if(n > 0 && N <= n) {
+		// every read was seen, nothing to estimate
+		low = high = count / n;
+	}
+	else if(n > 0) {
+		double p = count / n;
+		double nEff = n * (N - 1) / (N - n);
+		double z2 = kZ95 * kZ95;
+		double denominator = 1 + z2 / nEff;
+		double center = (p + z2 / (2 * nEff)) / denominator;
+		double halfWidth = kZ95 * sqrt(p * (1 - p) / nEff + z2 / (4 * nEff * nEff)) / denominator;
+		low = center - halfWidth < 0 ? 0 : center - halfWidth;
+		high = center + halfWidth > 1 ? 1 : center + halfWidth;
+	}
+
+	json_t * j_estimate = json_object();
+	json_object_set_new(j_estimate, "count", json_integer(count));
+	json_object_set_new(j_estimate, "estimate", json_real(n > 0 ? N * count / n : 0));
+	json_object_set_new(j_estimate, "ci_low", json_real(N * low));
+	json_object_set_new(j_estimate, "ci_high", json_real(N * high));
+	return j_estimate;
+}
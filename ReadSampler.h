@@ -0,0 +1,94 @@
+#ifndef READSAMPLER_H
+#define READSAMPLER_H
+
+#pragma once
+
+#include "AbstractStatCollector.h"
+
+#include <stdint.h>
+
+namespace BamstatsAlive {
+
+	/**
+	 * Selects the subset of reads passed on to the collectors
+	 *
+	 * The sampler sits between the reader and the collector tree. It keeps
+	 * track of how many reads it has seen and accepted, so that the counts
+	 * of the sampled reads can be scaled back to estimates over every read
+	 * that went by, with confidence intervals.
+	 *
+	 *   - stride: every n-th read
+	 *   - hash: reads whose name hashes below the fraction, deterministic
+	 *     and keeping mates together
+	 *   - stratified: every n-th read of each reference, with a separate
+	 *     phase per reference so every reference is sampled at the same rate
+	 *     however the references interleave
+	 */
+	class ReadSampler {
+		public:
+			enum ModeT {
+				kSampleNone = 0,
+				kSampleStride,
+				kSampleHash,
+				kSampleStratified
+			};
+
+		private:
+			ModeT _mode;
+			double _fraction;
+			uint64_t _stride;
+			uint64_t _hashThreshold;
+			uint64_t _seen;
+			uint64_t _accepted;
+			std::vector<uint64_t> _strataSeen;
+
+		public:
+			/**
+			 * @param mode The sampling scheme
+			 * @param fraction The fraction of reads to keep, in (0, 1]
+			 */
+			ReadSampler(ModeT mode = kSampleNone, double fraction = 1.0);
+
+			/**
+			 * Parse a sampling specification of the form mode:fraction
+			 *
+			 * @param spec e.g. "hash:0.02"
+			 * @param mode Receives the sampling scheme
+			 * @param fraction Receives the fraction of reads to keep
+			 * @return false if the specification is invalid
+			 */
+			static bool parseSpec(const std::string& spec, ModeT& mode, double& fraction);
+
+			/**
+			 * Decide whether a read is passed on to the collectors
+			 *
+			 * @param al The alignment read
+			 * @return true if the read is part of the sample
+			 */
+			bool accept(const BamTools::BamAlignment& al);
+
+			inline bool isActive() const { return _mode != kSampleNone; }
+			inline uint64_t seen() const { return _seen; }
+			inline uint64_t accepted() const { return _accepted; }
+
+			/** The alignment fields needed to sample, as AlignmentFieldT bits */
+			inline unsigned int requiredFields() const { return _mode == kSampleHash ? kFieldName : 0; }
+
+			/**
+			 * Describe the sampler and how many reads went through it
+			 */
+			json_t * toJson() const;
+
+			/**
+			 * Scale a count over the sampled reads to an estimate over all
+			 * reads seen, with a 95% Wilson score interval corrected for the
+			 * finite number of reads seen
+			 *
+			 * @param count The number of sampled reads having some property
+			 * @return json object with count, estimate, ci_low and ci_high
+			 */
+			json_t * estimateJson(uint64_t count) const;
+	};
+}
+
+#endif
@@ -36,6 +36,13 @@ namespace BamstatsAlive {
 						_trailingVal = new T[trailLength];
 					}
 
+				StandardDeviationChangeMonitor(const StandardDeviationChangeMonitor&) = delete;
+				StandardDeviationChangeMonitor& operator=(const StandardDeviationChangeMonitor&) = delete;
+
+				virtual ~StandardDeviationChangeMonitor() {
+					delete [] _trailingVal;
+				}
+
 				virtual void addValue(T value) {
 					if(_count >= _trailLength) {
 						for(unsigned int i=0; i<_trailLength-1; i++)
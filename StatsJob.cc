@@ -0,0 +1,602 @@
+#include "StatsJob.h"
+#include "FpsModulator.h"
+#include "WorkerPool.h"
+
+#include <atomic>
+#include <mutex>
+#include <sys/resource.h>
+
+using namespace BamstatsAlive;
+
+// number of reads between two sidecar checkpoints
+static const unsigned int kSidecarCheckpointInterval = 1000000;
+
+// chunks the targets are cut into, whatever the number of workers, so that
+// workers done early take over more and the result does not depend on them
+static const size_t kTargetChunks = 128;
+
+// gap to the next target beyond which seeking beats reading through
+static const int32_t kTargetSeekDistance = 1 << 16;
+
+// number of reads between two checks of the memory limit
+static const unsigned int kMemoryCheckInterval = 1 << 16;
+
+typedef TargetCoverageStatsCollector::TargetVec TargetVec;
+
+namespace {
+	// the collector tree of a read group partition, the job's collectors
+	// besides the regional ones
+	typedef struct _partitionTreeT : public BasicStatsCollector {
+		CollectorSet collectors;
+
+		_partitionTreeT(std::map<int32_t, std::string>& chromIDNameMap, const StatsJobOptionsT& options) :
+			collectors(options.collectors, chromIDNameMap, NULL, 0, options.mismatchTags, options.variantSites)
+		{
+			if(collectors.histogram) {
+				collectors.histogram->setInputInRegions(options.isTargeted);
+				collectors.histogram->setSummaryOnly(options.summaryOnly);
+			}
+			if(collectors.ploidy) collectors.ploidy->setInputInRegions(options.isTargeted);
+			collectors.setNameSorted(options.nameSorted);
+			collectors.attachTo(*this);
+		}
+	} PartitionTreeT;
+
+	ReadGroupStatsCollector * newReadGroupCollector(std::map<int32_t, std::string>& chromIDNameMap, const StatsJobOptionsT& options) {
+		if(options.partitionMode == ReadGroupStatsCollector::kPartitionNone) return NULL;
+
+		// partitions are created as read groups show up, after the header has been read
+		return new ReadGroupStatsCollector(options.partitionMode, [&chromIDNameMap, &options]() {
+			return new PartitionTreeT(chromIDNameMap, options);
+		});
+	}
+
+	// the collector tree of a chunk of targets, shaped like the job's
+	typedef struct _targetChunkT {
+		BasicStatsCollector root;
+		CollectorSet collectors;
+		ReadGroupStatsCollector * readGroups;
+		TargetCoverageStatsCollector coverage;
+		CoverageTrackStatsCollector * track;
+		PerfCounters perfCounters;
+		unsigned int reads;
+
+		_targetChunkT(std::map<int32_t, std::string>& chromIDNameMap, const GenomicRegionStore& regionStore, const StatsJobOptionsT& options) :
+			collectors(options.collectors, chromIDNameMap, NULL, 0, options.mismatchTags, options.variantSites),
+			readGroups(newReadGroupCollector(chromIDNameMap, options)),
+			coverage(regionStore),
+			track(options.trackBinSize > 0 ? new CoverageTrackStatsCollector(regionStore, options.trackBinSize) : NULL),
+			reads(0)
+		{
+			if(collectors.histogram) {
+				collectors.histogram->setInputInRegions(true);
+				collectors.histogram->setSummaryOnly(options.summaryOnly);
+			}
+			if(collectors.ploidy) collectors.ploidy->setInputInRegions(true);
+			coverage.setCoverageCap(options.coverageCap);
+			collectors.attachTo(root);
+			if(readGroups) root.addChild(readGroups);
+			root.addChild(&coverage);
+			if(track) root.addChild(track);
+		}
+
+		~_targetChunkT() {
+			if(readGroups) delete readGroups;
+			if(track) delete track;
+		}
+	} TargetChunkT;
+}
+
+/**
+ * Pass the reads of a chunk of targets to its collectors
+ */
+static void sweepTargets(TargetChunkT& tree, AlignmentReader& reader, const TargetVec& targets, size_t firstTarget, size_t lastTarget, bool canSeek) {
+	const BamTools::RefVector& refVector = reader.referenceData();
+
+	// targets on references the input does not have come last, and get no reads
+	size_t lastReadable = lastTarget;
+	while(lastReadable > firstTarget && targets[lastReadable - 1].refID < 0) lastReadable--;
+
+	tree.coverage.beginTargets(targets, firstTarget, lastTarget);
+	if(tree.track) tree.track->beginTargets(targets, firstTarget, lastTarget);
+
+	BamTools::BamAlignment al;
+	bool needSeek = canSeek;
+	size_t lastSought = TargetCoverageStatsCollector::kNoTarget;
+
+	while(lastReadable > firstTarget) {
+		if(needSeek) {
+			size_t next = tree.coverage.nextTarget();
+			if(next >= lastReadable || !reader.seek(targets[next].refID, targets[next].startPos)) break;
+			lastSought = next;
+			needSeek = false;
+		}
+
+		{
+			BSA_PERF_SCOPE(PerfCounters::kStageDecode);
+			if(!reader.getNextAlignmentCore(al)) break;
+		}
+
+		// reads without coordinates come last
+		const TargetCoverageStatsCollector::TargetT& last = targets[lastReadable - 1];
+		if(al.RefID < 0 || al.RefID > last.refID || (al.RefID == last.refID && al.Position > last.endPos)) break;
+
+		if(!al.IsMapped()) continue;
+		if(PerfCounters::kEnabled) tree.perfCounters.addRead(PerfCounters::recordBytes(al));
+
+		size_t owner = TargetCoverageStatsCollector::locateTarget(targets, al.RefID, al.Position, TargetCoverageStatsCollector::referenceEnd(al));
+
+		if(owner >= firstTarget && owner < lastTarget) {
+			reader.buildCharData(al);
+			tree.reads++;
+			tree.root.processAlignment(al, refVector);
+		}
+		else {
+			// moves the sweep along, and adds the coverage of reads owned by an earlier chunk
+			tree.coverage.processAlignment(al, refVector);
+			if(tree.track) tree.track->processAlignment(al, refVector);
+		}
+
+		if(canSeek && !tree.coverage.hasOpenTargets()) {
+			size_t next = tree.coverage.nextTarget();
+			needSeek = next < lastReadable && next != lastSought
+				&& (targets[next].refID != al.RefID || targets[next].startPos - al.Position > kTargetSeekDistance);
+		}
+	}
+
+	tree.coverage.endTargets();
+	if(tree.track) tree.track->endTargets();
+}
+
+StatsJob::StatsJob(const std::string& filename,
+		const StatsJobOptionsT& options,
+		const GenomicRegionStore * regionStore,
+		FrameWriter& writer,
+		bool tagFrames) :
+	_filename(filename),
+	_tagFrames(tagFrames),
+	_options(options),
+	_writer(writer),
+	_regionStore(regionStore),
+	_collectors(options.collectors, _chromIDNameMap, options.isTargeted ? NULL : regionStore, options.coverageSkipFactor, options.mismatchTags, options.variantSites),
+	_readGroupCollector(newReadGroupCollector(_chromIDNameMap, _options)),
+	_targetCoverageCollector(NULL),
+	_trackCollector(NULL),
+	_totalReads(0),
+	_memorySheds(0),
+	_peakCollectorBytes(0),
+	_sampler(options.isBatch ? ReadSampler::kSampleNone : options.samplingMode, options.samplingFraction),
+	_prefetcher(NULL)
+{
+	// until the header says otherwise, the sample is named after the file
+	size_t slash = filename.find_last_of('/');
+	_sampleId = slash == std::string::npos ? filename : filename.substr(slash + 1);
+	size_t ext = _sampleId.rfind(".bam");
+	if(ext != std::string::npos && ext > 0 && ext == _sampleId.length() - 4) _sampleId.erase(ext);
+
+	if(_collectors.histogram) {
+		_collectors.histogram->setSummaryOnly(options.summaryOnly);
+		_collectors.histogram->setCoverageCap(options.coverageCap);
+		_collectors.histogram->setProgressive(options.progressive && !options.isBatch);
+	}
+	_collectors.attachTo(_rootCollector);
+
+	if(_readGroupCollector) _rootCollector.addChild(_readGroupCollector);
+
+	_rootCollector.setSampler(&_sampler);
+
+	// targeted jobs see only reads in regions, whose coverage is then exact
+	if(options.isTargeted && regionStore) {
+		_targetCoverageCollector = new TargetCoverageStatsCollector(*regionStore);
+		_targetCoverageCollector->setCoverageCap(options.coverageCap);
+		if(_collectors.histogram) _collectors.histogram->setInputInRegions(true);
+		if(_collectors.ploidy) _collectors.ploidy->setInputInRegions(true);
+		_rootCollector.addChild(_targetCoverageCollector);
+	}
+
+	if(options.trackBinSize > 0 && regionStore) {
+		_trackCollector = new CoverageTrackStatsCollector(*regionStore, options.trackBinSize);
+		_trackCollector->setKeepReported(options.isMerged);
+		_rootCollector.addChild(_trackCollector);
+	}
+}
+
+StatsJob::~StatsJob() {
+	if(_readGroupCollector) delete _readGroupCollector;
+	if(_targetCoverageCollector) delete _targetCoverageCollector;
+	if(_trackCollector) delete _trackCollector;
+}
+
+std::string StatsJob::sidecarKey(const StatsJobOptionsT& options, const GenomicRegionStore * regionStore) {
+	std::stringstream keySS;
+	keySS<<"k="<<options.coverageSkipFactor<<";summary="<<options.summaryOnly<<";cap="<<options.coverageCap<<";track="<<options.trackBinSize<<";mismatch="<<options.mismatchTags<<";collectors="<<options.collectors<<";partition="<<options.partitionMode<<";names="<<options.nameSorted;
+	keySS<<";sampling="<<options.samplingMode<<":"<<options.samplingFraction<<";regions=";
+	if(regionStore) keySS.write(regionStore->image(), regionStore->imageSize());
+	keySS<<";sites=";
+	for(size_t i=0; options.variantSites && i<options.variantSites->size(); i++) keySS<<(*options.variantSites)[i].chrom<<":"<<(*options.variantSites)[i].position<<",";
+	return keySS.str();
+}
+
+AlignmentReaderOptionsT StatsJob::readerOptions() const {
+	AlignmentReaderOptionsT readerOptions;
+	readerOptions.fields = _rootCollector.requiredFields() | _sampler.requiredFields();
+	readerOptions.reference = _options.reference;
+	readerOptions.decodeThreads = _options.decodeThreads;
+	return readerOptions;
+}
+
+// the largest resident set of the process so far; it depends on whatever else
+// ran in the process, so it is logged rather than reported in the frames
+static size_t peakResidentBytes() {
+	struct rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+	return usage.ru_maxrss;
+#else
+	return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+}
+
+bool StatsJob::run() {
+
+	/* read stdin ahead on a thread, so a slow upstream and the collectors overlap */
+
+	if(_filename == "-" && _options.prefetchBytes > 0) {
+		_prefetcher = new InputPrefetcher(_options.prefetchBytes);
+		if(!_prefetcher->start()) {
+			delete _prefetcher;
+			_prefetcher = NULL;
+		}
+	}
+
+	/* open the alignment file, decoding only what the collectors need */
+
+	AlignmentReader * reader = AlignmentReader::open(_filename, readerOptions());
+	if(reader == NULL) {
+		if(_prefetcher) delete _prefetcher;
+		_prefetcher = NULL;
+		return false;
+	}
+
+	const BamTools::RefVector& refVector = reader->referenceData();
+
+	for(size_t i=0; i<refVector.size(); i++) {
+		_chromIDNameMap[i] = refVector[i].RefName;
+	}
+
+	// prefer the sample name recorded in the read groups
+	BamTools::SamHeader header = reader->header();
+	for(auto it = header.ReadGroups.ConstBegin(); it != header.ReadGroups.ConstEnd(); it++) {
+		if(!it->Sample.empty()) {
+			_sampleId = it->Sample;
+			break;
+		}
+	}
+
+	// mates of name sorted or unsorted input come together rather than
+	// along the genome; targeted jobs read the regions by position anyway
+	if(_targetCoverageCollector)
+		_options.nameSorted = false;
+	else if(header.SortOrder == "queryname" || header.SortOrder == "unsorted" || refVector.empty())
+		_options.nameSorted = true;
+
+	if(_options.nameSorted) {
+		LOGS<<"Pairing mates by name"<<std::endl;
+		_collectors.setNameSorted(true);
+		reader->setFields(readerOptions().fields);
+	}
+
+	if(_readGroupCollector) _readGroupCollector->setReadGroups(header);
+
+	// the index tells the reads per reference before any is decoded
+	if(_collectors.ploidy && _filename != "-") {
+		BamIndexStats indexStats(_filename);
+		_collectors.ploidy->setIndexStats(indexStats, refVector);
+	}
+
+	// tracks are swept along a sorted input, targeted jobs sweep per worker
+	if(_trackCollector && !_targetCoverageCollector && header.SortOrder == "coordinate") {
+		_trackTargets = TargetCoverageStatsCollector::mergeRegions(*_regionStore, refVector);
+		_trackCollector->beginTargets(_trackTargets, 0, _trackTargets.size());
+	}
+
+	/* Process read alignments */
+	PerfCounters::setCurrent(&_perfCounters);
+
+	if(_targetCoverageCollector)
+		runTargeted(*reader, refVector);
+	else if(_options.isBatch)
+		runBatch(*reader, refVector);
+	else
+		runLive(*reader, refVector);
+
+	if(PerfCounters::kEnabled)
+		_writer.writeObject("perf_summary", perfJson(), _tagFrames ? _sampleId : "");
+
+	PerfCounters::setCurrent(NULL);
+
+	LOGS<<"Peak resident set of the process "<<peakResidentBytes()<<" bytes"<<std::endl;
+
+	delete reader;
+
+	if(_prefetcher) {
+		LOGS<<"Input stalled for "<<_prefetcher->stallNs() / 1e9<<"s over "<<_prefetcher->blocks()<<" BGZF blocks"<<std::endl;
+		delete _prefetcher;
+		_prefetcher = NULL;
+	}
+	return true;
+}
+
+void StatsJob::runLive(AlignmentReader& reader, const BamTools::RefVector& refVector) {
+	BamTools::BamAlignment alignment;
+
+	YiCppLib::FpsModulator<decltype(_options.updateRate)> fpsModulator(_options.updateRate, _options.fps, 250);
+	bool exhausted = false;
+
+	// a first answer from the index alone
+	if(_collectors.ploidy && _collectors.ploidy->hasIndexStats()) writeFrame();
+
+	while(_totalReads <= _options.wallReadCount) {
+		if(!nextAlignment(reader, alignment)) {
+			exhausted = true;
+			break;
+		}
+		if(!_sampler.accept(alignment)) continue;
+
+		_totalReads++;
+		_rootCollector.processAlignment(alignment, refVector);
+
+		if(_options.memoryLimit > 0 && _totalReads % kMemoryCheckInterval == 0) checkMemory();
+
+		if((_totalReads > 0 && _totalReads % _options.updateRate == 0)) {
+			writeFrame();
+			if(_collectors.histogram) _collectors.histogram->advanceResolution();
+			fpsModulator.redraw();
+
+			// nobody is listening anymore
+			if(!_writer.isGood()) return;
+		}
+	}
+	// count for all regions from which no read came
+	if(_trackCollector && exhausted) _trackCollector->endTargets();
+	if(_collectors.ploidy && exhausted) _collectors.ploidy->endInput();
+
+	// the last frame is reported at full resolution
+	if(_collectors.histogram) _collectors.histogram->setProgressive(false);
+	writeFrame(true);
+}
+
+void StatsJob::runBatch(AlignmentReader& reader, const BamTools::RefVector& refVector) {
+	BamTools::BamAlignment alignment;
+	bool hasPendingAlignment = false;
+
+	StatsSidecar * sidecar = NULL;
+	StatsSidecar::CheckpointT checkpoint;
+
+	if(!_options.sidecarDir.empty()) {
+		sidecar = new StatsSidecar(_options.sidecarDir, _filename, _options.sidecarKey, reader.headerText());
+
+		if(sidecar->isUsable() && sidecar->load(checkpoint, _rootCollector)) {
+			LOGS<<"Resuming from sidecar at "<<checkpoint.totalReads<<" reads"<<std::endl;
+			_totalReads = checkpoint.totalReads;
+
+			if(checkpoint.complete) {
+				writeFrame(true);
+				delete sidecar;
+				return;
+			}
+
+			hasPendingAlignment = resumeFromCheckpoint(reader, checkpoint, alignment);
+		}
+	}
+
+	// identify each read by its position and how many reads preceded it there
+	int32_t lastRefID = checkpoint.refID;
+	int32_t lastPosition = checkpoint.position;
+	unsigned int readsAtLastPosition = checkpoint.readsAtPosition;
+	unsigned int readsSinceCheckpoint = 0;
+
+	while(hasPendingAlignment || nextAlignment(reader, alignment)) {
+		hasPendingAlignment = false;
+
+		unsigned int readsAtPosition = 0;
+		if(alignment.RefID == lastRefID && alignment.Position == lastPosition)
+			readsAtPosition = readsAtLastPosition;
+
+		if(sidecar && sidecar->isUsable()
+				&& readsSinceCheckpoint >= kSidecarCheckpointInterval
+				&& (!_collectors.histogram || _collectors.histogram->isBetweenRegions())) {
+			checkpoint.refID = alignment.RefID;
+			checkpoint.position = alignment.Position;
+			checkpoint.readsAtPosition = readsAtPosition;
+			checkpoint.totalReads = _totalReads;
+			sidecar->save(checkpoint, _rootCollector);
+			readsSinceCheckpoint = 0;
+		}
+
+		_totalReads++;
+		readsSinceCheckpoint++;
+		_rootCollector.processAlignment(alignment, refVector);
+
+		if(_options.memoryLimit > 0 && _totalReads % kMemoryCheckInterval == 0) checkMemory();
+
+		lastRefID = alignment.RefID;
+		lastPosition = alignment.Position;
+		readsAtLastPosition = readsAtPosition + 1;
+	}
+
+	if(_trackCollector) _trackCollector->endTargets();
+	if(_collectors.ploidy) _collectors.ploidy->endInput();
+
+	if(sidecar) {
+		checkpoint.totalReads = _totalReads;
+		checkpoint.complete = true;
+		if(sidecar->isUsable()) sidecar->save(checkpoint, _rootCollector);
+		delete sidecar;
+	}
+
+	writeFrame(true);
+}
+
+void StatsJob::runTargeted(AlignmentReader& reader, const BamTools::RefVector& refVector) {
+
+	BamTools::SamHeader header = reader.header();
+
+	if(header.SortOrder != "coordinate") {
+		_writer.writeError("Targeted mode needs a coordinate sorted input", _tagFrames ? _sampleId : "");
+		return;
+	}
+
+	TargetVec targets = TargetCoverageStatsCollector::mergeRegions(*_regionStore, refVector);
+
+	// without an index, a single worker reads the input through
+	bool canSeek = !targets.empty() && targets.front().refID >= 0
+		&& reader.seek(targets.front().refID, targets.front().startPos);
+
+	WorkerPool pool(canSeek ? _options.targetThreads : 1);
+
+	/* cut the targets into chunks of about the same length */
+
+	uint64_t totalLength = 0;
+	for(size_t i=0; i<targets.size(); i++) totalLength += targets[i].endPos - targets[i].startPos + 1;
+
+	size_t chunkCount = canSeek ? std::min(targets.size(), kTargetChunks) : 1;
+
+	std::vector<size_t> chunkStarts(1, 0);
+	uint64_t accumulatedLength = 0;
+	for(size_t i=0; i+1<targets.size() && chunkStarts.size()<chunkCount; i++) {
+		accumulatedLength += targets[i].endPos - targets[i].startPos + 1;
+		if(accumulatedLength * chunkCount >= totalLength * chunkStarts.size()) chunkStarts.push_back(i + 1);
+	}
+	chunkStarts.push_back(targets.size());
+
+	LOGS<<targets.size()<<" targets in "<<chunkStarts.size() - 1<<" chunks on "<<pool.size()<<" threads"<<std::endl;
+
+	/* every worker sweeps chunks with its own reader until none are left */
+
+	// each chunk is collected into a tree of its own, and the trees are
+	// merged in chunk order as they complete, so the statistics come out
+	// the same however many workers swept which chunks
+	std::atomic<size_t> nextChunk(0);
+	AlignmentReaderOptionsT options = readerOptions();
+	std::vector<TargetChunkT *> chunkTrees(chunkStarts.size() - 1, NULL);
+	size_t nextMerge = 0;
+	std::mutex mergeMutex;
+
+	auto sweepChunk = [&](AlignmentReader& chunkReader, size_t chunk) {
+		TargetChunkT * tree = new TargetChunkT(_chromIDNameMap, *_regionStore, _options);
+		if(tree->readGroups) tree->readGroups->setReadGroups(header);
+
+		PerfCounters * previousCounters = PerfCounters::current();
+		PerfCounters::setCurrent(&tree->perfCounters);
+		sweepTargets(*tree, chunkReader, targets, chunkStarts[chunk], chunkStarts[chunk + 1], canSeek);
+		PerfCounters::setCurrent(previousCounters);
+
+		std::lock_guard<std::mutex> lock(mergeMutex);
+		chunkTrees[chunk] = tree;
+		for(; nextMerge < chunkTrees.size() && chunkTrees[nextMerge] != NULL; nextMerge++) {
+			_rootCollector.merge(chunkTrees[nextMerge]->root);
+			_totalReads += chunkTrees[nextMerge]->reads;
+			_perfCounters.merge(chunkTrees[nextMerge]->perfCounters);
+			delete chunkTrees[nextMerge];
+			chunkTrees[nextMerge] = NULL;
+		}
+
+		if(_options.memoryLimit > 0) checkMemory();
+	};
+
+	for(size_t w=0; w<pool.size(); w++) {
+		pool.submit([&]() {
+			AlignmentReader * workerReader = canSeek ? AlignmentReader::open(_filename, options) : &reader;
+			if(workerReader == NULL) return;
+
+			size_t chunk;
+			while((chunk = nextChunk++) + 1 < chunkStarts.size()) sweepChunk(*workerReader, chunk);
+
+			if(workerReader != &reader) delete workerReader;
+		});
+	}
+
+	pool.wait();
+
+	// in case no worker could open the input again
+	size_t chunk;
+	while((chunk = nextChunk++) + 1 < chunkStarts.size()) sweepChunk(reader, chunk);
+
+	writeFrame(true);
+}
+
+bool StatsJob::resumeFromCheckpoint(AlignmentReader& reader, const StatsSidecar::CheckpointT& checkpoint, BamTools::BamAlignment& alignment) {
+
+	bool canJump = checkpoint.refID >= 0
+		&& reader.header().SortOrder == "coordinate"
+		&& reader.jump(checkpoint.refID, checkpoint.position);
+
+	if(canJump) {
+		unsigned int skippedAtPosition = 0;
+		while(reader.getNextAlignmentCore(alignment)) {
+			if(alignment.RefID == checkpoint.refID && alignment.Position < checkpoint.position) continue;
+			if(alignment.RefID == checkpoint.refID && alignment.Position == checkpoint.position
+					&& skippedAtPosition < checkpoint.readsAtPosition) {
+				skippedAtPosition++;
+				continue;
+			}
+
+			reader.buildCharData(alignment);
+			return true;
+		}
+		return false;
+	}
+
+	// otherwise skip the processed reads without decoding their data
+	LOGS<<"Sidecar resume without index, skipping "<<checkpoint.totalReads<<" reads"<<std::endl;
+	for(unsigned int i=0; i<checkpoint.totalReads; i++) {
+		if(!reader.getNextAlignmentCore(alignment)) break;
+	}
+	return false;
+}
+
+json_t * StatsJob::perfJson() {
+	if(_prefetcher) _perfCounters.setInputStall(_prefetcher->stallNs(), _prefetcher->blocks());
+	return _perfCounters.toJson();
+}
+
+void StatsJob::checkMemory() {
+	size_t usage = _rootCollector.memoryUsage();
+	_peakCollectorBytes = std::max(_peakCollectorBytes, usage);
+
+	while(usage > _options.memoryLimit) {
+		if(!_rootCollector.shedMemory()) break;
+		_memorySheds++;
+
+		size_t shedUsage = _rootCollector.memoryUsage();
+		LOGS<<"Collectors hold "<<usage<<" bytes over the limit of "<<_options.memoryLimit<<", now "<<shedUsage<<std::endl;
+		usage = shedUsage;
+	}
+}
+
+json_t * StatsJob::memoryJson() const {
+	json_t * j_memory = json_object();
+
+	json_t * j_collectors = json_object();
+	_rootCollector.appendMemoryJson(j_collectors);
+	json_object_set_new(j_memory, "collectors", j_collectors);
+
+	json_object_set_new(j_memory, "collector_bytes", json_integer(_rootCollector.memoryUsage()));
+	json_object_set_new(j_memory, "peak_collector_bytes", json_integer(_peakCollectorBytes));
+	if(_options.memoryLimit > 0) json_object_set_new(j_memory, "limit_bytes", json_integer(_options.memoryLimit));
+	json_object_set_new(j_memory, "shed_steps", json_integer(_memorySheds));
+	return j_memory;
+}
+
+void StatsJob::writeFrame(bool final) {
+	_peakCollectorBytes = std::max(_peakCollectorBytes, _rootCollector.memoryUsage());
+
+	json_t * perfObj = PerfCounters::kEnabled ? perfJson() : NULL;
+	_writer.writeFrame(_rootCollector, _tagFrames ? _sampleId : "", perfObj, final ? memoryJson() : NULL);
+}
+
+void StatsJob::merge(const StatsJob& other) {
+	_rootCollector.merge(other._rootCollector);
+	_totalReads += other._totalReads;
+}
@@ -0,0 +1,216 @@
+#ifndef STATSJOB_H
+#define STATSJOB_H
+
+#pragma once
+
+#include "BasicStatsCollector.h"
+#include "CollectorRegistry.h"
+#include "TargetCoverageStatsCollector.h"
+#include "ReadGroupStatsCollector.h"
+#include "CoverageTrackStatsCollector.h"
+#include "GenomicRegionStore.h"
+#include "FrameWriter.h"
+#include "StatsSidecar.h"
+#include "PerfCounters.h"
+#include "AlignmentReader.h"
+#include "ReadSampler.h"
+#include "InputPrefetcher.h"
+
+namespace BamstatsAlive {
+
+	typedef struct _statsJobOptionsT {
+		unsigned int updateRate;
+		unsigned int firstUpdateRate;
+		size_t fps;
+		unsigned int wallReadCount;
+		unsigned int coverageSkipFactor;
+		bool isBatch;
+		std::string sidecarDir;
+		std::string sidecarKey;
+		std::string reference;
+		unsigned int decodeThreads;
+		ReadSampler::ModeT samplingMode;
+		double samplingFraction;
+		/** Only read the reads in the regions, through the index; implies isBatch */
+		bool isTargeted;
+		/** Threads reading the regions of a targeted job, 0 for one per hardware thread */
+		unsigned int targetThreads;
+		/** Report quantiles in place of the fragment, read length and mapping quality histograms */
+		bool summaryOnly;
+		/** Depths counted exactly in the coverage histogram, deeper ones in log bins */
+		unsigned int coverageCap;
+		/** Bin size of the finest coverage track, 0 for no tracks */
+		unsigned int trackBinSize;
+		/** Read the MD and NM tags for mismatches, which needs tags decoded */
+		bool mismatchTags;
+		/** The CollectorRegistry::CollectorT bits of the statistics asked for */
+		unsigned int collectors;
+		/** Pair mates by name rather than by position; also set when the header says the input is not coordinate sorted */
+		bool nameSorted;
+		/** Also report the statistics per read group or library */
+		ReadGroupStatsCollector::ModeT partitionMode;
+		/** In live mode, report coarse histograms first and refine them as the distributions settle */
+		bool progressive;
+		/** Bytes the collectors may hold before giving up precision, 0 for no limit */
+		size_t memoryLimit;
+		/** The job is merged into a cohort aggregate afterwards, so what was reported is not shed */
+		bool isMerged;
+		/** The known variant sites alleles are counted at, or NULL */
+		const VariantSiteList * variantSites;
+		/** Bytes of stdin read ahead of the decoder on a thread of its own, 0 to read it directly */
+		size_t prefetchBytes;
+
+		_statsJobOptionsT() :
+			updateRate(100), firstUpdateRate(0), fps(0),
+			wallReadCount(400000), coverageSkipFactor(10), isBatch(false),
+			decodeThreads(0), samplingMode(ReadSampler::kSampleNone), samplingFraction(1.0),
+			isTargeted(false), targetThreads(1), summaryOnly(false),
+			coverageCap(CoverageHistogram::kDefaultExactDepths), trackBinSize(0), mismatchTags(false),
+			collectors(CollectorRegistry::kDefaultCollectors), nameSorted(false),
+			partitionMode(ReadGroupStatsCollector::kPartitionNone), progressive(false),
+			memoryLimit(0), isMerged(false), variantSites(NULL), prefetchBytes(64 << 20)
+		{}
+	} StatsJobOptionsT;
+
+	/**
+	 * Statistics collection over a single alignment input
+	 *
+	 * A job owns the collector tree for one input file (or stdin), reads the
+	 * alignments through it and emits frames to a FrameWriter, either
+	 * periodically (live mode) or once at the end (batch mode). The region
+	 * store is only read, so it can be shared by jobs running concurrently.
+	 */
+	class StatsJob {
+		protected:
+			std::string _filename;
+			std::string _sampleId;
+			bool _tagFrames;
+			StatsJobOptionsT _options;
+			FrameWriter& _writer;
+
+			const GenomicRegionStore * _regionStore;
+			std::map<int32_t, std::string> _chromIDNameMap;
+			BasicStatsCollector _rootCollector;
+			CollectorSet _collectors;
+			ReadGroupStatsCollector * _readGroupCollector;
+			TargetCoverageStatsCollector * _targetCoverageCollector;
+			CoverageTrackStatsCollector * _trackCollector;
+			TargetCoverageStatsCollector::TargetVec _trackTargets;
+
+			unsigned int _totalReads;
+			unsigned int _memorySheds;
+			/** The most bytes the collectors were seen holding, at a memory check or a frame */
+			size_t _peakCollectorBytes;
+			PerfCounters _perfCounters;
+			ReadSampler _sampler;
+			InputPrefetcher * _prefetcher;
+
+			/**
+			 * The perf counters as json, with the input stall when prefetching
+			 */
+			json_t * perfJson();
+
+			/**
+			 * Have the collectors give up precision until they hold less
+			 * memory than the limit, or cannot hold any less
+			 */
+			void checkMemory();
+
+			/**
+			 * The memory held by every collector
+			 */
+			json_t * memoryJson() const;
+
+			/**
+			 * Read the next alignment, accounting for it in the perf counters
+			 */
+			inline bool nextAlignment(AlignmentReader& reader, BamTools::BamAlignment& alignment) {
+				BSA_PERF_SCOPE(PerfCounters::kStageDecode);
+				if(!reader.getNextAlignment(alignment)) return false;
+				if(PerfCounters::kEnabled) _perfCounters.addRead(PerfCounters::recordBytes(alignment));
+				return true;
+			}
+
+			/**
+			 * The reader settings decoding only what the collectors need
+			 */
+			AlignmentReaderOptionsT readerOptions() const;
+
+			void runLive(AlignmentReader& reader, const BamTools::RefVector& refVector);
+			void runBatch(AlignmentReader& reader, const BamTools::RefVector& refVector);
+
+			/**
+			 * Process only the reads overlapping the regions
+			 *
+			 * The regions are merged into targets and cut into chunks, which
+			 * are read in parallel, each worker seeking to its targets through
+			 * the index with a reader of its own. A read belongs to the first
+			 * target it overlaps: only that target's chunk passes it to the
+			 * collectors, the others only count its coverage. Without an index,
+			 * the whole input is swept by one worker.
+			 *
+			 * The chunks do not depend on the number of workers, and are
+			 * collected apart and merged in order, so the statistics are the
+			 * same whatever the number of threads.
+			 */
+			void runTargeted(AlignmentReader& reader, const BamTools::RefVector& refVector);
+
+			/**
+			 * Position the reader right after a sidecar checkpoint
+			 *
+			 * @return true if alignment holds the next read to process
+			 */
+			bool resumeFromCheckpoint(AlignmentReader& reader, const StatsSidecar::CheckpointT& checkpoint, BamTools::BamAlignment& alignment);
+
+		public:
+			/**
+			 * @param filename The input path, "-" for stdin
+			 * @param options Update rates and mode of the job
+			 * @param regionStore The regions for coverage statistics, or NULL
+			 * @param writer The writer frames are sent to
+			 * @param tagFrames Whether frames carry the sample ID
+			 */
+			StatsJob(const std::string& filename,
+					const StatsJobOptionsT& options,
+					const GenomicRegionStore * regionStore,
+					FrameWriter& writer,
+					bool tagFrames = false);
+			~StatsJob();
+
+			/**
+			 * The key sidecars of a job are stored under: everything besides
+			 * the input that changes the statistics
+			 *
+			 * @param options The options of the job
+			 * @param regionStore The regions of the job, or NULL
+			 */
+			static std::string sidecarKey(const StatsJobOptionsT& options, const GenomicRegionStore * regionStore);
+
+			/**
+			 * Process the whole input and emit frames
+			 *
+			 * @return false if the input cannot be opened, true otherwise
+			 */
+			bool run();
+
+			/**
+			 * Write the current statistics as one frame
+			 *
+			 * @param final Whether this is the last frame, which also reports the memory usage
+			 */
+			void writeFrame(bool final = false);
+
+			/**
+			 * Add the statistics of another job into this one
+			 *
+			 * @param other A job that has finished running
+			 */
+			void merge(const StatsJob& other);
+
+			inline const std::string& sampleId() const { return _sampleId; }
+			inline void setSampleId(const std::string& sampleId) { _sampleId = sampleId; }
+			inline unsigned int totalReads() const { return _totalReads; }
+	};
+}
+
+#endif
@@ -0,0 +1,264 @@
+#include "StatsServer.h"
+#include "FdOutputStream.h"
+#include "FrameWriter.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <signal.h>
+#include <cerrno>
+#include <fstream>
+
+using namespace BamstatsAlive;
+
+static const size_t kMaxRequestLength = 64 * 1024 * 1024;
+static const size_t kRegionCacheCapacity = 32;
+
+/**
+ * Read the request line, along with a file descriptor if one is passed
+ */
+static bool receiveRequest(int connectionFd, std::string& request, int& passedFd) {
+	char buffer[4096];
+	char control[CMSG_SPACE(sizeof(int))];
+
+	passedFd = -1;
+
+	while(request.find('\n') == std::string::npos) {
+		struct iovec iov;
+		iov.iov_base = buffer;
+		iov.iov_len = sizeof(buffer);
+
+		struct msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		ssize_t received = recvmsg(connectionFd, &msg, 0);
+		if(received < 0 && errno == EINTR) continue;
+		if(received <= 0) break;
+
+		for(struct cmsghdr * cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			if(cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+
+			int fd;
+			memcpy(&fd, CMSG_DATA(cmsg), sizeof(fd));
+			if(passedFd < 0) passedFd = fd;
+			else close(fd);
+		}
+
+		request.append(buffer, received);
+		if(request.length() > kMaxRequestLength) return false;
+	}
+
+	size_t newline = request.find('\n');
+	if(newline != std::string::npos) request.erase(newline);
+
+	return !request.empty();
+}
+
+StatsServer::StatsServer(const std::string& socketPath, size_t threadCount, const StatsJobOptionsT& defaultOptions) :
+	_socketPath(socketPath),
+	_defaultOptions(defaultOptions),
+	_pool(threadCount)
+{
+}
+
+StatsServer::RegionStorePtrT StatsServer::regionStore(const std::string& regionJson) {
+	std::lock_guard<std::mutex> lock(_regionCacheMutex);
+
+	auto cached = _regionCache.find(regionJson);
+	if(cached != _regionCache.end()) return cached->second;
+
+	RegionStorePtrT store;
+	try {
+		store = RegionStorePtrT(new GenomicRegionStore(regionJson));
+	}
+	catch(...) {
+		return RegionStorePtrT();
+	}
+
+	// stores still used by running jobs stay alive through their pointers
+	if(_regionCache.size() >= kRegionCacheCapacity) _regionCache.clear();
+	_regionCache[regionJson] = store;
+
+	return store;
+}
+
+void StatsServer::serveConnection(int connectionFd) {
+	FdOutputStream out(connectionFd);
+	FrameWriter writer(out);
+
+	std::string request;
+	int passedFd = -1;
+
+	json_t * j_request = NULL;
+	json_error_t error;
+
+	if(!receiveRequest(connectionFd, request, passedFd) || (j_request = json_loads(request.c_str(), 0, &error)) == NULL || !json_is_object(j_request)) {
+		writer.writeError("Cannot parse job description");
+		if(j_request) json_decref(j_request);
+		if(passedFd >= 0) close(passedFd);
+		return;
+	}
+
+	/* assemble the job from the request on top of the defaults */
+
+	StatsJobOptionsT options = _defaultOptions;
+	json_t * value;
+
+	if((value = json_object_get(j_request, "update_rate")) && json_is_integer(value))
+		options.updateRate = json_integer_value(value);
+	if((value = json_object_get(j_request, "first_update_rate")) && json_is_integer(value))
+		options.firstUpdateRate = json_integer_value(value);
+	if((value = json_object_get(j_request, "fps")) && json_is_integer(value))
+		options.fps = json_integer_value(value);
+	if((value = json_object_get(j_request, "skip_factor")) && json_is_integer(value))
+		options.coverageSkipFactor = json_integer_value(value);
+	if((value = json_object_get(j_request, "batch")) && json_is_true(value)) {
+		options.isBatch = true;
+		options.coverageSkipFactor = 1;
+	}
+	if((value = json_object_get(j_request, "targeted")) && json_is_true(value)) {
+		options.isTargeted = true;
+		options.isBatch = true;
+	}
+	if((value = json_object_get(j_request, "summary_only")) && json_is_true(value))
+		options.summaryOnly = true;
+	if((value = json_object_get(j_request, "track_bin_size")) && json_is_integer(value))
+		options.trackBinSize = json_integer_value(value);
+	if((value = json_object_get(j_request, "coverage_cap")) && json_is_integer(value)) {
+		if(json_integer_value(value) <= 0) {
+			writer.writeError("The coverage cap has to be positive");
+			json_decref(j_request);
+			if(passedFd >= 0) close(passedFd);
+			return;
+		}
+		options.coverageCap = std::min(json_integer_value(value), static_cast<json_int_t>(CoverageHistogram::kMaxExactDepths));
+	}
+	if((value = json_object_get(j_request, "mismatch_tags")) && json_is_true(value))
+		options.mismatchTags = true;
+	if((value = json_object_get(j_request, "progressive")) && json_is_true(value))
+		options.progressive = true;
+	if((value = json_object_get(j_request, "mem_limit")) && json_is_integer(value))
+		options.memoryLimit = static_cast<size_t>(json_integer_value(value)) << 20;
+	if((value = json_object_get(j_request, "name_sorted")) && json_is_true(value))
+		options.nameSorted = true;
+	if((value = json_object_get(j_request, "collectors")) && json_is_string(value)
+			&& !CollectorRegistry::parseSelection(json_string_value(value), options.collectors)) {
+		writer.writeError("Cannot parse collector selection");
+		json_decref(j_request);
+		if(passedFd >= 0) close(passedFd);
+		return;
+	}
+	if((value = json_object_get(j_request, "gc")) && json_is_true(value))
+		options.collectors |= CollectorRegistry::kCollectGc;
+	if((value = json_object_get(j_request, "partition")) && json_is_string(value)
+			&& !ReadGroupStatsCollector::parseMode(json_string_value(value), options.partitionMode)) {
+		writer.writeError("Cannot parse partitioning mode");
+		json_decref(j_request);
+		if(passedFd >= 0) close(passedFd);
+		return;
+	}
+	if((value = json_object_get(j_request, "sampling")) && json_is_string(value)
+			&& !ReadSampler::parseSpec(json_string_value(value), options.samplingMode, options.samplingFraction)) {
+		writer.writeError("Cannot parse sampling specification");
+		json_decref(j_request);
+		if(passedFd >= 0) close(passedFd);
+		return;
+	}
+
+	// an input passed along with the request takes precedence over a path
+	std::string filename;
+	if(passedFd >= 0) {
+		std::stringstream fdPathSS; fdPathSS << "/dev/fd/" << passedFd;
+		filename = fdPathSS.str();
+	}
+	else if((value = json_object_get(j_request, "file")) && json_is_string(value)) {
+		filename = json_string_value(value);
+
+		// stdin is the server's own, shared by every job
+		if(filename == "-") {
+			writer.writeError("Pass stdin input as a file descriptor rather than as -");
+			json_decref(j_request);
+			return;
+		}
+	}
+
+	std::string regionJson;
+	if((value = json_object_get(j_request, "regions")) && json_is_array(value)) {
+		char * dumped = json_dumps(value, JSON_COMPACT);
+		regionJson = dumped;
+		free(dumped);
+	}
+	else if((value = json_object_get(j_request, "regions_file")) && json_is_string(value)) {
+		std::ifstream fs(json_string_value(value));
+		regionJson = std::string((std::istreambuf_iterator<char>(fs)), std::istreambuf_iterator<char>());
+	}
+
+	json_decref(j_request);
+
+	RegionStorePtrT store;
+	if(!regionJson.empty()) {
+		store = regionStore(regionJson);
+		if(!store) {
+			writer.writeError("Cannot parse region json string");
+			if(passedFd >= 0) close(passedFd);
+			return;
+		}
+	}
+
+	// the sidecars of a request are its own, as the options and regions vary
+	if(!options.sidecarDir.empty())
+		options.sidecarKey = StatsJob::sidecarKey(options, store.get());
+
+	if(filename.empty()) {
+		writer.writeError("No input specified");
+	}
+	else {
+		StatsJob job(filename, options, store.get(), writer);
+		if(!job.run()) writer.writeError("Cannot open the specified file");
+	}
+
+	if(passedFd >= 0) close(passedFd);
+}
+
+bool StatsServer::run() {
+	// a client going away must not take the server down
+	signal(SIGPIPE, SIG_IGN);
+
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if(_socketPath.length() >= sizeof(address.sun_path)) return false;
+	strncpy(address.sun_path, _socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+	int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(listenFd < 0) return false;
+
+	unlink(_socketPath.c_str());
+	if(bind(listenFd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0 || listen(listenFd, 128) != 0) {
+		close(listenFd);
+		return false;
+	}
+
+	LOGS<<"Listening on "<<_socketPath<<" with "<<_pool.size()<<" workers"<<std::endl;
+
+	while(true) {
+		int connectionFd = accept(listenFd, NULL, NULL);
+		if(connectionFd < 0) {
+			if(errno == EINTR || errno == ECONNABORTED) continue;
+			break;
+		}
+
+		// connections beyond the pool size wait in the queue
+		_pool.submit([this, connectionFd]() {
+			serveConnection(connectionFd);
+			close(connectionFd);
+		});
+	}
+
+	close(listenFd);
+	return false;
+}
@@ -0,0 +1,67 @@
+#ifndef STATSSERVER_H
+#define STATSSERVER_H
+
+#pragma once
+
+#include "StatsJob.h"
+#include "WorkerPool.h"
+#include "GenomicRegionStore.h"
+
+#include <memory>
+#include <mutex>
+
+namespace BamstatsAlive {
+
+	/**
+	 * Long running server executing statistics jobs for many clients
+	 *
+	 * The server listens on a Unix domain socket. A client connects and
+	 * sends a single line of json describing the job, optionally passing
+	 * the input as a file descriptor along with it (SCM_RIGHTS), and then
+	 * receives the frames of the job on the same connection until the
+	 * server closes it. For example:
+	 *
+	 *   {"file":"/data/a.bam", "regions":[{"chr":"1","start":100,"end":200}], "batch":true}
+	 *
+	 * Jobs run on a fixed size worker pool, which caps the concurrency of
+	 * the host. Parsed region sets are cached and shared read-only by all
+	 * jobs using the same regions.
+	 */
+	class StatsServer {
+		private:
+			typedef std::shared_ptr<const GenomicRegionStore> RegionStorePtrT;
+
+			std::string _socketPath;
+			StatsJobOptionsT _defaultOptions;
+			WorkerPool _pool;
+
+			std::mutex _regionCacheMutex;
+			std::map<std::string, RegionStorePtrT> _regionCache;
+
+			/**
+			 * Look up a region set in the cache, parsing it on a miss
+			 *
+			 * @return The region store, NULL if the json cannot be parsed
+			 */
+			RegionStorePtrT regionStore(const std::string& regionJson);
+
+			void serveConnection(int connectionFd);
+
+		public:
+			/**
+			 * @param socketPath The path of the Unix domain socket
+			 * @param threadCount Maximum number of jobs running at once
+			 * @param defaultOptions The options of jobs not overridden in the request
+			 */
+			StatsServer(const std::string& socketPath, size_t threadCount, const StatsJobOptionsT& defaultOptions);
+
+			/**
+			 * Accept connections until an unrecoverable error occurs
+			 *
+			 * @return false if the socket cannot be set up or accepting fails
+			 */
+			bool run();
+	};
+}
+
+#endif
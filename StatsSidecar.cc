@@ -0,0 +1,118 @@
+#include "StatsSidecar.h"
+
+#include <sys/stat.h>
+#include <cstdio>
+
+using namespace BamstatsAlive;
+
+static const int kSidecarVersion = 1;
+
+static std::string hexHash(const std::string& data) {
+	char buffer[17];
+	snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(StatsSidecar::hash(data)));
+	return std::string(buffer);
+}
+
+uint64_t StatsSidecar::hash(const std::string& data) {
+	// 64 bit FNV-1a, stable across builds unlike std::hash
+	uint64_t h = 14695981039346656037ULL;
+	for(size_t i=0; i<data.length(); i++) {
+		h ^= static_cast<unsigned char>(data[i]);
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+StatsSidecar::StatsSidecar(const std::string& cacheDir,
+		const std::string& bamPath,
+		const std::string& optionsKey,
+		const std::string& headerText) :
+	_usable(false), _fileSize(0), _mtime(0)
+{
+	if(cacheDir.empty() || bamPath.empty() || bamPath == "-") return;
+
+	char * resolved = realpath(bamPath.c_str(), NULL);
+	if(resolved == NULL) return;
+	_bamPath = resolved;
+	free(resolved);
+
+	struct stat st;
+	if(stat(_bamPath.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return;
+	_fileSize = st.st_size;
+	_mtime = st.st_mtime;
+
+	_headerHash = hexHash(headerText);
+	_optionsHash = hexHash(optionsKey);
+	_sidecarPath = cacheDir + "/" + hexHash(_bamPath) + ".bsa.json";
+	_usable = true;
+}
+
+bool StatsSidecar::load(CheckpointT& checkpoint, AbstractStatCollector& rootStatCollector) {
+	if(!_usable) return false;
+
+	json_error_t error;
+	json_t * root = json_load_file(_sidecarPath.c_str(), 0, &error);
+	if(!root) return false;
+
+	const char * path = json_string_value(json_object_get(root, "path"));
+	const char * headerHash = json_string_value(json_object_get(root, "header_hash"));
+	const char * optionsHash = json_string_value(json_object_get(root, "options_hash"));
+
+	bool matches = json_integer_value(json_object_get(root, "version")) == kSidecarVersion
+		&& path && _bamPath == path
+		&& static_cast<uint64_t>(json_integer_value(json_object_get(root, "size"))) == _fileSize
+		&& json_integer_value(json_object_get(root, "mtime")) == _mtime
+		&& headerHash && _headerHash == headerHash
+		&& optionsHash && _optionsHash == optionsHash;
+
+	const json_t * j_checkpoint = json_object_get(root, "checkpoint");
+
+	if(!matches || !json_is_object(j_checkpoint) || !rootStatCollector.loadState(json_object_get(j_checkpoint, "state"))) {
+		LOGS<<"Ignoring stale sidecar "<<_sidecarPath<<std::endl;
+		json_decref(root);
+		return false;
+	}
+
+	checkpoint.refID = json_integer_value(json_object_get(j_checkpoint, "ref_id"));
+	checkpoint.position = json_integer_value(json_object_get(j_checkpoint, "position"));
+	checkpoint.readsAtPosition = json_integer_value(json_object_get(j_checkpoint, "reads_at_position"));
+	checkpoint.totalReads = json_integer_value(json_object_get(j_checkpoint, "total_reads"));
+	checkpoint.complete = json_is_true(json_object_get(j_checkpoint, "complete"));
+
+	json_decref(root);
+	return true;
+}
+
+bool StatsSidecar::save(const CheckpointT& checkpoint, AbstractStatCollector& rootStatCollector) {
+	if(!_usable) return false;
+
+	json_t * root = json_object();
+	json_object_set_new(root, "version", json_integer(kSidecarVersion));
+	json_object_set_new(root, "path", json_string(_bamPath.c_str()));
+	json_object_set_new(root, "size", json_integer(_fileSize));
+	json_object_set_new(root, "mtime", json_integer(_mtime));
+	json_object_set_new(root, "header_hash", json_string(_headerHash.c_str()));
+	json_object_set_new(root, "options_hash", json_string(_optionsHash.c_str()));
+
+	json_t * j_checkpoint = json_object();
+	json_object_set_new(j_checkpoint, "ref_id", json_integer(checkpoint.refID));
+	json_object_set_new(j_checkpoint, "position", json_integer(checkpoint.position));
+	json_object_set_new(j_checkpoint, "reads_at_position", json_integer(checkpoint.readsAtPosition));
+	json_object_set_new(j_checkpoint, "total_reads", json_integer(checkpoint.totalReads));
+	json_object_set_new(j_checkpoint, "complete", checkpoint.complete ? json_true() : json_false());
+	json_object_set_new(j_checkpoint, "state", rootStatCollector.saveState());
+	json_object_set_new(root, "checkpoint", j_checkpoint);
+
+	// write aside and rename, so readers never see a partial sidecar
+	std::string tmpPath = _sidecarPath + ".tmp";
+	bool written = json_dump_file(root, tmpPath.c_str(), JSON_COMPACT) == 0
+		&& rename(tmpPath.c_str(), _sidecarPath.c_str()) == 0;
+	json_decref(root);
+
+	if(!written) {
+		LOGS<<"Cannot write sidecar "<<_sidecarPath<<std::endl;
+		unlink(tmpPath.c_str());
+	}
+
+	return written;
+}
@@ -0,0 +1,87 @@
+#ifndef STATSSIDECAR_H
+#define STATSSIDECAR_H
+
+#pragma once
+
+#include "AbstractStatCollector.h"
+
+#include <stdint.h>
+
+namespace BamstatsAlive {
+
+	/**
+	 * Persistent cache of collector state for a BAM file
+	 *
+	 * The sidecar lives in a cache directory and is keyed by the resolved
+	 * BAM path, its size, modification time and a hash of its header, plus
+	 * a key describing the options that influence the statistics. It holds
+	 * the state of the collector tree at the latest checkpoint, so a
+	 * finished file is answered without reading it, and an interrupted run
+	 * resumes where the checkpoint was taken.
+	 *
+	 * A checkpoint names the next read to process by reference, position
+	 * and the number of reads at that position that were already processed,
+	 * as BamTools does not expose BGZF virtual offsets.
+	 */
+	class StatsSidecar {
+		public:
+			typedef struct _checkpointT {
+				int32_t refID;
+				int32_t position;
+				unsigned int readsAtPosition;
+				unsigned int totalReads;
+				bool complete;
+
+				_checkpointT() :
+					refID(-1), position(-1), readsAtPosition(0), totalReads(0), complete(false)
+				{}
+			} CheckpointT;
+
+			static uint64_t hash(const std::string& data);
+
+		private:
+			bool _usable;
+			std::string _sidecarPath;
+			std::string _bamPath;
+			uint64_t _fileSize;
+			int64_t _mtime;
+			std::string _headerHash;
+			std::string _optionsHash;
+
+		public:
+			/**
+			 * @param cacheDir The directory sidecars are kept in
+			 * @param bamPath The path of the BAM file
+			 * @param optionsKey Serialized options that affect the statistics
+			 * @param headerText The SAM header text of the BAM file
+			 */
+			StatsSidecar(const std::string& cacheDir,
+					const std::string& bamPath,
+					const std::string& optionsKey,
+					const std::string& headerText);
+
+			/** Whether the input can be cached at all, e.g. stdin cannot */
+			inline bool isUsable() const { return _usable; }
+			inline const std::string& path() const { return _sidecarPath; }
+
+			/**
+			 * Load the latest checkpoint into a collector tree
+			 *
+			 * @param checkpoint Receives the position the state corresponds to
+			 * @param rootStatCollector The root of the tree to restore
+			 * @return false if there is no sidecar matching the file and options
+			 */
+			bool load(CheckpointT& checkpoint, AbstractStatCollector& rootStatCollector);
+
+			/**
+			 * Replace the sidecar with a new checkpoint
+			 *
+			 * @param checkpoint The position the state corresponds to
+			 * @param rootStatCollector The root of the tree to save
+			 * @return false if the sidecar cannot be written
+			 */
+			bool save(const CheckpointT& checkpoint, AbstractStatCollector& rootStatCollector);
+	};
+}
+
+#endif
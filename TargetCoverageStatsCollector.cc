@@ -0,0 +1,273 @@
+#include "TargetCoverageStatsCollector.h"
+#include "PerfCounters.h"
+
+using namespace BamstatsAlive;
+using namespace std;
+
+const size_t TargetCoverageStatsCollector::kNoTarget = static_cast<size_t>(-1);
+
+// references missing from the input (-1) sort after all the others
+static inline uint32_t refOrder(int32_t refID) { return static_cast<uint32_t>(refID); }
+
+// whether the target ends before the position
+static inline bool isBefore(const TargetCoverageStatsCollector::TargetT& target, int32_t refID, int32_t pos) {
+	return refOrder(target.refID) < refOrder(refID) || (target.refID == refID && target.endPos < pos);
+}
+
+TargetCoverageStatsCollector::TargetVec TargetCoverageStatsCollector::mergeRegions(const GenomicRegionStore& regionStore, const BamTools::RefVector& refVector) {
+
+	map<string, int32_t> refIDs;
+	for(size_t i=0; i<refVector.size(); i++) refIDs[refVector[i].RefName] = i;
+
+	// regions come sorted by chromosome and start, so overlaps are neighbours
+	TargetVec targets;
+	GenomicRegionStore::GenomicRegionRange regions = regionStore.regions();
+	uint32_t lastChrom = 0;
+
+	for(size_t i=0; i<regions.size(); i++) {
+		const GenomicRegionStore::GenomicRegionT& region = regions[i];
+		bool sameChrom = !targets.empty() && region.chromIndex == lastChrom;
+
+		if(sameChrom && region.startPos <= targets.back().endPos + 1) {
+			targets.back().endPos = max(targets.back().endPos, region.endPos);
+			targets.back().regionCount = i - targets.back().firstRegion + 1;
+			continue;
+		}
+
+		// empty regions cover nothing
+		if(region.endPos < region.startPos) continue;
+
+		auto refID = refIDs.find(region.chrom());
+
+		TargetT target;
+		target.refID = refID == refIDs.end() ? -1 : refID->second;
+		target.startPos = region.startPos;
+		target.endPos = region.endPos;
+		target.firstRegion = i;
+		target.regionCount = 1;
+		targets.push_back(target);
+
+		lastChrom = region.chromIndex;
+	}
+
+	stable_sort(targets.begin(), targets.end(), [](const TargetT& a, const TargetT& b) {
+		if(a.refID != b.refID) return refOrder(a.refID) < refOrder(b.refID);
+		return a.startPos < b.startPos;
+	});
+
+	return targets;
+}
+
+size_t TargetCoverageStatsCollector::locateTarget(const TargetVec& targets, int32_t refID, int32_t startPos, int32_t endPos) {
+
+	// the first target starting after the interval's start
+	auto it = upper_bound(targets.begin(), targets.end(), make_pair(refOrder(refID), startPos),
+			[](const pair<uint32_t, int32_t>& key, const TargetT& target) {
+				if(key.first != refOrder(target.refID)) return key.first < refOrder(target.refID);
+				return key.second < target.startPos;
+			});
+
+	// targets are disjoint, so only the one before can contain the start
+	if(it != targets.begin() && (it - 1)->refID == refID && (it - 1)->endPos >= startPos)
+		return it - 1 - targets.begin();
+
+	if(it != targets.end() && it->refID == refID && it->startPos <= endPos)
+		return it - targets.begin();
+
+	return kNoTarget;
+}
+
+int32_t TargetCoverageStatsCollector::referenceEnd(const BamTools::BamAlignment& al) {
+	int32_t length = 0;
+
+	for(auto op = al.CigarData.begin(); op != al.CigarData.end(); op++) {
+		switch(op->Type) {
+			case 'M': case '=': case 'X': case 'D': case 'N':
+				length += op->Length;
+				break;
+		}
+	}
+
+	return al.Position + max(length, 1) - 1;
+}
+
+TargetCoverageStatsCollector::TargetCoverageStatsCollector(const GenomicRegionStore& regionStore) :
+	AbstractStatCollector(),
+	_regionStore(regionStore),
+	_regionCoverage(regionStore.regions().size(), RegionCoverageT()),
+	_targets(NULL),
+	_firstOpen(0),
+	_nextTarget(0),
+	_lastTarget(0)
+{
+}
+
+TargetCoverageStatsCollector::~TargetCoverageStatsCollector() {
+	for(auto it = _openBuffers.begin(); it != _openBuffers.end(); it++) _bufferPool.release(*it, 0);
+}
+
+void TargetCoverageStatsCollector::beginTargets(const TargetVec& targets, size_t firstTarget, size_t lastTarget) {
+	endTargets();
+
+	_targets = &targets;
+	_firstOpen = _nextTarget = firstTarget;
+	_lastTarget = lastTarget;
+}
+
+void TargetCoverageStatsCollector::endTargets() {
+	if(_targets == NULL) return;
+
+	while(hasOpenTargets()) closeTarget();
+	while(_nextTarget < _lastTarget) {
+		openTarget();
+		closeTarget();
+	}
+
+	_targets = NULL;
+}
+
+void TargetCoverageStatsCollector::openTarget() {
+	const TargetT& target = (*_targets)[_nextTarget++];
+
+	// a difference array: +1 where a covered span starts, -1 past its end
+	_openBuffers.push_back(_bufferPool.acquire(target.endPos - target.startPos + 2));
+}
+
+void TargetCoverageStatsCollector::closeTarget() {
+	BSA_PERF_SCOPE(PerfCounters::kStageCoverage);
+
+	const TargetT& target = (*_targets)[_firstOpen++];
+	CoverageBufferPool::valueT * depth = _openBuffers.front();
+	_openBuffers.pop_front();
+
+	size_t length = target.endPos - target.startPos + 1;
+
+	// turn the differences into depths, unsigned wrap around cancels out
+	CoverageBufferPool::valueT running = 0;
+	for(size_t i=0; i<length; i++) {
+		running += depth[i];
+		depth[i] = running;
+	}
+	_depthHist.addSpan(depth, length);
+
+	GenomicRegionStore::GenomicRegionRange regions = _regionStore.regions();
+	for(size_t r=target.firstRegion; r<target.firstRegion + target.regionCount; r++) {
+		RegionCoverageT& summary = _regionCoverage[r];
+
+		for(int32_t pos=regions[r].startPos; pos<=regions[r].endPos; pos++) {
+			CoverageBufferPool::valueT d = depth[pos - target.startPos];
+			summary.depthSum += d;
+			if(d > 0) summary.coveredPositions++;
+		}
+	}
+
+	_bufferPool.release(depth, length + 1);
+}
+
+void TargetCoverageStatsCollector::addCoverage(int32_t startPos, int32_t endPos) {
+	for(size_t t=_firstOpen; t<_nextTarget; t++) {
+		const TargetT& target = (*_targets)[t];
+
+		int32_t from = max(startPos, target.startPos);
+		int32_t to = min(endPos, target.endPos);
+		if(from > to) continue;
+
+		CoverageBufferPool::valueT * depth = _openBuffers[t - _firstOpen];
+		depth[from - target.startPos]++;
+		depth[to - target.startPos + 1]--;
+	}
+}
+
+void TargetCoverageStatsCollector::processAlignmentImpl(const BamTools::BamAlignment& al, const BamTools::RefVector& refVector) {
+	if(_targets == NULL || !al.IsMapped() || al.RefID < 0) return;
+
+	const TargetVec& targets = *_targets;
+	int32_t endPos = referenceEnd(al);
+
+	// no later read can reach the targets this read starts after
+	while(hasOpenTargets() && isBefore(targets[_firstOpen], al.RefID, al.Position)) closeTarget();
+	while(_nextTarget < _lastTarget && isBefore(targets[_nextTarget], al.RefID, al.Position)) {
+		openTarget();
+		closeTarget();
+	}
+
+	while(_nextTarget < _lastTarget && targets[_nextTarget].refID == al.RefID && targets[_nextTarget].startPos <= endPos)
+		openTarget();
+
+	if(!hasOpenTargets()) return;
+
+	int32_t pos = al.Position;
+	for(auto op = al.CigarData.begin(); op != al.CigarData.end(); op++) {
+		switch(op->Type) {
+			case 'M': case '=': case 'X':
+				addCoverage(pos, pos + op->Length - 1);
+				pos += op->Length;
+				break;
+			case 'D': case 'N':
+				pos += op->Length;
+				break;
+		}
+	}
+}
+
+void TargetCoverageStatsCollector::appendJsonImpl(json_t * jsonRootObj) {
+
+	// replaces the histogram collector's sampled coverage histogram
+	json_object_set_new(jsonRootObj, "coverage_hist", _depthHist.toJson());
+
+	json_t * j_regions = json_array();
+	GenomicRegionStore::GenomicRegionRange regions = _regionStore.regions();
+	for(size_t r=0; r<regions.size(); r++) {
+		const RegionCoverageT& summary = _regionCoverage[r];
+		double length = regions[r].endPos >= regions[r].startPos ? regions[r].endPos - regions[r].startPos + 1 : 0;
+
+		json_t * j_region = json_object();
+		json_object_set_new(j_region, "chr", json_string(regions[r].chrom()));
+		json_object_set_new(j_region, "start", json_integer(regions[r].startPos));
+		json_object_set_new(j_region, "end", json_integer(regions[r].endPos));
+		json_object_set_new(j_region, "mean_depth", json_real(length > 0 ? summary.depthSum / length : 0));
+		json_object_set_new(j_region, "covered_fraction", json_real(length > 0 ? summary.coveredPositions / length : 0));
+		json_array_append_new(j_regions, j_region);
+	}
+	json_object_set_new(jsonRootObj, "target_coverage", j_regions);
+}
+
+void TargetCoverageStatsCollector::mergeImpl(const AbstractStatCollector& other) {
+	const TargetCoverageStatsCollector& otherCoverage = dynamic_cast<const TargetCoverageStatsCollector&>(other);
+
+	_depthHist.merge(otherCoverage._depthHist);
+
+	// both collectors report on the same region store
+	for(size_t r=0; r<_regionCoverage.size() && r<otherCoverage._regionCoverage.size(); r++) {
+		_regionCoverage[r].depthSum += otherCoverage._regionCoverage[r].depthSum;
+		_regionCoverage[r].coveredPositions += otherCoverage._regionCoverage[r].coveredPositions;
+	}
+}
+
+size_t TargetCoverageStatsCollector::memoryUsageImpl() const {
+	return _depthHist.memoryUsage() + vectorMemoryUsage(_regionCoverage) + _bufferPool.memoryUsage();
+}
+
+void TargetCoverageStatsCollector::saveStateImpl(json_t * stateObj) {
+	json_object_set_new(stateObj, "depth_hist", _depthHist.saveState());
+
+	json_t * j_depth = json_array();
+	json_t * j_covered = json_array();
+	for(size_t r=0; r<_regionCoverage.size(); r++) {
+		json_array_append_new(j_depth, json_integer(_regionCoverage[r].depthSum));
+		json_array_append_new(j_covered, json_integer(_regionCoverage[r].coveredPositions));
+	}
+	json_object_set_new(stateObj, "depth_sum", j_depth);
+	json_object_set_new(stateObj, "covered", j_covered);
+}
+
+void TargetCoverageStatsCollector::loadStateImpl(const json_t * stateObj) {
+	_depthHist.loadState(json_object_get(stateObj, "depth_hist"));
+
+	const json_t * j_depth = json_object_get(stateObj, "depth_sum");
+	const json_t * j_covered = json_object_get(stateObj, "covered");
+	for(size_t r=0; r<_regionCoverage.size(); r++) {
+		_regionCoverage[r].depthSum = json_integer_value(json_array_get(j_depth, r));
+		_regionCoverage[r].coveredPositions = json_integer_value(json_array_get(j_covered, r));
+	}
+}
@@ -0,0 +1,135 @@
+#ifndef TARGETCOVERAGESTATSCOLLECTOR_H
+#define TARGETCOVERAGESTATSCOLLECTOR_H
+
+#pragma once
+
+#include "AbstractStatCollector.h"
+#include "GenomicRegionStore.h"
+#include "CoverageBufferPool.h"
+#include "CoverageHistogram.h"
+
+#include <deque>
+
+namespace BamstatsAlive {
+
+	/**
+	 * Exact per-base coverage of a region set
+	 *
+	 * The regions are merged into disjoint targets, which are swept in the
+	 * order of a coordinate sorted input: a target is opened when the first
+	 * read reaches it, and closed once the reads have passed its end. Every
+	 * position of a closed target, covered or not, is added to the depth
+	 * histogram, and to the summary of each region containing it.
+	 *
+	 * Reads are counted from their cigar, so deletions and skipped bases do
+	 * not add depth. Since targets are disjoint, a read spanning several of
+	 * them adds each position only once.
+	 */
+	class TargetCoverageStatsCollector : public AbstractStatCollector {
+		public:
+			typedef struct _targetT {
+				/** The reference of the target, -1 if the input does not have it */
+				int32_t refID;
+				int32_t startPos;
+				int32_t endPos;
+				/** The regions of the store merged into the target */
+				size_t firstRegion;
+				size_t regionCount;
+			} TargetT;
+
+			typedef std::vector<TargetT> TargetVec;
+
+			static const size_t kNoTarget;
+
+			/**
+			 * Merge overlapping and adjacent regions into targets
+			 *
+			 * @param regionStore The regions
+			 * @param refVector The references of the input
+			 * @return The targets in the order of the input: by reference ID,
+			 *         then position, with references missing from the input last
+			 */
+			static TargetVec mergeRegions(const GenomicRegionStore& regionStore, const BamTools::RefVector& refVector);
+
+			/**
+			 * Find the first target overlapping an interval
+			 *
+			 * @return The index of the target, or kNoTarget
+			 */
+			static size_t locateTarget(const TargetVec& targets, int32_t refID, int32_t startPos, int32_t endPos);
+
+			/**
+			 * The last reference position covered by the alignment's cigar
+			 */
+			static int32_t referenceEnd(const BamTools::BamAlignment& al);
+
+		protected:
+			virtual const char * collectorName() const { return "target_coverage"; }
+			virtual void processAlignmentImpl(const BamTools::BamAlignment& al, const BamTools::RefVector& refVector);
+			virtual void appendJsonImpl(json_t * jsonRootObj);
+			virtual void mergeImpl(const AbstractStatCollector& other);
+			virtual void saveStateImpl(json_t * stateObj);
+			virtual void loadStateImpl(const json_t * stateObj);
+			virtual size_t memoryUsageImpl() const;
+
+		private:
+			typedef struct _regionCoverageT {
+				uint64_t depthSum;
+				uint64_t coveredPositions;
+			} RegionCoverageT;
+
+			const GenomicRegionStore& _regionStore;
+			CoverageHistogram _depthHist;
+			std::vector<RegionCoverageT> _regionCoverage;
+
+			// the range of targets being swept; targets [_firstOpen, _nextTarget) are open
+			const TargetVec * _targets;
+			size_t _firstOpen;
+			size_t _nextTarget;
+			size_t _lastTarget;
+			std::deque<CoverageBufferPool::valueT *> _openBuffers;
+			CoverageBufferPool _bufferPool;
+
+			void openTarget();
+			void closeTarget();
+			void addCoverage(int32_t startPos, int32_t endPos);
+
+		public:
+			/**
+			 * @param regionStore The regions coverage is reported for
+			 */
+			TargetCoverageStatsCollector(const GenomicRegionStore& regionStore);
+			virtual ~TargetCoverageStatsCollector();
+
+			/**
+			 * Count depths up to cap exactly in the depth histogram, and
+			 * deeper ones in log bins; drops the depths counted so far
+			 */
+			inline void setCoverageCap(unsigned int cap) { _depthHist.setExactDepths(cap); }
+
+			/**
+			 * Start sweeping a range of targets
+			 *
+			 * The alignments processed afterwards have to come in coordinate
+			 * order; coverage outside of the range is ignored.
+			 *
+			 * @param targets The targets as created by mergeRegions(), which have to outlive the sweep
+			 * @param firstTarget The first target of the range
+			 * @param lastTarget One past the last target of the range
+			 */
+			void beginTargets(const TargetVec& targets, size_t firstTarget, size_t lastTarget);
+
+			/**
+			 * Close every target of the range, including those no read reached
+			 */
+			void endTargets();
+
+			/** The first target of the range no read has reached yet */
+			inline size_t nextTarget() const { return _nextTarget; }
+
+			/** Whether some target is waiting for more reads */
+			inline bool hasOpenTargets() const { return _firstOpen != _nextTarget; }
+	};
+}
+
+#endif
@@ -0,0 +1,43 @@
+#include "VariantSiteList.h"
+
+#include <fstream>
+#include <cctype>
+
+using namespace BamstatsAlive;
+
+VariantSiteList::VariantSiteList(const std::string& siteSpec) {
+	std::istringstream is(siteSpec);
+	std::string line;
+
+	while(std::getline(is, line)) {
+		if(!line.empty() && line[line.length() - 1] == '\r') line.erase(line.length() - 1);
+
+		// VCF meta lines and the column header start with #
+		size_t first = line.find_first_not_of(" \t");
+		if(first == std::string::npos || line[first] == '#') continue;
+
+		std::istringstream fields(line);
+		SiteT site;
+		long long position;
+		if(!(fields>>site.chrom>>position) || position < 1 || position > INT32_MAX)
+			throw new InvalidSiteLineException;
+
+		// a position such as 12.5 or 12abc is not one
+		int next = fields.peek();
+		if(next != EOF && !isspace(next)) throw new InvalidSiteLineException;
+
+		site.position = position - 1;
+		_sites.push_back(site);
+	}
+
+	std::sort(_sites.begin(), _sites.end());
+	_sites.erase(std::unique(_sites.begin(), _sites.end()), _sites.end());
+}
+
+VariantSiteList * VariantSiteList::fromFile(const std::string& path) {
+	std::ifstream fs(path);
+	if(!fs.is_open()) throw new CannotOpenFileException;
+
+	std::string siteSpec((std::istreambuf_iterator<char>(fs)), std::istreambuf_iterator<char>());
+	return new VariantSiteList(siteSpec);
+}
@@ -0,0 +1,66 @@
+#ifndef VARIANTSITELIST_H
+#define VARIANTSITELIST_H
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <string>
+
+namespace BamstatsAlive {
+
+	/**
+	 * A read-only list of known variant sites, such as the SNPs of a
+	 * sample identity panel
+	 *
+	 * The sites are read from a VCF, or from lines holding a chromosome
+	 * and a 1-based position, and kept sorted by chromosome name and
+	 * position without duplicates, so that the index of a site does not
+	 * depend on the input the sites are looked up in.
+	 */
+	class VariantSiteList {
+
+		public:
+			typedef struct _siteT {
+				std::string chrom;
+				/** 0-based, like the positions of the reads */
+				int32_t position;
+
+				bool operator<(const struct _siteT& other) const {
+					if(chrom != other.chrom) return chrom < other.chrom;
+					return position < other.position;
+				}
+
+				bool operator==(const struct _siteT& other) const {
+					return chrom == other.chrom && position == other.position;
+				}
+			} SiteT;
+
+		protected:
+			std::vector<SiteT> _sites;
+
+		public:
+			/**
+			 * @param siteSpec The content of a VCF, or of a file of
+			 *        chromosome and 1-based position lines
+			 */
+			VariantSiteList(const std::string& siteSpec);
+
+			VariantSiteList(const VariantSiteList&) = delete;
+			VariantSiteList& operator=(const VariantSiteList&) = delete;
+
+			/**
+			 * @param path The VCF or site file
+			 * @return The list, owned by the caller
+			 */
+			static VariantSiteList * fromFile(const std::string& path);
+
+			inline size_t size() const { return _sites.size(); }
+			inline const SiteT& operator[](size_t i) const { return _sites[i]; }
+
+			class InvalidSiteLineException {};
+			class CannotOpenFileException {};
+	};
+}
+
+#endif
@@ -0,0 +1,59 @@
+#include "WorkerPool.h"
+
+using namespace BamstatsAlive;
+
+WorkerPool::WorkerPool(size_t threadCount) : _pending(0), _stopping(false) {
+	if(threadCount == 0) threadCount = std::thread::hardware_concurrency();
+	if(threadCount == 0) threadCount = 1;
+
+	for(size_t i=0; i<threadCount; i++) {
+		_workers.push_back(std::thread(&WorkerPool::workerLoop, this));
+	}
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_taskAvailable.notify_all();
+
+	for(auto it = _workers.begin(); it != _workers.end(); it++) it->join();
+}
+
+void WorkerPool::submit(TaskT task) {
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_tasks.push_back(task);
+		_pending++;
+	}
+	_taskAvailable.notify_one();
+}
+
+void WorkerPool::wait() {
+	std::unique_lock<std::mutex> lock(_mutex);
+	_allDone.wait(lock, [this]{ return _pending == 0; });
+}
+
+void WorkerPool::workerLoop() {
+	while(true) {
+		TaskT task;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_taskAvailable.wait(lock, [this]{ return _stopping || !_tasks.empty(); });
+
+			if(_tasks.empty()) return;
+
+			task = _tasks.front();
+			_tasks.pop_front();
+		}
+
+		task();
+
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_pending--;
+			if(_pending == 0) _allDone.notify_all();
+		}
+	}
+}
@@ -0,0 +1,60 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <vector>
+
+namespace BamstatsAlive {
+
+	/**
+	 * A fixed size pool of worker threads
+	 *
+	 * Tasks submitted to the pool are queued and executed by the first
+	 * available worker. The number of threads never exceeds the size given
+	 * at construction, which bounds how many inputs are decoded at once.
+	 */
+	class WorkerPool {
+		public:
+			typedef std::function<void()> TaskT;
+
+		private:
+			std::vector<std::thread> _workers;
+			std::deque<TaskT> _tasks;
+			std::mutex _mutex;
+			std::condition_variable _taskAvailable;
+			std::condition_variable _allDone;
+			size_t _pending;
+			bool _stopping;
+
+			void workerLoop();
+
+		public:
+			/**
+			 * @param threadCount Number of worker threads, 0 means one per hardware thread
+			 */
+			WorkerPool(size_t threadCount = 0);
+			~WorkerPool();
+
+			/**
+			 * Queue a task for execution
+			 *
+			 * @param task The task to run on one of the workers
+			 */
+			void submit(TaskT task);
+
+			/**
+			 * Block until every submitted task has finished
+			 */
+			void wait();
+
+			inline size_t size() const { return _workers.size(); }
+	};
+}
+
+#endif
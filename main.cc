@@ -2,168 +2,289 @@
 #include "BasicStatsCollector.h"
 #include "HistogramStatsCollector.h"
 #include "CoverageMapStatsCollector.h"
-
-#include "FpsModulator.h"
+#include "StatsJob.h"
+#include "FrameWriter.h"
+#include "WorkerPool.h"
+#include "StatsServer.h"
 
 #include <iostream>
 #include <fstream>
 #include <streambuf>
 #include <string>
 
-static unsigned int totalReads;
-static unsigned int updateRate;
-static unsigned int firstUpdateRate;
-static unsigned int wallReadCount = 400000;
-static unsigned int coverageSkipFactor;
-static std::string regionJson;
-static std::string regionJsonFile;
-static bool hasRegionSpec = false;
-static bool isBatch = false;
-
-static size_t fps;
-
 using namespace std;
 using namespace BamstatsAlive;
 
-void printStatsJansson(AbstractStatCollector& rootStatCollector);
+static StatsJobOptionsT jobOptions;
+static std::string regionJson;
+static std::string regionFile;
+static std::string regionIndexPath;
+static bool hasRegionSpec = false;
+static size_t threadCount = 0;
+static bool emitCohortAggregate = false;
+static std::string serverSocketPath;
+static bool withBaseComposition = false;
+static std::string variantSiteFile;
+
+void runCohort(const vector<string>& filenames, const GenomicRegionStore * regionStore, FrameWriter& writer);
 
 int main(int argc, char* argv[]) {
-	
-	string filename;
-	updateRate = 100;
-	firstUpdateRate = 0;
-	coverageSkipFactor = 10;
 
 	/* process the parameters */
-	
-	/* In order to use the -s/-l for coverage map statistics, 
+
+	/* In order to use the -s/-l for coverage map statistics,
 	 * One need to make sure that the reads passed in all came
 	 * from the same chromosome. Otherwise, the result is undefined.
 	 */
 
 	int ch;
-	while((ch = getopt(argc, argv, "u:f:k:r:t:b")) != -1) {
+	while((ch = getopt(argc, argv, "u:f:k:r:t:bTj:aC:R:d:S:D:I:qB:MGP:c:Np:Lm:V:H:")) != -1) {
 		switch(ch) {
 			case 'u':
-				fps = atoi(optarg);
+				jobOptions.fps = atoi(optarg);
 				break;
 			case 'f':
-				firstUpdateRate = atoi(optarg);
+				jobOptions.firstUpdateRate = atoi(optarg);
 				break;
 			case 'r':
 				regionJson = std::string(optarg);
 				hasRegionSpec = true;
 				break;
             case 't':
-                {
-                    regionJsonFile = std::string(optarg);
-                    std::ifstream fs(regionJsonFile);
-                    regionJson = std::string((std::istreambuf_iterator<char>(fs)), std::istreambuf_iterator<char>());
-                    hasRegionSpec = true;
-                    break;
-                }
+                regionFile = std::string(optarg);
+                hasRegionSpec = true;
+                break;
             case 'k':
-				coverageSkipFactor = atoi(optarg);
+				jobOptions.coverageSkipFactor = atoi(optarg);
 				break;
             case 'b':
-                isBatch = true;
-                coverageSkipFactor = 1;
+                jobOptions.isBatch = true;
+                jobOptions.coverageSkipFactor = 1;
                 break;
+			case 'T':
+				jobOptions.isTargeted = true;
+				jobOptions.isBatch = true;
+				break;
+			case 'q':
+				jobOptions.summaryOnly = true;
+				break;
+			case 'B':
+				jobOptions.trackBinSize = atoi(optarg);
+				break;
+			case 'M':
+				jobOptions.mismatchTags = true;
+				break;
+			case 'G':
+				withBaseComposition = true;
+				break;
+			case 'V':
+				variantSiteFile = std::string(optarg);
+				break;
+			case 'H':
+				if(atol(optarg) <= 0) {
+					FrameWriter(cout).writeError("The coverage cap has to be positive");
+					exit(1);
+				}
+				jobOptions.coverageCap = std::min(atol(optarg), static_cast<long>(CoverageHistogram::kMaxExactDepths));
+				break;
+			case 'N':
+				jobOptions.nameSorted = true;
+				break;
+			case 'L':
+				jobOptions.progressive = true;
+				break;
+			case 'p':
+				jobOptions.prefetchBytes = static_cast<size_t>(atoi(optarg)) << 20;
+				break;
+			case 'm':
+				jobOptions.memoryLimit = static_cast<size_t>(atoi(optarg)) << 20;
+				break;
+			case 'c':
+				if(!CollectorRegistry::parseSelection(optarg, jobOptions.collectors)) {
+					FrameWriter(cout).writeError("Cannot parse collector selection");
+					exit(1);
+				}
+				break;
+			case 'P':
+				if(!ReadGroupStatsCollector::parseMode(optarg, jobOptions.partitionMode)) {
+					FrameWriter(cout).writeError("Cannot parse partitioning mode");
+					exit(1);
+				}
+				break;
+			case 'j':
+				threadCount = atoi(optarg);
+				break;
+			case 'a':
+				emitCohortAggregate = true;
+				break;
+			case 'C':
+				jobOptions.sidecarDir = std::string(optarg);
+				break;
+			case 'R':
+				jobOptions.reference = std::string(optarg);
+				break;
+			case 'd':
+				jobOptions.decodeThreads = atoi(optarg);
+				break;
+			case 'D':
+				serverSocketPath = std::string(optarg);
+				break;
+			case 'I':
+				regionIndexPath = std::string(optarg);
+				break;
+			case 'S':
+				if(!ReadSampler::parseSpec(optarg, jobOptions.samplingMode, jobOptions.samplingFraction)) {
+					FrameWriter(cout).writeError("Cannot parse sampling specification");
+					exit(1);
+				}
+				break;
 		}
 	}
 
 	argc -= optind;
 	argv += optind;
 
-	if (argc == 0) 
-		filename = "-";
-	else 
-		filename = *argv;
+	// -G adds to whichever selection -c made
+	if(withBaseComposition) jobOptions.collectors |= CollectorRegistry::kCollectGc;
 
+	/* The variant sites are read once and shared read-only by all jobs */
 
-	/* open BAM file */
+	VariantSiteList * variantSites = NULL;
 
-	BamTools::BamReader reader;
-	reader.Open(filename);
-	if(!reader.IsOpen()) {
-		cout<<"{\"status\":\"error\", \"message\":\"Cannot open the specified file\"}"<<endl;
-		exit(1);
+	if(!variantSiteFile.empty()) {
+		try {
+			variantSites = VariantSiteList::fromFile(variantSiteFile);
+			LOGS<<variantSites->size()<<" variant sites specified"<<endl;
+		}
+		catch(...) {
+			FrameWriter(cout).writeError("Cannot parse the variant sites");
+			exit(1);
+		}
+		jobOptions.variantSites = variantSites;
+		jobOptions.collectors |= CollectorRegistry::kCollectAlleles;
 	}
 
-	const BamTools::RefVector refVector = reader.GetReferenceData();
+	/* The CRAM decoding threads are started once and shared by all jobs */
 
-	map<int32_t, string> chromIDNameMap;
-	for(size_t i=0; i<refVector.size(); i++) {
-		chromIDNameMap[reader.GetReferenceID(refVector[i].RefName)] = refVector[i].RefName;
+	AlignmentReader::startDecodeThreads(jobOptions.decodeThreads);
+
+	if(!serverSocketPath.empty()) {
+		StatsServer server(serverSocketPath, threadCount, jobOptions);
+		if(!server.run()) {
+			FrameWriter(cout).writeError("Cannot listen on the specified socket");
+			exit(1);
+		}
+		return 0;
 	}
 
-	/* Construct the statistics collectors */
+	vector<string> filenames;
+	if (argc == 0)
+		filenames.push_back("-");
+	else
+		filenames.assign(argv, argv + argc);
+
+	FrameWriter writer(cout);
 
-	// NOTICE: The following codes utilize the new c++11 unique_ptr data type
-	//         to automatically manage the life-time of heap based objects.
-	//         See: http://www.cplusplus.com/reference/memory/unique_ptr/
+	/* The region store is parsed once and shared read-only by all inputs */
 
-	// Basic Scalar Statistics
-	BasicStatsCollector bsc;
-	HistogramStatsCollector* hsc = NULL;
 	GenomicRegionStore *regionStore = NULL;
 
-	// Histogram Statistics
 	if(hasRegionSpec) {
 		LOGS<<"Has Region Spec"<<std::endl;
 		try {
-			regionStore = new GenomicRegionStore(regionJson);
+			if(regionFile.empty())
+				regionStore = new GenomicRegionStore(regionJson);
+			else
+				regionStore = GenomicRegionStore::fromFile(regionFile);
 			LOGS<<regionStore->regions().size()<<" Regions specified"<<endl;
-			hsc = new HistogramStatsCollector(chromIDNameMap, coverageSkipFactor, regionStore);
 		}
 		catch(...) {
-			cout<<"{\"status\":\"error\", \"message\":\"Cannot parse region json string\"}"<<endl;
+			writer.writeError("Cannot parse region json string");
 			exit(1);
 		}
 	}
 	else {
 		LOGS<<"Does not have region spec"<<std::endl;
-		hsc = new HistogramStatsCollector(chromIDNameMap, coverageSkipFactor);
 	}
-	bsc.addChild(hsc);
-
-	/* Process read alignments */
-	BamTools::BamAlignment alignment;
-
-    if(isBatch) {
-        while(reader.GetNextAlignment(alignment)) {
-            totalReads++;
-            bsc.processAlignment(alignment, refVector);
-        }
-        printStatsJansson(bsc);
-    }
-    else {
-        YiCppLib::FpsModulator<decltype(updateRate)> fpsModulator(updateRate, fps, 250);
-        while(reader.GetNextAlignment(alignment) && totalReads <= wallReadCount) {
-            totalReads++;
-            bsc.processAlignment(alignment, refVector);
-
-            if((totalReads > 0 && totalReads % updateRate == 0)) {
-                printStatsJansson(bsc);
-                fpsModulator.redraw();
-            }
-        }
-        // count for all regions from which no read came
-        printStatsJansson(bsc);
-    }
-
-	if(hsc) delete hsc;
+
+	/* compiling a region index only needs the region set */
+
+	if(!regionIndexPath.empty()) {
+		if(!regionStore || !regionStore->writeIndex(regionIndexPath)) {
+			writer.writeError("Cannot write the region index");
+			exit(1);
+		}
+		delete regionStore;
+		AlignmentReader::stopDecodeThreads();
+		return 0;
+	}
+
+	if(!jobOptions.sidecarDir.empty())
+		jobOptions.sidecarKey = StatsJob::sidecarKey(jobOptions, regionStore);
+
+	if(filenames.size() == 1) {
+		// a single input may spread its targets over all threads
+		jobOptions.targetThreads = threadCount;
+		StatsJob job(filenames[0], jobOptions, regionStore, writer);
+		if(!job.run()) {
+			writer.writeError("Cannot open the specified file");
+			exit(1);
+		}
+	}
+	else {
+		runCohort(filenames, regionStore, writer);
+	}
+
 	if(regionStore) delete regionStore;
+	if(variantSites) delete variantSites;
+
+	// every reader has been closed with its job
+	AlignmentReader::stopDecodeThreads();
 }
 
-void printStatsJansson(AbstractStatCollector& rootStatCollector) {
+void runCohort(const vector<string>& filenames, const GenomicRegionStore * regionStore, FrameWriter& writer) {
+
+	// jobs are kept after they finish only when they are merged afterwards
+	vector<StatsJob *> jobs(filenames.size(), NULL);
+
+	StatsJobOptionsT cohortOptions = jobOptions;
+	cohortOptions.isMerged = emitCohortAggregate;
 
-	// Create the root object that contains everything
-	json_t * j_root = json_object();
+	{
+		WorkerPool pool(threadCount);
+		LOGS<<"Processing "<<filenames.size()<<" inputs on "<<pool.size()<<" threads"<<endl;
 
-	// Let the root object of the collector tree create Json
-	rootStatCollector.appendJson(j_root);
+		for(size_t i=0; i<filenames.size(); i++) {
+			StatsJob ** slot = &jobs[i];
+			*slot = new StatsJob(filenames[i], cohortOptions, regionStore, writer, true);
 
-	// Dump the json
-	cout<<json_dumps(j_root, JSON_COMPACT | JSON_ENSURE_ASCII | JSON_PRESERVE_ORDER)<<";"<<endl;
+			pool.submit([slot, &writer]() {
+				if(!(*slot)->run()) {
+					writer.writeError("Cannot open the specified file", (*slot)->sampleId());
+					delete *slot;
+					*slot = NULL;
+				}
+				else if(!emitCohortAggregate) {
+					delete *slot;
+					*slot = NULL;
+				}
+			});
+		}
+
+		pool.wait();
+	}
+
+	if(emitCohortAggregate) {
+		// merge in input order so the aggregate does not depend on scheduling
+		StatsJob aggregate("", jobOptions, regionStore, writer, true);
+		aggregate.setSampleId("cohort");
+
+		for(size_t i=0; i<jobs.size(); i++) {
+			if(jobs[i] == NULL) continue;
+			aggregate.merge(*jobs[i]);
+			delete jobs[i];
+		}
+
+		aggregate.writeFrame(true);
+	}
 }
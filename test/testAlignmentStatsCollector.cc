@@ -0,0 +1,55 @@
+#include "../bamstatsAliveCommon.hpp"
+#include "../AlignmentStatsCollector.h"
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#define ASSERT_EQ(expr, expect, msg) { if ((expr) != (expect)) {std::cerr<<(msg)<<std::endl; exit(1);} }
+
+using namespace std;
+using namespace BamstatsAlive;
+
+static std::vector<int32_t> offsetsOf(const std::string& md) {
+	std::vector<int32_t> offsets;
+	if(!AlignmentStatsCollector::parseMismatches(md, offsets)) offsets.assign(1, -1);
+	return offsets;
+}
+
+static std::vector<int32_t> expected(std::initializer_list<int32_t> offsets) {
+	return std::vector<int32_t>(offsets);
+}
+
+int main(int argc, char* argv[]) {
+
+	ASSERT_EQ(offsetsOf("100"), expected({}), "A perfect match should hold no mismatch");
+	ASSERT_EQ(offsetsOf(""), expected({}), "An empty tag should hold no mismatch");
+	ASSERT_EQ(offsetsOf("10A5"), expected({10}), "A mismatch should be placed after the matches ahead of it");
+	ASSERT_EQ(offsetsOf("0A0C98"), expected({0, 1}), "Adjacent mismatches should be separated by zero matches");
+	ASSERT_EQ(offsetsOf("5A0C3"), expected({5, 6}), "Zero matches should not move the offset");
+	ASSERT_EQ(offsetsOf("99G"), expected({99}), "A mismatch should be found on the last base");
+	ASSERT_EQ(offsetsOf("123T4"), expected({123}), "Matches of several digits should be read as one number");
+
+	// deleted reference bases count towards the offset
+	ASSERT_EQ(offsetsOf("10^AC5T2"), expected({17}), "A deletion should move the offset by its length");
+	ASSERT_EQ(offsetsOf("3^G0T4"), expected({4}), "A mismatch right after a deletion should follow it");
+	ASSERT_EQ(offsetsOf("2A1^CGT0G6"), expected({2, 7}), "Mismatches around a deletion should both be placed");
+	ASSERT_EQ(offsetsOf("7^TT"), expected({}), "A trailing deletion should hold no mismatch");
+
+	// the offsets are not limited to the canonical nucleotides
+	ASSERT_EQ(offsetsOf("4N4"), expected({4}), "An N should count as a mismatch");
+	ASSERT_EQ(offsetsOf("4a4"), expected({4}), "A lowercase base should count as a mismatch");
+
+	ASSERT_EQ(offsetsOf("10-5"), expected({-1}), "An unknown character should fail the parse");
+	ASSERT_EQ(offsetsOf("10A 5"), expected({-1}), "A space should fail the parse");
+	ASSERT_EQ(offsetsOf("2147483647"), expected({}), "The largest offset should still be read");
+	ASSERT_EQ(offsetsOf("2147483648A"), expected({-1}), "A number past the largest offset should fail the parse");
+	ASSERT_EQ(offsetsOf("99999999999999999999A"), expected({-1}), "A number of many digits should fail the parse");
+	ASSERT_EQ(offsetsOf("2147483600^AC2147483600A"), expected({-1}), "Matches adding up past the largest offset should fail the parse");
+
+	std::vector<int32_t> offsets(3, 7);
+	AlignmentStatsCollector::parseMismatches("1A1", offsets);
+	ASSERT_EQ(offsets, expected({1}), "The offsets of a previous tag should be cleared");
+
+	return 0;
+}
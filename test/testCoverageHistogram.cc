@@ -0,0 +1,115 @@
+#include "../bamstatsAliveCommon.hpp"
+#include "../CoverageHistogram.h"
+
+#include <string>
+#include <iostream>
+
+#define ASSERT_EQ(expr, expect, msg) { if ((expr) != (expect)) {std::cerr<<(msg)<<std::endl; exit(1);} }
+
+using namespace std;
+using namespace BamstatsAlive;
+
+// the fraction of the positions reported under a label, or -1 if there is no such label
+static double fraction(const CoverageHistogram& hist, const char * label, unsigned int binWidth = 1) {
+	json_t * j_hist = hist.toJson(binWidth);
+	json_t * j_fraction = json_object_get(j_hist, label);
+	double value = j_fraction ? json_real_value(j_fraction) : -1;
+	json_decref(j_hist);
+	return value;
+}
+
+static size_t labels(const CoverageHistogram& hist) {
+	json_t * j_hist = hist.toJson();
+	size_t size = json_object_size(j_hist);
+	json_decref(j_hist);
+	return size;
+}
+
+int main(int argc, char* argv[]) {
+
+	// exact depths up to the cap, then eight log bins per doubling
+	CoverageHistogram hist(1000);
+	hist.add(0);
+	hist.add(1000);
+	hist.add(1001);
+	hist.add(1023);
+	hist.add(1024);
+	hist.add(1151);
+	hist.add(1152);
+	hist.add(~static_cast<CoverageHistogram::depthT>(0));
+
+	ASSERT_EQ(hist.positions(), 8, "Every depth should be counted");
+	ASSERT_EQ(fraction(hist, "0"), 0.125, "Depth 0 should be counted exactly");
+	ASSERT_EQ(fraction(hist, "1000"), 0.125, "The cap should be counted exactly");
+	ASSERT_EQ(fraction(hist, "1001"), 0.25, "The first log bin should start right past the cap");
+	ASSERT_EQ(fraction(hist, "960"), -1, "The first log bin should not be labelled below the cap");
+	ASSERT_EQ(fraction(hist, "1024"), 0.25, "Depths 1024 to 1151 should share a log bin");
+	ASSERT_EQ(fraction(hist, "1152"), 0.125, "Depth 1152 should open the next log bin");
+	ASSERT_EQ(fraction(hist, "4026531840"), 0.125, "The deepest depth should fall in the last log bin");
+	ASSERT_EQ(labels(hist), 6, "No other label should be reported");
+	ASSERT_EQ(hist.meanDepth(), (0 + 1000 + 1001 + 1023 + 1024 + 1151 + 1152 + 4294967295.0) / 8, "The mean depth should not suffer from the log bins");
+
+	// the exact depths are grouped by the bin width, the log bins are not
+	ASSERT_EQ(fraction(hist, "1000", 100), 0.125, "A bin width should group the exact depths");
+	ASSERT_EQ(fraction(hist, "1001", 100), 0.25, "A bin width should leave the log bins alone");
+
+	// the smallest cap reaches the first log bin that splits a doubling in eight
+	CoverageHistogram smallHist(1);
+	smallHist.add(8);
+	smallHist.add(9);
+	smallHist.add(16);
+	smallHist.add(17);
+	ASSERT_EQ(fraction(smallHist, "8"), 0.25, "The cap should be raised to 8");
+	ASSERT_EQ(fraction(smallHist, "9"), 0.25, "Depth 9 should have a log bin of its own");
+	ASSERT_EQ(fraction(smallHist, "16"), 0.5, "Depths 16 and 17 should share a log bin");
+
+	// the cap is bounded, whatever is asked for
+	CoverageHistogram hugeHist(~static_cast<CoverageHistogram::depthT>(0));
+	hugeHist.add(CoverageHistogram::kMaxExactDepths);
+	hugeHist.add(CoverageHistogram::kMaxExactDepths + 131071);
+	ASSERT_EQ(fraction(hugeHist, "1048576"), 0.5, "The largest cap should still be counted exactly");
+	ASSERT_EQ(fraction(hugeHist, "1048577"), 0.5, "Depths past the largest cap should be log binned");
+	ASSERT_EQ(hugeHist.memoryUsage() < (CoverageHistogram::kMaxExactDepths + 512) * sizeof(uint64_t), true, "The bins should be bounded by the largest cap");
+
+	// runs of the same depth
+	CoverageHistogram spanHist(1000);
+	CoverageHistogram::depthT depths[] = { 5, 5, 5, 2000 };
+	spanHist.addSpan(depths, 4);
+	ASSERT_EQ(spanHist.positions(), 4, "Every position of a span should be counted");
+	ASSERT_EQ(fraction(spanHist, "5"), 0.75, "A run should be counted once per position");
+	ASSERT_EQ(fraction(spanHist, "1920"), 0.25, "A deep position of a span should be log binned");
+	ASSERT_EQ(spanHist.meanDepth(), 2015 / 4.0, "The mean depth of a span should be exact");
+
+	// merging rebins by the lowest depth of the other's bins
+	CoverageHistogram fineHist(1000);
+	CoverageHistogram coarseHist(8);
+	coarseHist.add(20);
+	coarseHist.add(21);
+	fineHist.add(500);
+	fineHist.merge(coarseHist);
+	ASSERT_EQ(fraction(fineHist, "20"), 2 / 3.0, "A log bin under the cap should be rebinned at its lowest depth");
+	ASSERT_EQ(fraction(fineHist, "500"), 1 / 3.0, "The own bins should be kept on a merge");
+	ASSERT_EQ(fineHist.meanDepth(), 541 / 3.0, "The mean depth should be exact across caps");
+
+	coarseHist.merge(fineHist);
+	ASSERT_EQ(coarseHist.positions(), 5, "The positions should add up on a merge");
+	ASSERT_EQ(fraction(coarseHist, "480"), 0.2, "An exact depth should be rebinned into the log bin holding it");
+	ASSERT_EQ(fraction(coarseHist, "20"), 0.8, "Rebinned depths should join the own log bin");
+
+	CoverageHistogram sameHist(1000);
+	sameHist.add(1024);
+	sameHist.merge(hist);
+	ASSERT_EQ(fraction(sameHist, "1024"), 1 / 3.0, "Histograms of the same cap should add bin by bin");
+
+	// the state keeps the bins by their lowest depth
+	json_t * j_state = hist.saveState();
+	CoverageHistogram loadedHist(1000);
+	loadedHist.loadState(j_state);
+	json_decref(j_state);
+	ASSERT_EQ(loadedHist.positions(), hist.positions(), "The positions should survive the state");
+	ASSERT_EQ(fraction(loadedHist, "1001"), 0.25, "The log bins should survive the state");
+	ASSERT_EQ(fraction(loadedHist, "1024"), 0.25, "The log bins should be reloaded into the same bins");
+	ASSERT_EQ(loadedHist.meanDepth(), hist.meanDepth(), "The depth sum should survive the state");
+
+	return 0;
+}
@@ -0,0 +1,133 @@
+#include "../bamstatsAliveCommon.hpp"
+#include "../StatsJob.h"
+#include "../GenomicRegionStore.h"
+#include "../FrameWriter.h"
+#include "api/BamWriter.h"
+#include "api/BamReader.h"
+
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <cstdio>
+
+#define ASSERT_EQ(expr, expect, msg) { if ((expr) != (expect)) {std::cerr<<(msg)<<std::endl; exit(1);} }
+
+using namespace std;
+using namespace BamstatsAlive;
+
+static const std::string kBamPath = "testDeterministicReduction.bam";
+static const int32_t kRefLength = 1000000;
+static const int32_t kReadLength = 100;
+
+// a fixed sequence, so every run writes the same input
+static uint32_t nextRandom(uint64_t& state) {
+	state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+	return state >> 33;
+}
+
+static void writeSyntheticBam() {
+	BamTools::RefVector refs;
+	refs.push_back(BamTools::RefData("1", kRefLength));
+	refs.push_back(BamTools::RefData("2", kRefLength));
+
+	std::string headerText = "@HD\tVN:1.4\tSO:coordinate\n"
+		"@SQ\tSN:1\tLN:1000000\n@SQ\tSN:2\tLN:1000000\n"
+		"@RG\tID:rg1\tSM:synthetic\tLB:lib1\n@RG\tID:rg2\tSM:synthetic\tLB:lib2\n";
+
+	BamTools::BamWriter writer;
+	ASSERT_EQ(writer.Open(kBamPath, headerText, refs), true, "The synthetic bam should have been opened for writing");
+
+	uint64_t state = 42;
+	unsigned int count = 0;
+	for(int32_t refID=0; refID<2; refID++) {
+		for(int32_t pos = 0; pos < kRefLength - 2 * kReadLength; pos += nextRandom(state) % 40) {
+			BamTools::BamAlignment al;
+			stringstream nameSS; nameSS << "read" << count++;
+			al.Name = nameSS.str();
+			al.RefID = refID;
+			al.Position = pos;
+			al.MapQuality = nextRandom(state) % 61;
+			al.Length = kReadLength;
+
+			al.QueryBases.resize(kReadLength);
+			al.Qualities.resize(kReadLength);
+			for(int32_t i=0; i<kReadLength; i++) {
+				al.QueryBases[i] = "ACGT"[nextRandom(state) % 4];
+				al.Qualities[i] = '!' + 10 + nextRandom(state) % 30;
+			}
+
+			uint32_t clip = nextRandom(state) % 8 == 0 ? 5 : 0;
+			if(clip) al.CigarData.push_back(BamTools::CigarOp('S', clip));
+			al.CigarData.push_back(BamTools::CigarOp('M', kReadLength - clip));
+
+			// pairs with fragments of a few hundred bases, some duplicated
+			int32_t fragment = 200 + nextRandom(state) % 400;
+			al.AlignmentFlag = 0x1 | 0x2 | (count % 2 ? 0x40 : 0x80) | (nextRandom(state) % 2 ? 0x10 : 0x20);
+			if(nextRandom(state) % 20 == 0) al.AlignmentFlag |= 0x400;
+			al.MateRefID = refID;
+			al.MatePosition = pos + fragment - kReadLength;
+			al.InsertSize = fragment;
+
+			al.AddTag("RG", "Z", std::string(count % 3 ? "rg1" : "rg2"));
+			al.AddTag("NM", "i", static_cast<int>(nextRandom(state) % 3));
+
+			writer.SaveAlignment(al);
+		}
+	}
+	writer.Close();
+
+	BamTools::BamReader reader;
+	ASSERT_EQ(reader.Open(kBamPath), true, "The synthetic bam should have been opened for indexing");
+	ASSERT_EQ(reader.CreateIndex(BamTools::BamIndex::STANDARD), true, "The synthetic bam should have been indexed");
+	reader.Close();
+}
+
+static std::string regionJson() {
+	// more targets than chunks
+	stringstream json; json << "[";
+	for(int32_t refID=0; refID<2; refID++) {
+		for(int32_t start = 1000; start < kRefLength; start += 4000) {
+			if(refID || start > 1000) json << ",";
+			json << "{\"chr\":\"" << refID + 1 << "\",\"start\":" << start << ",\"end\":" << start + 700 + start % 900 << "}";
+		}
+	}
+	json << "]";
+	return json.str();
+}
+
+static std::string runTargeted(const GenomicRegionStore& regionStore, unsigned int threads) {
+	StatsJobOptionsT options;
+	options.isTargeted = true;
+	options.isBatch = true;
+	options.targetThreads = threads;
+	options.collectors = CollectorRegistry::kAllCollectors;
+	options.partitionMode = ReadGroupStatsCollector::kPartitionReadGroup;
+	options.mismatchTags = true;
+	options.trackBinSize = 1000;
+
+	stringstream out;
+	FrameWriter writer(out);
+	StatsJob job(kBamPath, options, &regionStore, writer);
+	ASSERT_EQ(job.run(), true, "The synthetic bam should have been processed");
+	return out.str();
+}
+
+int main(int argc, char* argv[]) {
+
+	writeSyntheticBam();
+
+	GenomicRegionStore regionStore(regionJson());
+
+	std::string reference = runTargeted(regionStore, 1);
+	ASSERT_EQ(reference.find("total_reads") != std::string::npos, true, "The single threaded run should have produced statistics");
+
+	const unsigned int threadCounts[] = { 2, 4, 8 };
+	for(size_t i=0; i<sizeof(threadCounts) / sizeof(threadCounts[0]); i++) {
+		stringstream msgSS; msgSS << "The output on " << threadCounts[i] << " threads should be identical to the output on 1 thread";
+		ASSERT_EQ(runTargeted(regionStore, threadCounts[i]), reference, msgSS.str());
+	}
+
+	std::remove(kBamPath.c_str());
+	std::remove((kBamPath + ".bai").c_str());
+	return 0;
+}
@@ -4,6 +4,7 @@
 #include <iostream>
 #include "../bamstatsAliveCommon.hpp"
 #include <cstring>
+#include <cstddef>
 
 #define ASSERT_EQ(expr, expect, msg) { if ((expr) != (expect)) {std::cerr<<(msg)<<std::endl; exit(1);} }
 #define ASSERT_UNEQ(expr, expect, msg) { if ((expr) == (expect)) {std::cerr<<(msg)<<std::endl; exit(1);} }
@@ -14,6 +15,8 @@
 using namespace std;
 using namespace BamstatsAlive;
 
+std::string testBedStr = "track name=test\n11\t1\t10002\n11\t13500652\t13510653\n";
+
 std::string testJsonStr = "[{\"start\":1,\"end\":10001,\"chr\":\"11\"},{\"start\":13500652,\"end\":13510652,\"chr\":\"11\"},{\"start\":27001304,\"end\":27011304,\"chr\":\"11\"},{\"start\":40501955,\"end\":40511955,\"chr\":\"11\"},{\"start\":54002607,\"end\":54012607,\"chr\":\"11\"},{\"start\":67503259,\"end\":67513259,\"chr\":\"11\"},{\"start\":81003910,\"end\":81013910,\"chr\":\"11\"},{\"start\":94504562,\"end\":94514562,\"chr\":\"11\"},{\"start\":108005213,\"end\":108015213,\"chr\":\"11\"},{\"start\":121505865,\"end\":121515865,\"chr\":\"11\"}]";
 
 int main(int argc, char* argv[]) {
@@ -48,7 +51,71 @@ int main(int argc, char* argv[]) {
 	const GenomicRegionStore::GenomicRegionT& readRegion2 = store->locateRegion("11", 13500655);
 	ASSERT_UNEQ(&readRegion2, &GenomicRegionStore::kRegionNotFound(), "End of the sample read should be found");
 
+	/* BED input and region index files */
+
+	GenomicRegionStore *bedStore = new GenomicRegionStore(testBedStr);
+	ASSERT_EQ(bedStore->regions().size(), 2, "2 BED regions should have been observed");
+	ASSERT_EQ(bedStore->locateRegion("11", 10001).endPos, 10001, "BED end positions should be converted to inclusive ones");
+	ASSERT_EQ(&bedStore->locateRegion("11", 10002), &GenomicRegionStore::kRegionNotFound(), "The BED end position should not be found");
+
+	std::string indexPath = "testGenomicRegionStore.bsari";
+	ASSERT_EQ(store->writeIndex(indexPath), true, "The region index should have been written");
+
+	GenomicRegionStore *indexStore = GenomicRegionStore::fromFile(indexPath);
+	unlink(indexPath.c_str());
+
+	ASSERT_EQ(indexStore->regions().size(), 10, "10 Genomic regions should have been loaded from the index");
+	ASSERT_EQ(indexStore->locateRegion("11", 13500655).startPos, 13500652, "End of the sample read should be found in the index");
+	ASSERT_EQ(strcmp(indexStore->locateRegion("11", 500).chrom(), "11"), 0, "The chromosome should be read from the index");
+
+	/* overlapping regions resolve to the one listed first */
+
+	GenomicRegionStore overlapStore("[{\"chr\":\"1\",\"start\":500,\"end\":900},{\"chr\":\"1\",\"start\":100,\"end\":1000},{\"chr\":\"1\",\"start\":600,\"end\":700}]");
+	ASSERT_EQ(overlapStore.locateRegion("1", 650).startPos, 500, "The region listed first should be found where regions overlap");
+	ASSERT_EQ(overlapStore.locateRegion("1", 950).startPos, 100, "The only region containing the position should be found");
+	ASSERT_EQ(overlapStore.locateRegion("1", 200).startPos, 100, "A region starting before the others should be found");
+
+	GenomicRegionStore overlapBedStore("1\t99\t1000\n1\t499\t900\n");
+	ASSERT_EQ(overlapBedStore.locateRegion("1", 650).startPos, 99, "The BED region listed first should be found where regions overlap");
+
+	/* inverted and negative regions are rejected */
+
+	const char * invalidSpecs[] = {
+		"[{\"chr\":\"1\",\"start\":200,\"end\":100}]",
+		"[{\"chr\":\"1\",\"start\":-5,\"end\":100}]",
+		"1\t200\t100\n",
+		"1\t-5\t100\n"
+	};
+	for(size_t i=0; i<sizeof(invalidSpecs) / sizeof(invalidSpecs[0]); i++) {
+		bool rejected = false;
+		try {
+			GenomicRegionStore invalidStore(invalidSpecs[i]);
+		}
+		catch(GenomicRegionStore::InvalidRegionException * e) { rejected = true; delete e; }
+		catch(GenomicRegionStore::InvalidBedLineException * e) { rejected = true; delete e; }
+		ASSERT_EQ(rejected, true, std::string("The region set should have been rejected: ") + invalidSpecs[i]);
+	}
+
+	GenomicRegionStore emptyBedStore("1\t100\t100\n1\t200\t300\n");
+	ASSERT_EQ(emptyBedStore.regions().size(), 1, "Empty BED intervals should be skipped");
+
+	// an index whose region ends before it starts
+	GenomicRegionStore validStore("1\t99\t200\n");
+	std::string craftedIndex(validStore.image(), validStore.imageSize());
+	size_t regionOffset = reinterpret_cast<const char *>(&validStore.regions()[0]) - validStore.image();
+	int32_t invertedEnd = 50;
+	memcpy(&craftedIndex[regionOffset + offsetof(GenomicRegionStore::GenomicRegionT, endPos)], &invertedEnd, sizeof(invertedEnd));
+	memcpy(&craftedIndex[regionOffset + offsetof(GenomicRegionStore::GenomicRegionT, maxEnd)], &invertedEnd, sizeof(invertedEnd));
+
+	bool indexRejected = false;
+	try {
+		GenomicRegionStore craftedStore(craftedIndex);
+	}
+	catch(GenomicRegionStore::InvalidIndexException * e) { indexRejected = true; delete e; }
+	ASSERT_EQ(indexRejected, true, "An index with an inverted region should have been rejected");
 
+	delete indexStore;
+	delete bedStore;
 	delete store;
 	return 0;
 }
@@ -0,0 +1,69 @@
+#include "../bamstatsAliveCommon.hpp"
+#include "../QuantileSketch.h"
+
+#include <iostream>
+
+#define ASSERT_EQ(expr, expect, msg) { if ((expr) != (expect)) {std::cerr<<(msg)<<std::endl; exit(1);} }
+
+using namespace std;
+using namespace BamstatsAlive;
+
+static const int kValues = 200000;
+
+static QuantileSketch::valueT valueAt(int i) {
+	return (i * 7919) % 10007;
+}
+
+static void assertSameSummary(const QuantileSketch& sketch, const QuantileSketch& expect, const std::string& msg) {
+	QuantileSummaryT summary = sketch.summary();
+	QuantileSummaryT expectSummary = expect.summary();
+	ASSERT_EQ(summary.count, expectSummary.count, msg + ": count");
+	ASSERT_EQ(summary.min, expectSummary.min, msg + ": min");
+	ASSERT_EQ(summary.p1, expectSummary.p1, msg + ": p1");
+	ASSERT_EQ(summary.q1, expectSummary.q1, msg + ": q1");
+	ASSERT_EQ(summary.median, expectSummary.median, msg + ": median");
+	ASSERT_EQ(summary.q3, expectSummary.q3, msg + ": q3");
+	ASSERT_EQ(summary.p99, expectSummary.p99, msg + ": p99");
+	ASSERT_EQ(summary.max, expectSummary.max, msg + ": max");
+}
+
+int main(int argc, char* argv[]) {
+
+	QuantileSketch uninterrupted;
+	for(int i=0; i<kValues; i++) uninterrupted.add(valueAt(i));
+
+	// a sketch saved and restored half way goes on as if it never was
+	QuantileSketch saved;
+	for(int i=0; i<kValues / 2; i++) saved.add(valueAt(i));
+
+	json_t * j_state = saved.saveState();
+	QuantileSketch restored;
+	restored.loadState(j_state);
+	json_decref(j_state);
+
+	for(int i=kValues / 2; i<kValues; i++) restored.add(valueAt(i));
+	assertSameSummary(restored, uninterrupted, "A restored sketch should compact as the saved one would");
+
+	json_t * j_restored = restored.saveState();
+	json_t * j_uninterrupted = uninterrupted.saveState();
+	const json_t * j_levels = json_object_get(j_restored, "levels");
+	const json_t * j_expectLevels = json_object_get(j_uninterrupted, "levels");
+	ASSERT_EQ(json_array_size(j_levels), json_array_size(j_expectLevels), "A restored sketch should have as many levels");
+	for(size_t h=0; h<json_array_size(j_levels); h++) {
+		const json_t * j_level = json_array_get(j_levels, h);
+		const json_t * j_expectLevel = json_array_get(j_expectLevels, h);
+		ASSERT_EQ(json_array_size(j_level), json_array_size(j_expectLevel), "A restored sketch should retain as many items per level");
+		for(size_t i=0; i<json_array_size(j_level); i++)
+			ASSERT_EQ(json_integer_value(json_array_get(j_level, i)), json_integer_value(json_array_get(j_expectLevel, i)), "A restored sketch should retain the same items");
+	}
+	json_decref(j_restored);
+	json_decref(j_uninterrupted);
+
+	// the accuracy of the values, uniform over 0 to 10006
+	QuantileSummaryT summary = uninterrupted.summary();
+	ASSERT_EQ(summary.min, 0, "The min should be exact");
+	ASSERT_EQ(summary.max, 10006, "The max should be exact");
+	ASSERT_EQ(summary.median > 4800 && summary.median < 5200, true, "The median should be within the rank error");
+
+	return 0;
+}
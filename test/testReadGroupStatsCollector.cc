@@ -0,0 +1,106 @@
+#include "../bamstatsAliveCommon.hpp"
+#include "../ReadGroupStatsCollector.h"
+
+#include <string>
+#include <iostream>
+#include <cstring>
+
+#define ASSERT_EQ(expr, expect, msg) { if ((expr) != (expect)) {std::cerr<<(msg)<<std::endl; exit(1);} }
+
+using namespace std;
+using namespace BamstatsAlive;
+
+// raw tag data as in a bam record: the name, a type and the value
+static std::string tag(const char * name, char type, const std::string& value) {
+	return std::string(name, 2) + type + value;
+}
+
+static std::string int32Value(int32_t value) {
+	std::string bytes(4, '\0');
+	memcpy(&bytes[0], &value, sizeof(value));
+	return bytes;
+}
+
+static std::string arrayValue(char subtype, uint32_t count, size_t elementSize) {
+	std::string bytes(1, subtype);
+	bytes += int32Value(count);
+	bytes += std::string(count * elementSize, 'x');
+	return bytes;
+}
+
+// counts the reads of a partition
+class ReadCountCollector : public AbstractStatCollector {
+	public:
+		uint64_t reads;
+		ReadCountCollector() : reads(0) {}
+	protected:
+		virtual const char * collectorName() const { return "count"; }
+		virtual void processAlignmentImpl(const BamTools::BamAlignment& al, const BamTools::RefVector& refVector) { reads++; }
+		virtual void appendJsonImpl(json_t * jsonRootObj) { json_object_set_new(jsonRootObj, "reads", json_integer(reads)); }
+		virtual void mergeImpl(const AbstractStatCollector& other) { reads += dynamic_cast<const ReadCountCollector&>(other).reads; }
+		virtual void saveStateImpl(json_t * stateObj) { json_object_set_new(stateObj, "reads", json_integer(reads)); }
+		virtual void loadStateImpl(const json_t * stateObj) { reads = json_integer_value(json_object_get(stateObj, "reads")); }
+};
+
+static json_int_t partitionReads(json_t * j_root, const char * group) {
+	json_t * j_partition = group ? json_object_get(json_object_get(j_root, "read_groups"), group) : json_object_get(j_root, "no_read_group");
+	return json_integer_value(json_object_get(j_partition, "reads"));
+}
+
+static bool foundGroup(const std::string& tagData, const char * expect) {
+	const char * id = ReadGroupStatsCollector::findStringTag(tagData, "RG");
+	if(expect == NULL) return id == NULL;
+	return id != NULL && strcmp(id, expect) == 0;
+}
+
+int main(int argc, char* argv[]) {
+
+	std::string rg = tag("RG", 'Z', std::string("lane1", 6));
+
+	ASSERT_EQ(foundGroup(rg, "lane1"), true, "RG should be found as the only tag");
+	ASSERT_EQ(foundGroup(tag("NM", 'i', int32Value(3)) + rg, "lane1"), true, "RG should be found after an i tag");
+	ASSERT_EQ(foundGroup(tag("MD", 'Z', std::string("10A5", 5)) + rg, "lane1"), true, "RG should be found after a Z tag");
+	ASSERT_EQ(foundGroup(tag("ML", 'B', arrayValue('C', 3, 1)) + rg, "lane1"), true, "RG should be found after a B array of bytes");
+	ASSERT_EQ(foundGroup(tag("ZS", 'B', arrayValue('i', 2, 4)) + tag("XS", 's', std::string("\x01\x00", 2)) + rg, "lane1"), true, "RG should be found after a B array of ints and an s tag");
+	ASSERT_EQ(foundGroup(tag("ML", 'B', arrayValue('C', 0, 1)) + rg, "lane1"), true, "RG should be found after an empty B array");
+
+	ASSERT_EQ(foundGroup("", NULL), true, "Empty tag data should hold no RG");
+	ASSERT_EQ(foundGroup(tag("NM", 'i', int32Value(3)), NULL), true, "A missing RG should not be found");
+	ASSERT_EQ(foundGroup(tag("RG", 'i', int32Value(3)), NULL), true, "An RG that is not a string should not be found");
+	ASSERT_EQ(foundGroup(tag("RG", 'Z', "lane1"), NULL), true, "An RG without its NUL should not be found");
+
+	// truncated values ahead of RG
+	ASSERT_EQ(foundGroup(tag("NM", 'i', std::string("\x03\x00", 2)), NULL), true, "A truncated i tag should end the search");
+	ASSERT_EQ(foundGroup(tag("MD", 'Z', "10A5"), NULL), true, "A Z tag without its NUL should end the search");
+	ASSERT_EQ(foundGroup(tag("ML", 'B', "C\x03"), NULL), true, "A B array cut in its count should end the search");
+	ASSERT_EQ(foundGroup(tag("ML", 'B', arrayValue('C', 3, 1).substr(0, 6)) + rg.substr(0, 2), NULL), true, "A B array cut in its elements should end the search");
+	ASSERT_EQ(foundGroup(tag("ML", 'B', arrayValue('i', 0, 4).substr(0, 1) + int32Value(0x40000000)) + rg, NULL), true, "A B array longer than the data should end the search");
+	ASSERT_EQ(foundGroup(tag("ML", 'B', arrayValue('q', 0, 1)) + rg, NULL), true, "A B array of an unknown type should end the search");
+	ASSERT_EQ(foundGroup(tag("XX", '?', "") + rg, NULL), true, "A tag of an unknown type should end the search");
+	ASSERT_EQ(foundGroup("R", NULL), true, "Data shorter than a tag header should hold no RG");
+
+	// reads without a known read group are kept apart from one named unknown
+	ReadGroupStatsCollector groups(ReadGroupStatsCollector::kPartitionReadGroup, []() { return new ReadCountCollector(); });
+	BamTools::SamHeader header;
+	BamTools::SamReadGroup unknownGroup;
+	unknownGroup.ID = "unknown";
+	header.ReadGroups.Add(unknownGroup);
+	groups.setReadGroups(header);
+
+	BamTools::RefVector refVector;
+	BamTools::BamAlignment al;
+	al.TagData = tag("RG", 'Z', std::string("unknown", 8));
+	groups.processAlignment(al, refVector);
+	al.TagData = tag("RG", 'Z', std::string("other", 6));
+	groups.processAlignment(al, refVector);
+	al.TagData = "";
+	groups.processAlignment(al, refVector);
+
+	json_t * j_root = groups.appendJson();
+	ASSERT_EQ(partitionReads(j_root, "unknown"), 1, "The read group named unknown should only hold its own reads");
+	ASSERT_EQ(partitionReads(j_root, NULL), 2, "Reads without a known read group should be reported apart");
+	ASSERT_EQ(json_object_size(json_object_get(j_root, "read_groups")), 1, "Reads without a known read group should not be listed as a read group");
+	json_decref(j_root);
+
+	return 0;
+}
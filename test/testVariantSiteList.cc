@@ -0,0 +1,68 @@
+#include "../bamstatsAliveCommon.hpp"
+#include "../VariantSiteList.h"
+
+#include <string>
+#include <iostream>
+
+#define ASSERT_EQ(expr, expect, msg) { if ((expr) != (expect)) {std::cerr<<(msg)<<std::endl; exit(1);} }
+
+using namespace std;
+using namespace BamstatsAlive;
+
+static bool rejects(const std::string& siteSpec) {
+	try {
+		VariantSiteList sites(siteSpec);
+	}
+	catch(VariantSiteList::InvalidSiteLineException * e) { delete e; return true; }
+	return false;
+}
+
+int main(int argc, char* argv[]) {
+
+	// site lines, 1-based, out of order and with a duplicate
+	VariantSiteList sites("chr2 500\nchr1 1000\n\nchr1 20\r\nchr2 500\n  # a comment\nchr10\t7\n");
+
+	ASSERT_EQ(sites.size(), 4, "The duplicate site should be dropped");
+	ASSERT_EQ(sites[0].chrom, "chr1", "The sites should be sorted by chromosome name");
+	ASSERT_EQ(sites[0].position, 19, "The positions should be made 0-based");
+	ASSERT_EQ(sites[1].chrom, "chr1", "The sites of a chromosome should be kept together");
+	ASSERT_EQ(sites[1].position, 999, "The sites of a chromosome should be sorted by position");
+	ASSERT_EQ(sites[2].chrom, "chr10", "The names should be sorted as strings");
+	ASSERT_EQ(sites[2].position, 6, "A tab should separate the fields");
+	ASSERT_EQ(sites[3].chrom, "chr2", "The last chromosome should come last");
+	ASSERT_EQ(sites[3].position, 499, "The duplicate should keep its position");
+
+	// a VCF, whose columns past the position are ignored
+	std::string vcf =
+		"##fileformat=VCFv4.2\n"
+		"##contig=<ID=1,length=249250621>\n"
+		"#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\n"
+		"1\t69511\trs75062661\tA\tG\t.\tPASS\tAF=0.9\n"
+		"1\t1\t.\tC\tT\t.\tPASS\t.\n"
+		"X\t2699555\trs311165\tC\tA\t.\tPASS\t.\n";
+	VariantSiteList vcfSites(vcf);
+
+	ASSERT_EQ(vcfSites.size(), 3, "Every VCF record should be a site");
+	ASSERT_EQ(vcfSites[0].position, 0, "The first base should be position 0");
+	ASSERT_EQ(vcfSites[1].position, 69510, "A VCF position should be made 0-based");
+	ASSERT_EQ(vcfSites[2].chrom, "X", "The VCF chromosome should be kept as is");
+
+	ASSERT_EQ(VariantSiteList("").size(), 0, "An empty spec should hold no site");
+	ASSERT_EQ(VariantSiteList("#CHROM\tPOS\n").size(), 0, "A header only VCF should hold no site");
+	ASSERT_EQ(VariantSiteList("chr1 2147483647\n")[0].position, 2147483646, "The largest position should be accepted");
+
+	const char * invalidSpecs[] = {
+		"chr1\n",
+		"chr1 0\n",
+		"chr1 -5\n",
+		"chr1 abc\n",
+		"chr1 12.5\n",
+		"chr1 12abc\n",
+		"chr1 2147483648\n",
+		"chr1 100\nchr2\n"
+	};
+	for(size_t i=0; i<sizeof(invalidSpecs) / sizeof(invalidSpecs[0]); i++)
+		ASSERT_EQ(rejects(invalidSpecs[i]), true, std::string("The site line should have been rejected: ") + invalidSpecs[i]);
+
+	return 0;
+}